@@ -8,6 +8,13 @@
 #ifndef _INCLUDE_BENC_H_
 #define _INCLUDE_BENC_H_
 
+// Keep POSIX and Linux extensions such as mmap flags and syscall declared
+// under strict modes like -std=c99, when this header is included first
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <ctype.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -20,15 +27,168 @@
 #include <mach/mach_time.h>
 static mach_timebase_info_data_t timebase;
 static bool timebase_initialized = false;
+#elif defined(_WIN32)
+#include <windows.h>
+static LARGE_INTEGER performance_frequency;
+static bool performance_frequency_initialized = false;
 #else
 #include <time.h>
 #endif
 
-#define NANOS 1
+#ifndef _WIN32
+#include <pthread.h>
+#include <regex.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach/thread_act.h>
+#include <mach/thread_policy.h>
+#endif
+
+// Cycle counters are available on x86 (rdtsc) and AArch64 (cntvct_el0)
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BENCH_HAS_CYCLES 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#elif defined(__aarch64__)
+#define BENCH_HAS_CYCLES 1
+#endif
+static double cycles_per_ns = 0;
+static bool cycles_initialized = false;
+
+#define BENCH_VERSION "1.0.0"
+
+#define NANOS ((uint64_t) 1)
 #define MICROS NANOS * 1000
 #define MILLIS MICROS * 1000
 #define SECONDS MILLIS * 1000
 
+// The number of recent samples considered when waiting for a steady state
+#define BENCH_STEADY_WINDOW 16
+
+// The fewest samples from which an adaptive measurement may stop
+#define BENCH_ADAPTIVE_MIN_SAMPLES 10
+
+// The most iterations batched into one sample, for code optimized to nothing
+#define BENCH_MAX_BATCH (1ULL << 32)
+
+// The most states a fixture sets up at once, so large batches are set up,
+// timed and torn down in chunks rather than holding a state per iteration
+#define BENCH_FIXTURE_BATCH 1024
+
+// The samples in a row which may take no time before a measurement stops,
+// as one which never records any time would otherwise never finish
+#define BENCH_STALLED_SAMPLES 1024
+
+// The samples, and iterations of each, from which overhead is measured
+#define BENCH_OVERHEAD_SAMPLES 101
+#define BENCH_OVERHEAD_ITERATIONS 1000
+
+// Histogram values below 2^BENCH_HISTOGRAM_BITS are exact, larger values are
+// kept to within 1 / 2^(BENCH_HISTOGRAM_BITS - 1) of their magnitude.
+#define BENCH_HISTOGRAM_BITS 6
+#define BENCH_HISTOGRAM_HALF (1 << (BENCH_HISTOGRAM_BITS - 1))
+#define BENCH_HISTOGRAM_BUCKETS ((66 - BENCH_HISTOGRAM_BITS) * BENCH_HISTOGRAM_HALF)
+
+// Measurement histograms record picoseconds to keep sub-nanosecond detail
+#define BENCH_HISTOGRAM_SCALE 1000
+
+// The largest number of CPUs considered when pinning threads
+#define BENCH_MAX_CPUS 1024
+
+// The stride of the pointer chases of the reference suite, one cache line
+#define BENCH_REFERENCE_LINE 64
+
+// The samples each traced measurement buffers while the trace writer catches
+// up, rounded up to a power of two
+#ifndef BENCH_TRACE_CAPACITY
+#define BENCH_TRACE_CAPACITY 65536
+#endif
+
+// How long the trace writer sleeps between drains, in nanoseconds
+#define BENCH_TRACE_INTERVAL (1 * MILLIS)
+
+// The size of a cache line, which data written by different threads is
+// padded to
+#define BENCH_CACHE_LINE 64
+
+// The smallest working set the reference suite measures main memory with
+#define BENCH_REFERENCE_DRAM_SIZE (64 * 1024 * 1024)
+
+/**
+ * Compiler barriers.
+ *
+ * `bench_do_not_optimize(value)` forces `value` to be computed, as if it were
+ * read by code the compiler can not see, so benchmarks which discard their
+ * result are not optimized away. `bench_clobber_memory()` forces all pending
+ * memory writes to happen, as if memory were read by code the compiler can
+ * not see. Neither emits any instructions beyond what the barrier requires.
+ *
+ * ```c
+ * void bench_fast(void* data) {
+ *   bench_do_not_optimize(fibo(5));
+ * }
+ *
+ * void bench_sum(void* data) {
+ *   uint64_t sum = 0;
+ *   for (int i = 0; i < 64; i++) sum += values[i];
+ *   bench_do_not_optimize(sum);
+ * }
+ * ```
+ *
+ * `value` may be any expression or lvalue. Without GCC or Clang, its
+ * address escapes to a volatile sink. In C, it is instead copied into a
+ * volatile local declared with `typeof`, which needs MSVC 19.39 or newer or
+ * C23, and older compilers only accept lvalues.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define bench_do_not_optimize(value) __asm__ __volatile__("" : : "r,m"(value) : "memory")
+#define bench_clobber_memory() __asm__ __volatile__("" : : : "memory")
+#else
+#ifdef _MSC_VER
+#include <intrin.h>
+#define bench_clobber_memory() _ReadWriteBarrier()
+#else
+#define bench_clobber_memory() ((void) 0)
+#endif
+static const volatile void* volatile _bench_sink;
+
+#if defined(__cplusplus)
+// Temporaries bound to the reference live until the end of the statement
+template <typename T>
+inline void _bench_do_not_optimize(const T& value) {
+  _bench_sink = (const volatile void*) &value;
+  bench_clobber_memory();
+}
+#define bench_do_not_optimize(value) _bench_do_not_optimize(value)
+#elif (defined(_MSC_VER) && _MSC_VER >= 1939) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 202311L)
+#ifdef _MSC_VER
+#define _BENCH_TYPEOF(value) __typeof__(value)
+#else
+#define _BENCH_TYPEOF(value) typeof(value)
+#endif
+#define bench_do_not_optimize(value) do { \
+    volatile _BENCH_TYPEOF(value) _bench_value = (value); \
+    (void) _bench_value; \
+    bench_clobber_memory(); \
+  } while (0)
+#else
+#define bench_do_not_optimize(value) \
+  (_bench_sink = (const volatile void*) &(value), bench_clobber_memory())
+#endif
+#endif
+
 /**
  * Human readable numbers
  *
@@ -63,6 +223,253 @@ static inline void bench_human_number(FILE* out, float number, bool time) {
   }
 }
 
+/**
+ * Human readable byte counts, in binary units.
+ *
+ * @param out The file to write to.
+ * @param bytes The number of bytes to write in human-readable form.
+ */
+static inline void bench_human_bytes(FILE* out, double bytes) {
+  int level = 0;
+
+  while (bytes >= 1024 && level < 4) {
+    bytes /= 1024;
+    level++;
+  }
+
+  switch (level) {
+    case 0: fprintf(out, "%.2fB", bytes); break;
+    case 1: fprintf(out, "%.2fKiB", bytes); break;
+    case 2: fprintf(out, "%.2fMiB", bytes); break;
+    case 3: fprintf(out, "%.2fGiB", bytes); break;
+    default: fprintf(out, "%.2fTiB", bytes); break;
+  }
+}
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION bench_mutex_t;
+#else
+typedef pthread_mutex_t bench_mutex_t;
+#endif
+
+/*!
+ * Initialize a mutex.
+ *
+ * @private
+ * @param mutex The mutex to initialize.
+ */
+static inline void _bench_mutex_init(bench_mutex_t* mutex) {
+#ifdef _WIN32
+  InitializeCriticalSection(mutex);
+#else
+  pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+/*!
+ * Lock a mutex.
+ *
+ * @private
+ * @param mutex The mutex to lock.
+ */
+static inline void _bench_mutex_lock(bench_mutex_t* mutex) {
+#ifdef _WIN32
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+/*!
+ * Unlock a mutex.
+ *
+ * @private
+ * @param mutex The mutex to unlock.
+ */
+static inline void _bench_mutex_unlock(bench_mutex_t* mutex) {
+#ifdef _WIN32
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+/*!
+ * Release the resources of a mutex.
+ *
+ * @private
+ * @param mutex The mutex to destroy.
+ */
+static inline void _bench_mutex_destroy(bench_mutex_t* mutex) {
+#ifdef _WIN32
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+/**
+ * Arenas.
+ */
+
+#ifndef _WIN32
+#include <sys/mman.h>
+
+// Older BSDs only name anonymous mappings MAP_ANON
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+// The size of each block of memory an arena maps, unless one allocation
+// needs more
+#define BENCH_ARENA_BLOCK (1024 * 1024)
+
+/*!
+ * A block of memory mapped by an arena, with its allocations following it.
+ *
+ * @private
+ * @property next The block mapped before this one
+ * @property size The size of the mapping, including this header
+ * @property used The bytes of the mapping in use, including this header
+ */
+typedef struct bench_arena_block_s {
+  struct bench_arena_block_s* next;
+  size_t size;
+  size_t used;
+} bench_arena_block_t;
+
+/*!
+ * A bench_arena_t hands out memory from blocks mapped directly from the
+ * operating system, away from the heap used by the code being measured.
+ * Allocations are only freed all at once, with `bench_arena_free`.
+ *
+ * @private
+ * @property blocks The block allocations are made from, followed by older ones
+ * @property lock Guards the blocks, as concurrent groups share the arena
+ */
+typedef struct bench_arena_s {
+  bench_arena_block_t* blocks;
+  bench_mutex_t lock;
+} bench_arena_t;
+
+/*!
+ * Initialize an empty arena.
+ *
+ * @private
+ * @param arena The arena to initialize.
+ */
+static inline void bench_arena_init(bench_arena_t* arena) {
+  arena->blocks = NULL;
+  _bench_mutex_init(&arena->lock);
+}
+
+/*!
+ * Make sure the current block of the arena has room for the given number of
+ * bytes, mapping a new one if needed. New blocks are touched up front, so
+ * allocations made later do not page fault.
+ *
+ * @private
+ * @param arena The arena.
+ * @param bytes The number of bytes to make room for.
+ * @return Whether there is room. Called with the lock held.
+ */
+static inline bool _bench_arena_reserve(bench_arena_t* arena, size_t bytes) {
+  bench_arena_block_t* block = arena->blocks;
+  if (block != NULL && block->size - block->used >= bytes) return true;
+
+  size_t header = (sizeof(bench_arena_block_t) + 15) & ~(size_t) 15;
+  size_t size = bytes + header > BENCH_ARENA_BLOCK ? bytes + header : BENCH_ARENA_BLOCK;
+  size = (size + 4095) & ~(size_t) 4095;
+#ifdef _WIN32
+  void* memory = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+  void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) memory = NULL;
+#endif
+  if (memory == NULL) return false;
+  memset(memory, 0, size);
+
+  block = (bench_arena_block_t*) memory;
+  block->next = arena->blocks;
+  block->size = size;
+  block->used = header;
+  arena->blocks = block;
+  return true;
+}
+
+/*!
+ * Preallocate memory in an arena, so the given number of bytes can be
+ * allocated without mapping more.
+ *
+ * @private
+ * @param arena The arena.
+ * @param bytes The number of bytes to preallocate.
+ * @return Whether the memory was preallocated.
+ */
+static inline bool bench_arena_reserve(bench_arena_t* arena, size_t bytes) {
+  _bench_mutex_lock(&arena->lock);
+  bool reserved = _bench_arena_reserve(arena, bytes);
+  _bench_mutex_unlock(&arena->lock);
+  return reserved;
+}
+
+/*!
+ * Allocate zeroed memory from an arena, aligned to 16 bytes.
+ *
+ * @private
+ * @param arena The arena.
+ * @param size The number of bytes to allocate.
+ * @return The memory, or NULL if more could not be mapped.
+ */
+static inline void* bench_arena_alloc(bench_arena_t* arena, size_t size) {
+  size = (size + 15) & ~(size_t) 15;
+  void* ptr = NULL;
+  _bench_mutex_lock(&arena->lock);
+  if (_bench_arena_reserve(arena, size)) {
+    ptr = (char*) arena->blocks + arena->blocks->used;
+    arena->blocks->used += size;
+  }
+  _bench_mutex_unlock(&arena->lock);
+  return ptr;
+}
+
+/*!
+ * Copy a string into an arena.
+ *
+ * @private
+ * @param arena The arena.
+ * @param value The string to copy.
+ * @return The copy, or NULL if more memory could not be mapped.
+ */
+static inline char* bench_arena_strdup(bench_arena_t* arena, const char* value) {
+  size_t size = strlen(value) + 1;
+  char* copy = (char*) bench_arena_alloc(arena, size);
+  if (copy != NULL) memcpy(copy, value, size);
+  return copy;
+}
+
+/*!
+ * Unmap every block of an arena, freeing all of its allocations at once.
+ *
+ * @private
+ * @param arena The arena to free.
+ */
+static inline void bench_arena_free(bench_arena_t* arena) {
+  bench_arena_block_t* block = arena->blocks;
+  while (block != NULL) {
+    bench_arena_block_t* next = block->next;
+#ifdef _WIN32
+    VirtualFree(block, 0, MEM_RELEASE);
+#else
+    munmap(block, block->size);
+#endif
+    block = next;
+  }
+  arena->blocks = NULL;
+  _bench_mutex_destroy(&arena->lock);
+}
+
 /**
  * Dynamic arrays.
  */
@@ -74,11 +481,14 @@ static inline void bench_human_number(FILE* out, float number, bool time) {
  * @property size The number of pointers in the array.
  * @property capacity The number of pointers the array can hold.
  * @property entries The pointers in the array.
+ * @property arena The arena the entries are allocated from, or NULL to use
+ *   the heap.
  */
 typedef struct bench_array_s {
   size_t size;
   size_t capacity;
   void** entries;
+  bench_arena_t* arena;
 } bench_array_t;
 
 /*!
@@ -94,9 +504,18 @@ static inline bool bench_array_resize(bench_array_t* array, size_t capacity) {
   if (capacity < array->size) return false;
 
   // Create or resize the entries buffer
-  void** entries = (array->entries == NULL)
-    ? (void**) calloc(capacity, sizeof(void*))
-    : (void**) realloc(array->entries, capacity * sizeof(void*));
+  void** entries;
+  if (array->arena != NULL) {
+    // Arena memory is not freed, so grown arrays leave their old entries
+    entries = (void**) bench_arena_alloc(array->arena, capacity * sizeof(void*));
+    if (entries != NULL && array->size > 0) {
+      memcpy(entries, array->entries, array->size * sizeof(void*));
+    }
+  } else {
+    entries = (array->entries == NULL)
+      ? (void**) calloc(capacity, sizeof(void*))
+      : (void**) realloc(array->entries, capacity * sizeof(void*));
+  }
 
   if (entries == NULL) return false;
 
@@ -118,6 +537,25 @@ static inline bool bench_array_init(bench_array_t* array, size_t capacity) {
   array->size = 0;
   array->capacity = 0;
   array->entries = NULL;
+  array->arena = NULL;
+  return bench_array_resize(array, capacity);
+}
+
+/*!
+ * Initializes a dynamic array with the given capacity, with its entries
+ * allocated from an arena.
+ *
+ * @private
+ * @param capacity The initial capacity of the array.
+ * @param arena The arena to allocate from.
+ * @return Whether the initialization was successful.
+ */
+static inline bool bench_array_init_arena(bench_array_t* array, size_t capacity, bench_arena_t* arena) {
+  if (array == NULL) return false;
+  array->size = 0;
+  array->capacity = 0;
+  array->entries = NULL;
+  array->arena = arena;
   return bench_array_resize(array, capacity);
 }
 
@@ -145,22 +583,28 @@ static inline bool bench_array_push(bench_array_t* array, void* ptr) {
  * @param array The dynamic array to clear.
  */
 static inline void bench_array_clear(bench_array_t* array) {
-  free(array->entries);
+  if (array->arena == NULL) free(array->entries);
   array->size = 0;
 }
 
 /**
  * Streaming stats tracking to approximate standard deviation.
  *
+ * Values are accumulated in double precision with a 64-bit count, so long
+ * runs of very fast iterations do not lose precision.
+ *
  * @property count The number of measurements.
+ * @property samples The number of timed samples the measurements came from.
+ * @property total The sum of the measurements.
  * @property mean The mean of the measurements.
  * @property d_squared The sum of the squared differences from the mean.
  */
 typedef struct bench_stats_s {
-  uint32_t count;
+  uint64_t count;
+  uint64_t samples;
   uint64_t total;
-  float mean;
-  float d_squared;
+  double mean;
+  double d_squared;
 } bench_stats_t;
 
 /*!
@@ -170,35 +614,78 @@ typedef struct bench_stats_s {
  */
 static inline void bench_stats_init(bench_stats_t* stats) {
   stats->count = 0;
+  stats->samples = 0;
   stats->total = 0;
   stats->mean = 0;
   stats->d_squared = 0;
 }
 
 /*!
- * Records a new value to the stats object.
+ * Records a batch of iterations timed together to the stats object. The batch
+ * is weighted as `iterations` samples of its per-iteration value, so `count`
+ * and `total` remain comparable to pushing each iteration individually.
  *
  * @param stats The bench_stats_t to which to record.
- * @param value The value to record.
+ * @param value The total value of the batch.
+ * @param iterations The number of iterations in the batch.
  */
-static inline void bench_stats_push(bench_stats_t* stats, uint64_t value) {
-  stats->count++;
+static inline void bench_stats_push_batch(
+  bench_stats_t* stats,
+  uint64_t value,
+  uint64_t iterations
+) {
+  stats->count += iterations;
+  stats->samples++;
   stats->total += value;
 
-  float new_mean = stats->mean + (value - stats->mean) / stats->count;
-  float d_squared_increment = (value - new_mean) * (value - stats->mean);
+  double x = (double) value / iterations;
+  double delta = x - stats->mean;
+  double new_mean = stats->mean + delta * iterations / stats->count;
+  double d_squared_increment = delta * (x - new_mean) * iterations;
 
   stats->mean = new_mean;
   stats->d_squared += d_squared_increment;
 }
 
+/*!
+ * Records a new value to the stats object.
+ *
+ * @param stats The bench_stats_t to which to record.
+ * @param value The value to record.
+ */
+static inline void bench_stats_push(bench_stats_t* stats, uint64_t value) {
+  bench_stats_push_batch(stats, value, 1);
+}
+
+/*!
+ * Combines the values recorded in one stats object into another, using Chan's
+ * parallel algorithm, as if they had all been pushed to the same object.
+ *
+ * @param stats The bench_stats_t to merge into.
+ * @param other The bench_stats_t to merge from.
+ */
+static inline void bench_stats_merge(bench_stats_t* stats, const bench_stats_t* other) {
+  if (other->count == 0) return;
+
+  uint64_t count = stats->count + other->count;
+  double delta = other->mean - stats->mean;
+
+  stats->mean += delta * other->count / count;
+  stats->d_squared += other->d_squared
+    + delta * delta * ((double) stats->count * other->count / count);
+  stats->count = count;
+  stats->samples += other->samples;
+  stats->total += other->total;
+}
+
 /*!
  * Returns the variance of the stats object.
  *
  * @param stats The bench_stats_t for which to compute variance.
  * @return The variance of the stats object.
  */
-static inline float bench_stats_variance(bench_stats_t* stats) {
+static inline double bench_stats_variance(bench_stats_t* stats) {
+  if (stats->count == 0) return 0;
   return stats->d_squared / stats->count;
 }
 
@@ -208,425 +695,9029 @@ static inline float bench_stats_variance(bench_stats_t* stats) {
  * @param stats The bench_stats_t for which to compute standard deviation.
  * @return The standard deviation of the stats object.
  */
-static inline float bench_stats_stddev(bench_stats_t* stats) {
+static inline double bench_stats_stddev(bench_stats_t* stats) {
   return sqrt(bench_stats_variance(stats));
 }
 
+/*!
+ * Returns the two-sided 95% critical value of Student's t-distribution.
+ *
+ * @private
+ * @param df The degrees of freedom.
+ * @return The critical value.
+ */
+static inline double _bench_t_critical(uint64_t df) {
+  static const double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  if (df == 0) return INFINITY;
+  if (df <= sizeof(table) / sizeof(table[0])) return table[df - 1];
+
+  // Beyond the table, interpolate in 1/df between the critical values for
+  // 30, 40, 60, 120 and infinitely many degrees of freedom
+  static const double rows[][2] = { { 30, 2.042 }, { 40, 2.021 }, { 60, 2.000 }, { 120, 1.980 } };
+  for (size_t i = 1; i < sizeof(rows) / sizeof(rows[0]); i++) {
+    if (df > rows[i][0]) continue;
+    double weight = (1 / rows[i - 1][0] - 1.0 / df) / (1 / rows[i - 1][0] - 1 / rows[i][0]);
+    return rows[i - 1][1] + (rows[i][1] - rows[i - 1][1]) * weight;
+  }
+  return 1.96 + (1.980 - 1.96) * 120 / df;
+}
+
+/*!
+ * Returns the relative margin of error of the mean, at 95% confidence. Each
+ * sample is treated as one observation, so batched samples are counted once.
+ *
+ * @param stats The bench_stats_t for which to compute the margin of error.
+ * @return The margin of error as a percentage of the mean.
+ */
+static inline double bench_stats_rme(bench_stats_t* stats) {
+  if (stats->samples < 2 || stats->mean <= 0) return 0;
+  double sem = bench_stats_stddev(stats) / sqrt((double) stats->samples);
+  return _bench_t_critical(stats->samples - 1) * sem / stats->mean * 100;
+}
+
 /*!
  * Returns the operations per second of the stats object.
  *
  * @param stats The bench_stats_t for which to compute operations per second.
  * @return The operations per second of the stats object.
  */
-static inline float bench_stats_ops_per_sec(bench_stats_t* stats) {
-  return ((float) stats->count / (float) stats->total) * SECONDS;
+static inline double bench_stats_ops_per_sec(bench_stats_t* stats) {
+  return ((double) stats->count / (double) stats->total) * SECONDS;
 }
 
 /*!
- * Prints the stats object to the given output.
+ * Prints the stats object to the given output. The "±" figure is the relative
+ * margin of error of the mean.
  *
  * @param stats The bench_stats_t to print.
  * @param out The output to which to print.
  */
 static inline void bench_stats_print(bench_stats_t* stats, FILE* out) {
   bench_human_number(out, bench_stats_ops_per_sec(stats), false);
-  fprintf(out, " i/s (±%.2f%%) (", bench_stats_stddev(stats));
+  fprintf(out, " i/s (±%.2f%%) (", bench_stats_rme(stats));
   bench_human_number(out, stats->mean, true);
   fprintf(out, "/i)");
 }
 
-/*!
- * A named measurement with stats.
+/**
+ * Fixed-size log-linear histogram, in the style of HdrHistogram. Recording
+ * never allocates, and histograms with the same layout can be merged.
  *
- * @property name The name of the measurement.
- * @property stats The stats of the measurement.
+ * @property count The number of recorded values.
+ * @property min The smallest recorded value.
+ * @property max The largest recorded value.
+ * @property counts The number of values recorded in each bucket.
  */
-typedef struct bench_measurement_s {
-  const char* name;
-  bench_stats_t stats;
-} bench_measurement_t;
+typedef struct bench_histogram_s {
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+  uint64_t counts[BENCH_HISTOGRAM_BUCKETS];
+} bench_histogram_t;
 
 /*!
- * Free the measurement and its name.
+ * Initializes histogram with no recorded values.
  *
- * @param m The bench_measurement_t to free.
+ * @param hist The bench_histogram_t to initialize.
  */
-static inline void bench_measurement_free(bench_measurement_t* m) {
-  free((void*) m->name);
-  free(m);
+static inline void bench_histogram_init(bench_histogram_t* hist) {
+  memset(hist, 0, sizeof(bench_histogram_t));
+  hist->min = UINT64_MAX;
 }
 
-// A list of measurements
-typedef bench_array_t bench_measurements_t;
-
-/**
- * A bench namespace.
+/*!
+ * Find the index of the most significant set bit of a non-zero value.
  *
- * @property name The name of the benchmark suite.
- * @property out The target to which output is written.
- * @property indent The indentation level for sub-groups.
- * @property data A free pointer slot to pass data into sub-groups.
- * @property target_time The approximate time in nanoseconds to run each measurement.
- * @property measurements The list of measurements.
+ * @private
+ * @param value The value to inspect.
+ * @return The bit index, from 0 to 63.
  */
-typedef struct bench_s {
-  const char* name;
-  FILE* out;
-  int indent;
-  void* data;
-  uint64_t target_time;
-  bench_measurements_t measurements;
-} bench_t;
+static inline int _bench_msb(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - __builtin_clzll(value);
+#else
+  int bit = 0;
+  while (value >>= 1) bit++;
+  return bit;
+#endif
+}
 
 /*!
- * Free the benchmark and its name.
+ * Find the bucket in which a value is counted.
  *
  * @private
- * @param b bench namespace
+ * @param value The value to look up.
+ * @return The bucket index.
  */
-static inline void bench_free(bench_t* b) {
-  free((void*) b->name);
-  for (size_t i = 0; i < b->measurements.size; i++) {
-    bench_measurement_free((bench_measurement_t*) b->measurements.entries[i]);
-  }
-  bench_array_clear(&b->measurements);
-  free(b);
+static inline size_t _bench_histogram_index(uint64_t value) {
+  if (value < 2 * BENCH_HISTOGRAM_HALF) return (size_t) value;
+  int shift = _bench_msb(value) - (BENCH_HISTOGRAM_BITS - 1);
+  return (size_t) shift * BENCH_HISTOGRAM_HALF + (size_t) (value >> shift);
 }
 
 /*!
- * Print indentation level for sub-groups
+ * Find the largest value counted in a bucket.
  *
  * @private
- * @param b bench namespace
+ * @param index The bucket index.
+ * @return The highest value equivalent to the bucket.
  */
-static inline void _bench_print_indent(bench_t* b) {
-  for (int i = 0; i < b->indent; i++) {
-    fprintf(b->out, " ");
-  }
+static inline uint64_t _bench_histogram_value(size_t index) {
+  if (index < 2 * BENCH_HISTOGRAM_HALF) return index;
+  int shift = (int) (index / BENCH_HISTOGRAM_HALF) - 1;
+  uint64_t sub = index - (size_t) shift * BENCH_HISTOGRAM_HALF;
+  return ((sub + 1) << shift) - 1;
 }
 
-/**
- * Creates a benchmark writing to the given FILE.
+/*!
+ * Records a value to the histogram a number of times.
  *
- * ```c
- * bench_t* b = bench_create("name", stdout);
- * // or...
- * bench_t* b = bench_create("name", fopen("out.bench", "w"));
- * ```
+ * @param hist The bench_histogram_t to which to record.
+ * @param value The value to record.
+ * @param count The number of times to record the value.
+ */
+static inline void bench_histogram_record(
+  bench_histogram_t* hist,
+  uint64_t value,
+  uint64_t count
+) {
+  hist->counts[_bench_histogram_index(value)] += count;
+  hist->count += count;
+  if (value < hist->min) hist->min = value;
+  if (value > hist->max) hist->max = value;
+}
+
+/*!
+ * Adds the values recorded in one histogram to another.
  *
- * @param name The name of the benchmark suite
- * @param out FILE to which the benchmark output will be written
- * @param indent The indentation level for sub-groups
- * @param data A free pointer slot to pass data into sub-groups
- * @return bench_t
+ * @param hist The bench_histogram_t to merge into.
+ * @param other The bench_histogram_t to merge from.
  */
-static inline bench_t* bench_create(const char* name, FILE* out, int indent, void* data, ...) {
-  bench_t* b = (bench_t*) malloc(sizeof(bench_t));
+static inline void bench_histogram_merge(
+  bench_histogram_t* hist,
+  const bench_histogram_t* other
+) {
+  for (size_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++) {
+    hist->counts[i] += other->counts[i];
+  }
+  hist->count += other->count;
+  if (other->min < hist->min) hist->min = other->min;
+  if (other->max > hist->max) hist->max = other->max;
+}
 
-  b->name = strdup(name);
-  b->out = out;
-  b->indent = indent;
-  b->data = data;
-  b->target_time = SECONDS;
+/*!
+ * Returns the value at the given percentile of the histogram.
+ *
+ * @param hist The bench_histogram_t to query.
+ * @param percentile The percentile, from 0 to 100.
+ * @return The highest value equivalent to the percentile, or 0 when empty.
+ */
+static inline uint64_t bench_histogram_percentile(
+  const bench_histogram_t* hist,
+  double percentile
+) {
+  if (hist->count == 0) return 0;
+  if (percentile >= 100) return hist->max;
 
-  // Attempt to allocate the bench array
-  if (!bench_array_init((bench_measurements_t*) &b->measurements, 16)) {
-    bench_free(b);
-    return NULL;
+  uint64_t target = (uint64_t) ceil(percentile / 100 * hist->count);
+  if (target == 0) target = 1;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++) {
+    seen += hist->counts[i];
+    if (seen >= target) {
+      uint64_t value = _bench_histogram_value(i);
+      return value < hist->max ? value : hist->max;
+    }
   }
+  return hist->max;
+}
+
+/*!
+ * Prints the common percentiles of a measurement histogram.
+ *
+ * @param hist The bench_histogram_t to print, in picoseconds.
+ * @param out The output to which to print.
+ */
+static inline void bench_histogram_print(const bench_histogram_t* hist, FILE* out) {
+  static const double percentiles[] = { 50, 90, 99, 99.9 };
+  static const char* labels[] = { "p50", "p90", "p99", "p99.9" };
 
-  // For top-level suite, print the header
-  if (indent == 0) {
-    fprintf(out, "benc.h v1.0.0\n");
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    fprintf(out, "%s ", labels[i]);
+    uint64_t value = bench_histogram_percentile(hist, percentiles[i]);
+    bench_human_number(out, (float) value / BENCH_HISTOGRAM_SCALE, true);
+    fprintf(out, ", ");
   }
-  _bench_print_indent(b);
-  fprintf(b->out, "# %s\n", b->name);
+  fprintf(out, "max ");
+  bench_human_number(out, (float) hist->max / BENCH_HISTOGRAM_SCALE, true);
+}
 
-  return b;
+/**
+ * Hardware performance counters collected with `perf_event_open` on Linux.
+ */
+typedef enum bench_counter_e {
+  BENCH_COUNTER_CYCLES,
+  BENCH_COUNTER_INSTRUCTIONS,
+  BENCH_COUNTER_BRANCH_MISSES,
+  BENCH_COUNTER_L1D_MISSES,
+  BENCH_COUNTER_LLC_MISSES,
+  BENCH_COUNTER_DTLB_MISSES,
+  BENCH_COUNTER_COUNT
+} bench_counter_t;
+
+/**
+ * Totals of the hardware performance counters over a measurement.
+ *
+ * @property available A bit mask of the counters which could be read.
+ * @property values The total of each counter.
+ */
+typedef struct bench_counters_s {
+  uint32_t available;
+  uint64_t values[BENCH_COUNTER_COUNT];
+} bench_counters_t;
+
+/*!
+ * Initializes counters with no values available.
+ *
+ * @param counters The bench_counters_t to initialize.
+ */
+static inline void bench_counters_init(bench_counters_t* counters) {
+  memset(counters, 0, sizeof(bench_counters_t));
 }
-// Make out parameter optional, defaulting to stdout
-#define bench_create(name, out, ...) bench_create(name, out, ##__VA_ARGS__, 0, NULL)
 
 /*!
- * Compare two measurements to sort by operations per second.
+ * Adds the totals of one set of counters to another.
  *
- * @private
- * @param a The first measurement cast as `const void*`.
- * @param b The second measurement cast as `const void*`.
+ * @param counters The bench_counters_t to merge into.
+ * @param other The bench_counters_t to merge from.
  */
-static inline int _bench_compare_measurement(const void* a, const void* b) {
-  bench_measurement_t* ma = *(bench_measurement_t**) a;
-  bench_measurement_t* mb = *(bench_measurement_t**) b;
+static inline void bench_counters_merge(bench_counters_t* counters, const bench_counters_t* other) {
+  counters->available |= other->available;
+  for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+    counters->values[i] += other->values[i];
+  }
+}
 
-  float current = bench_stats_ops_per_sec(&ma->stats);
-  float next = bench_stats_ops_per_sec(&mb->stats);
+/*!
+ * Whether a counter was read.
+ *
+ * @param counters The bench_counters_t to check.
+ * @param counter The counter.
+ * @return Whether the counter is available.
+ */
+static inline bool bench_counters_has(const bench_counters_t* counters, bench_counter_t counter) {
+  return (counters->available & (1u << counter)) != 0;
+}
 
-  if (current > next) return -1;
-  if (current < next) return 1;
-  return 0;
+/*!
+ * Prints the counters per iteration, and instructions per cycle.
+ *
+ * @param counters The bench_counters_t to print.
+ * @param iterations The number of iterations the counters cover.
+ * @param out The output to which to print.
+ */
+static inline void bench_counters_print(
+  const bench_counters_t* counters,
+  uint64_t iterations,
+  FILE* out
+) {
+  static const char* names[] = {
+    "cycles", "instructions", "branch-misses", "L1D-misses", "LLC-misses", "dTLB-misses"
+  };
+  const char* separator = "";
+
+  if (bench_counters_has(counters, BENCH_COUNTER_CYCLES) &&
+      bench_counters_has(counters, BENCH_COUNTER_INSTRUCTIONS) &&
+      counters->values[BENCH_COUNTER_CYCLES] > 0) {
+    fprintf(out, "%.2f IPC", (double) counters->values[BENCH_COUNTER_INSTRUCTIONS]
+      / counters->values[BENCH_COUNTER_CYCLES]);
+    separator = ", ";
+  }
+  for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+    if (!bench_counters_has(counters, (bench_counter_t) i)) continue;
+    fprintf(out, "%s%.2f %s/i", separator, (double) counters->values[i] / iterations, names[i]);
+    separator = ", ";
+  }
 }
 
 /**
- * Compare results of the benchmark.
+ * Clock sources used to time samples.
+ *
+ * - `BENCH_CLOCK_MONOTONIC` uses the OS monotonic clock.
+ * - `BENCH_CLOCK_CYCLES` reads the invariant TSC on x86 or `cntvct_el0` on
+ *   AArch64, falling back to the monotonic clock where neither is usable.
+ */
+typedef enum bench_clock_e {
+  BENCH_CLOCK_MONOTONIC,
+  BENCH_CLOCK_CYCLES
+} bench_clock_t;
+
+/**
+ * Batch runner signature. A batch runner makes `iterations` calls to the code
+ * being measured between two reads of the clock, so the timing loop can be
+ * specialized for the code it calls.
  *
  * ```c
- * bench_t* b = bench_create("bench", stdout);
- * bench_measure(b, "fast", bench_fast);
- * bench_measure(b, "slow", bench_slow);
- * bench_compare(b);
+ * uint64_t run(void* ctx, bench_clock_t clock, uint64_t iterations) {
+ *   uint64_t start = bench_clock_start(clock);
+ *   for (uint64_t i = 0; i < iterations; i++) {
+ *     work(ctx);
+ *   }
+ *   return bench_clock_elapsed(clock, bench_clock_stop(clock) - start);
+ * }
  * ```
  *
- * ```
- * benc.h v1.0.0
- * # bench
- * fast - 26.92m i/s (±49.87%) (34.11ns/i)
- * slow - 3.53m i/s (±165.47%) (278.89ns/i)
- * ```
+ * @param ctx Pointer passed through from `bench_measure_batch`
+ * @param clock The clock source to time the batch with.
+ * @param iterations The number of calls to make.
+ * @return The time taken by the batch in nanoseconds.
+ */
+typedef uint64_t (*bench_batch_fn)(void* ctx, bench_clock_t clock, uint64_t iterations);
+
+/**
+ * The overhead the framework adds to measurements, measured once per process
+ * and clock source by `bench_subtract_overhead`. Each value is -1 until it
+ * has been measured.
  *
- * @param b bench namespace
+ * @property timer Nanoseconds per sample spent reading the clock.
+ * @property call Nanoseconds per iteration spent calling a measurement
+ *   function through a pointer, as `bench_measure` does.
+ * @property function Nanoseconds per iteration spent calling a
+ *   `std::function`, as the C++ `measure` does.
  */
-static inline void bench_compare(bench_t* b) {
-  bench_array_t* m = &b->measurements;
+typedef struct bench_overhead_s {
+  double timer;
+  double call;
+  double function;
+} bench_overhead_t;
 
-  // Only show comparison if there's more than one measurement.
-  if (m->size > 1) {
-    // Sort the order of the measurements by the number of operations per second
-    qsort(m->entries, m->size, sizeof(void**), _bench_compare_measurement);
+/*!
+ * The overhead measured for each clock source.
+ *
+ * @private
+ */
+static bench_overhead_t _bench_overheads[2] = { { -1, -1, -1 }, { -1, -1, -1 } };
 
-    _bench_print_indent(b);
-    fprintf(b->out, "Comparing...\n");
+/**
+ * Allocation tracking.
+ *
+ * Define `BENCH_TRACK_ALLOCATIONS` before including benc.h, in the one file
+ * which runs the measurements, to count heap allocations made while
+ * recording samples. With glibc, `malloc`, `calloc`, `realloc` and `free` are
+ * interposed. On macOS, the default malloc zone is hooked. In C++, the global
+ * `operator new` and `operator delete` are replaced as well, which is the
+ * only hook on other platforms.
+ */
 
-    bench_stats_t* first = NULL;
+#if defined(__GNUC__) || defined(__clang__)
+#define BENCH_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define BENCH_THREAD_LOCAL __declspec(thread)
+#else
+#define BENCH_THREAD_LOCAL _Thread_local
+#endif
 
-    for (size_t i = 0; i < m->size; i++) {
-      bench_measurement_t* measurement = (bench_measurement_t*) m->entries[i];
-      bench_stats_t* stats = &measurement->stats;
-      _bench_print_indent(b);
-      if (first == NULL) {
-        fprintf(b->out, "  - %s (fastest)\n", measurement->name);
-        first = stats;
-      } else {
-        fprintf(b->out, "  - %s", measurement->name);
-        fprintf(b->out, " (%.2f%% slower)\n", (stats->mean / first->mean) * 100 - 100);
-      }
-    }
-  }
+#if defined(BENCH_TRACK_ALLOCATIONS) && (defined(__GLIBC__) || defined(__APPLE__))
+#define BENCH_HOOKS_MALLOC 1
+#endif
 
-  bench_free(b);
-}
+#if defined(BENCH_HOOKS_MALLOC) || (defined(BENCH_TRACK_ALLOCATIONS) && defined(__cplusplus))
+#define BENCH_HOOKS_ALLOCATIONS 1
+#endif
+
+#ifdef BENCH_TRACK_ALLOCATIONS
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#endif
+#endif
 
 /**
- * Sub-group function signature
+ * Heap allocations made while recording a measurement.
  *
- * @param b bench namespace
+ * @property tracked Whether allocations were tracked.
+ * @property count The number of allocations.
+ * @property bytes The number of bytes requested by the allocations.
+ * @property live The bytes allocated but not yet freed while tracking.
+ * @property peak The most bytes live at once while tracking. For parallel
+ *   measurements, this is the sum across threads.
  */
-typedef void (*bench_group_fn)(bench_t* b);
+typedef struct bench_allocs_s {
+  bool tracked;
+  uint64_t count;
+  uint64_t bytes;
+  int64_t live;
+  int64_t peak;
+} bench_allocs_t;
+
+/*!
+ * Allocations of the current thread, counted while `tracked` is set.
+ *
+ * @private
+ */
+static BENCH_THREAD_LOCAL bench_allocs_t _bench_thread_allocs;
 
 /**
- * Add a named sub-group
+ * Initialize allocation totals.
  *
- * ```c
- * void sub_group(bench_t* b) {
- *   bench_measure(b, "fast", bench_fast);
- *   bench_measure(b, "slow", bench_slow);
- * }
+ * @param allocs The bench_allocs_t to initialize.
+ */
+static inline void bench_allocs_init(bench_allocs_t* allocs) {
+  allocs->tracked = false;
+  allocs->count = 0;
+  allocs->bytes = 0;
+  allocs->live = 0;
+  allocs->peak = 0;
+}
+
+/**
+ * Add allocation totals from another thread to a measurement.
  *
- * bench_t* b = bench_create("bench", stdout);
- * bench_group(b, "sub-group", sub_group);
- * bench_compare(b);
- * ```
+ * @param allocs The totals to add to.
+ * @param other The totals to add.
+ */
+static inline void bench_allocs_merge(bench_allocs_t* allocs, const bench_allocs_t* other) {
+  allocs->tracked = allocs->tracked || other->tracked;
+  allocs->count += other->count;
+  allocs->bytes += other->bytes;
+  allocs->peak += other->peak;
+}
+
+/*!
+ * Count an allocation of the current thread.
  *
- * ```
- * benc.h v1.0.0
- * # bench
- *   # sub-group
- *   fast - 26.92m i/s (±49.87%) (34.11ns/i)
- *   slow - 3.53m i/s (±165.47%) (278.89ns/i)
- * ```
+ * @private
+ * @param size The number of bytes requested.
+ * @param usable The number of bytes actually allocated.
+ */
+static inline void _bench_allocs_add(size_t size, size_t usable) {
+  bench_allocs_t* allocs = &_bench_thread_allocs;
+  if (!allocs->tracked) return;
+  allocs->count++;
+  allocs->bytes += size;
+  allocs->live += (int64_t) usable;
+  if (allocs->live > allocs->peak) allocs->peak = allocs->live;
+}
+
+/*!
+ * Count a free of the current thread.
  *
- * @param b bench namespace
- * @param name Group name
- * @param fn Group function
- * @param ptr Optional pointer to attach to bench_t given to group function
+ * @private
+ * @param usable The number of bytes actually allocated.
  */
-static inline void bench_group(bench_t* b, const char *name, bench_group_fn fn, void *ptr, ...) {
-  bench_t* b2 = bench_create(name, b->out, b->indent + 2, ptr);
-  fn(b2);
-  bench_compare(b2);
+static inline void _bench_allocs_remove(size_t usable) {
+  bench_allocs_t* allocs = &_bench_thread_allocs;
+  if (!allocs->tracked) return;
+  allocs->live -= (int64_t) usable;
 }
 
-// Hack to make ptr optional
-#define bench_group(t, name, fn, ...) \
-  bench_group(t, name, fn, ##__VA_ARGS__, NULL)
+/*!
+ * Start counting allocations of the current thread, if enabled.
+ *
+ * @private
+ * @param enabled Whether to track allocations.
+ */
+static inline void _bench_allocs_start(bool enabled) {
+  bench_allocs_init(&_bench_thread_allocs);
+#ifdef BENCH_HOOKS_ALLOCATIONS
+  _bench_thread_allocs.tracked = enabled;
+#else
+  (void) enabled;
+#endif
+}
 
 /*!
- * Initialize a new bench measurement.
+ * Stop counting allocations of the current thread, and add what was counted
+ * to the given totals.
  *
  * @private
- * @param m The measurement to initialize.
- * @param name The name of the measurement.
+ * @param allocs The totals to add to.
  */
-static inline void bench_measurement_init(
-  bench_measurement_t* m,
-  const char* name
-) {
-  m->name = strdup(name);
-  bench_stats_init(&m->stats);
+static inline void _bench_allocs_stop(bench_allocs_t* allocs) {
+  bench_allocs_t* counted = &_bench_thread_allocs;
+  if (!counted->tracked) return;
+  counted->tracked = false;
+  allocs->tracked = true;
+  allocs->count += counted->count;
+  allocs->bytes += counted->bytes;
+  if (counted->peak > allocs->peak) allocs->peak = counted->peak;
 }
 
-/**
- * Measure function signature
+/*!
+ * Pause counting allocations of the current thread, such as for untimed
+ * fixture setup.
  *
- * @param data Optional pointer passed through from `bench_measure`
+ * @private
+ * @return Whether allocations were being counted, to pass to `_bench_allocs_resume`.
  */
-typedef void (*bench_measure_fn)(void* data);
+static inline bool _bench_allocs_pause() {
+  bool tracked = _bench_thread_allocs.tracked;
+  _bench_thread_allocs.tracked = false;
+  return tracked;
+}
 
 /*!
- * Get high-resolution monotonic timestamp.
+ * Resume counting allocations of the current thread after a pause.
  *
  * @private
- * @todo Support Windows
- * @return Monotonic timestamp in nanoseconds.
+ * @param tracked The value returned by `_bench_allocs_pause`.
  */
-static inline uint64_t bench_now() {
-#ifdef __APPLE__
-  return mach_continuous_time() * timebase.numer / timebase.denom;
-#else
-  struct timespec t;
-  clock_gettime(CLOCK_MONOTONIC, &t);
-  return t.tv_sec * SECONDS + t.tv_nsec;
-#endif
+static inline void _bench_allocs_resume(bool tracked) {
+  _bench_thread_allocs.tracked = tracked;
 }
 
 /**
- * Measure performance of the given function.
- *
- * ```c
- * bench_t* b = bench_create("bench", stdout);
- * bench_measure(b, "fast", bench_fast);
- * bench_measure(b, "slow", bench_slow);
- * bench_compare(b);
- * ```
+ * Print allocations per iteration and peak live bytes.
  *
- * ```
- * benc.h v1.0.0
- * # bench
- * fast - 26.92m i/s (±49.87%) (34.11ns/i)
- * slow - 3.53m i/s (±165.47%) (278.89ns/i)
- * ```
+ * @param allocs The allocation totals to print.
+ * @param iterations The number of iterations the allocations were made over.
+ * @param out The file to write to.
+ */
+static inline void bench_allocs_print(const bench_allocs_t* allocs, uint64_t iterations, FILE* out) {
+  if (iterations == 0) iterations = 1;
+  fprintf(out, "%.2f allocs/i, ", (double) allocs->count / iterations);
+  bench_human_bytes(out, (double) allocs->bytes / iterations);
+  fprintf(out, "/i, peak ");
+  bench_human_bytes(out, allocs->peak > 0 ? (double) allocs->peak : 0);
+}
+
+#if defined(BENCH_TRACK_ALLOCATIONS) && defined(__GLIBC__)
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_add(size, malloc_usable_size(ptr));
+  }
+  return ptr;
+}
+
+void* calloc(size_t count, size_t size) {
+  void* ptr = __libc_calloc(count, size);
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_add(count * size, malloc_usable_size(ptr));
+  }
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+  size_t before = ptr != NULL && _bench_thread_allocs.tracked ? malloc_usable_size(ptr) : 0;
+  void* result = __libc_realloc(ptr, size);
+  if ((result != NULL || size == 0) && _bench_thread_allocs.tracked) {
+    _bench_allocs_remove(before);
+    if (result != NULL) _bench_allocs_add(size, malloc_usable_size(result));
+  }
+  return result;
+}
+
+void free(void* ptr) {
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_remove(malloc_usable_size(ptr));
+  }
+  __libc_free(ptr);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/*!
+ * Allocate without being counted, for the replaced `operator new`.
  *
- * @param b bench namespace
- * @param name Measurement name
- * @param fn Measurement function
- * @param data Optional pointer passed to `fn`
+ * @private
  */
-static inline int bench_measure(bench_t* b, const char* name, bench_measure_fn fn, void* data, ...) {
+static inline void* _bench_raw_malloc(size_t size) {
+  return __libc_malloc(size);
+}
+
+/*!
+ * Free without being counted, for the replaced `operator delete`.
+ *
+ * @private
+ */
+static inline void _bench_raw_free(void* ptr) {
+  __libc_free(ptr);
+}
+
+/*!
+ * The number of bytes actually allocated for a pointer.
+ *
+ * @private
+ */
+static inline size_t _bench_usable_size(void* ptr) {
+  return malloc_usable_size(ptr);
+}
+#elif defined(BENCH_TRACK_ALLOCATIONS) && defined(__APPLE__)
+/*!
+ * The functions of the default malloc zone, from before it was hooked.
+ *
+ * @private
+ */
+static malloc_zone_t _bench_zone;
+
+static void* _bench_zone_malloc(malloc_zone_t* zone, size_t size) {
+  void* ptr = _bench_zone.malloc(zone, size);
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_add(size, malloc_size(ptr));
+  }
+  return ptr;
+}
+
+static void* _bench_zone_calloc(malloc_zone_t* zone, size_t count, size_t size) {
+  void* ptr = _bench_zone.calloc(zone, count, size);
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_add(count * size, malloc_size(ptr));
+  }
+  return ptr;
+}
+
+static void* _bench_zone_realloc(malloc_zone_t* zone, void* ptr, size_t size) {
+  size_t before = ptr != NULL && _bench_thread_allocs.tracked ? malloc_size(ptr) : 0;
+  void* result = _bench_zone.realloc(zone, ptr, size);
+  if (result != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_remove(before);
+    _bench_allocs_add(size, malloc_size(result));
+  }
+  return result;
+}
+
+static void _bench_zone_free(malloc_zone_t* zone, void* ptr) {
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_remove(malloc_size(ptr));
+  }
+  _bench_zone.free(zone, ptr);
+}
+
+static void _bench_zone_free_definite_size(malloc_zone_t* zone, void* ptr, size_t size) {
+  if (ptr != NULL && _bench_thread_allocs.tracked) {
+    _bench_allocs_remove(malloc_size(ptr));
+  }
+  _bench_zone.free_definite_size(zone, ptr, size);
+}
+
+/*!
+ * Hook the default malloc zone before main runs.
+ *
+ * @private
+ */
+__attribute__((constructor)) static void _bench_zone_hook() {
+  malloc_zone_t* zone = malloc_default_zone();
+  _bench_zone = *zone;
+
+  // The default zone is read-only since macOS 10.7
+  vm_protect(mach_task_self(), (vm_address_t) zone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+  zone->malloc = _bench_zone_malloc;
+  zone->calloc = _bench_zone_calloc;
+  zone->realloc = _bench_zone_realloc;
+  zone->free = _bench_zone_free;
+  if (zone->version >= 6 && zone->free_definite_size != NULL) {
+    zone->free_definite_size = _bench_zone_free_definite_size;
+  }
+  vm_protect(mach_task_self(), (vm_address_t) zone, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+}
+
+static inline void* _bench_raw_malloc(size_t size) {
+  return _bench_zone.malloc(malloc_default_zone(), size);
+}
+
+static inline void _bench_raw_free(void* ptr) {
+  _bench_zone.free(malloc_default_zone(), ptr);
+}
+
+static inline size_t _bench_usable_size(void* ptr) {
+  return malloc_size(ptr);
+}
+#elif defined(BENCH_TRACK_ALLOCATIONS)
+static inline void* _bench_raw_malloc(size_t size) {
+  return malloc(size);
+}
+
+static inline void _bench_raw_free(void* ptr) {
+  free(ptr);
+}
+
+static inline size_t _bench_usable_size(void* ptr) {
+#ifdef _WIN32
+  return _msize(ptr);
+#else
+  (void) ptr;
+  return 0;
+#endif
+}
+#endif
+
+/*!
+ * A named measurement with stats.
+ *
+ * @property name The name of the measurement.
+ * @property stats The stats of the measurement.
+ * @property histogram The distribution of per-iteration times in picoseconds.
+ *   When calls are batched, each batch counts as its per-iteration mean.
+ * @property threads The number of threads the measurement ran on.
+ * @property wall The wall-clock time in nanoseconds of a parallel or
+ *   asynchronous measurement.
+ * @property in_flight The number of operations an asynchronous measurement
+ *   kept in flight, or 0.
+ * @property rate The target calls per second of an open-loop measurement,
+ *   or 0.
+ * @property overhead The nanoseconds per iteration spent calling the
+ *   measured code, subtracted when `subtract_overhead` is set.
+ * @property chunk The most iterations timed per clock read, or 0 when each
+ *   sample reads the clock once.
+ * @property cpus The CPU each thread ran on when pinned, or NULL.
+ * @property nodes The NUMA node each thread ran on when pinned, or NULL.
+ * @property counters Hardware performance counters, when enabled.
+ * @property allocs Heap allocations, when tracked.
+ * @property repetitions The mean of each repetition in picoseconds, when
+ *   the measurement was repeated.
+ * @property arg The argument of a range measurement.
+ * @property has_arg Whether the measurement is part of a range.
+ * @property bytes The number of bytes processed per iteration, or 0.
+ * @property items The number of items processed per iteration, or 0.
+ * @property run The batch runner of a measurement deferred to run in rounds.
+ * @property ctx The pointer passed to `run`.
+ * @property ctx_free Frees `ctx` once the measurement has run, or NULL.
+ * @property iterations The calibrated number of iterations per sample of a
+ *   deferred measurement.
+ * @property trace The ring the samples of a deferred measurement are traced
+ *   to, or NULL.
+ */
+typedef struct bench_measurement_s {
+  const char* name;
+  bench_stats_t stats;
+  bench_histogram_t histogram;
+  bench_counters_t counters;
+  bench_allocs_t allocs;
+  bench_stats_t repetitions;
+  uint32_t threads;
+  uint64_t wall;
+  uint32_t in_flight;
+  double rate;
+  double overhead;
+  uint64_t chunk;
+  int* cpus;
+  int* nodes;
+  uint64_t arg;
+  bool has_arg;
+  uint64_t bytes;
+  uint64_t items;
+  bench_batch_fn run;
+  void* ctx;
+  void (*ctx_free)(void* ctx);
+  uint64_t iterations;
+  struct bench_trace_ring_s* trace;
+} bench_measurement_t;
+
+/*!
+ * Returns the operations per second of the measurement. For parallel
+ * measurements this is the aggregate across all threads, and for
+ * asynchronous ones across all operations in flight.
+ *
+ * @param m The bench_measurement_t for which to compute operations per second.
+ * @return The operations per second of the measurement.
+ */
+static inline double bench_measurement_ops_per_sec(bench_measurement_t* m) {
+  if ((m->threads > 1 || m->in_flight > 0 || m->rate > 0) && m->wall > 0) {
+    return ((double) m->stats.count / (double) m->wall) * SECONDS;
+  }
+  return bench_stats_ops_per_sec(&m->stats);
+}
+
+/*!
+ * Free the context of a measurement which has not run. The measurement itself
+ * lives in the arena of its suite.
+ *
+ * @param m The bench_measurement_t to free.
+ */
+static inline void bench_measurement_free(bench_measurement_t* m) {
+  if (m->ctx_free != NULL) m->ctx_free(m->ctx);
+  m->ctx_free = NULL;
+}
+
+// A list of measurements
+typedef bench_array_t bench_measurements_t;
+
+/**
+ * Placement policies for the threads of a parallel measurement.
+ *
+ * - `BENCH_PLACEMENT_NONE` leaves placement to the scheduler.
+ * - `BENCH_PLACEMENT_COMPACT` fills one socket before moving to the next.
+ * - `BENCH_PLACEMENT_SPREAD` alternates sockets thread by thread.
+ * - `BENCH_PLACEMENT_LIST` uses the CPUs in `cpu_list`, in order.
+ */
+typedef enum bench_placement_e {
+  BENCH_PLACEMENT_NONE,
+  BENCH_PLACEMENT_COMPACT,
+  BENCH_PLACEMENT_SPREAD,
+  BENCH_PLACEMENT_LIST
+} bench_placement_t;
+
+/**
+ * Orders in which the measurements of a group are run.
+ *
+ * - `BENCH_ORDER_SEQUENTIAL` runs each measurement to completion in turn.
+ * - `BENCH_ORDER_ROUND_ROBIN` runs the measurements in short rounds, in the
+ *   order they were declared.
+ * - `BENCH_ORDER_RANDOM` runs the measurements in short rounds, shuffled for
+ *   every round.
+ */
+typedef enum bench_order_e {
+  BENCH_ORDER_SEQUENTIAL,
+  BENCH_ORDER_ROUND_ROBIN,
+  BENCH_ORDER_RANDOM
+} bench_order_t;
+
+/**
+ * Arrival processes scheduling the calls of an open-loop measurement.
+ *
+ * - `BENCH_ARRIVAL_CONSTANT` starts calls at a fixed interval.
+ * - `BENCH_ARRIVAL_POISSON` starts calls at exponentially distributed
+ *   intervals with the same mean, as independent clients would.
+ */
+typedef enum bench_arrival_e {
+  BENCH_ARRIVAL_CONSTANT,
+  BENCH_ARRIVAL_POISSON
+} bench_arrival_t;
+
+/**
+ * How measurements are isolated from each other in separate processes.
+ *
+ * - `BENCH_ISOLATION_NONE` runs everything in the calling process.
+ * - `BENCH_ISOLATION_MEASUREMENT` forks a child process per measurement.
+ * - `BENCH_ISOLATION_GROUP` forks a child process per group.
+ *
+ * A child starts from a copy of the parent, without the heap growth, warmed
+ * caches and page tables of the measurements run in other children. Results
+ * are sent back over a pipe and printed as usual, and a crash fails only the
+ * measurement or group it happened in. Isolation is only available with
+ * `fork`, and is skipped for measurements run in rounds, for groups run
+ * concurrently with `jobs`, and on Windows. It is also skipped, with a
+ * warning, while `bench_trace` is tracing samples, as the trace writer is a
+ * thread which a child would not have. Counts are sent back for reporters added to
+ * the suite, but no other reporter state is.
+ */
+typedef enum bench_isolation_e {
+  BENCH_ISOLATION_NONE,
+  BENCH_ISOLATION_MEASUREMENT,
+  BENCH_ISOLATION_GROUP
+} bench_isolation_t;
+
+/**
+ * Results of the reference kernels run by `bench_reference`, which describe
+ * the machine so results from different machines can be normalized.
+ * Latencies are in nanoseconds and bandwidths in bytes per second.
+ */
+typedef enum bench_reference_e {
+  BENCH_REFERENCE_L1_LATENCY,
+  BENCH_REFERENCE_L2_LATENCY,
+  BENCH_REFERENCE_L3_LATENCY,
+  BENCH_REFERENCE_DRAM_LATENCY,
+  BENCH_REFERENCE_READ_BANDWIDTH,
+  BENCH_REFERENCE_SIMD_READ_BANDWIDTH,
+  BENCH_REFERENCE_WRITE_BANDWIDTH,
+  BENCH_REFERENCE_STREAM_WRITE_BANDWIDTH,
+  BENCH_REFERENCE_COPY_BANDWIDTH,
+  BENCH_REFERENCE_ATOMIC_ADD_LATENCY,
+  BENCH_REFERENCE_ATOMIC_CAS_LATENCY,
+  BENCH_REFERENCE_COUNT
+} bench_reference_t;
+
+/*!
+ * The key a reference result is exported with.
+ *
+ * @private
+ * @param kind The reference result.
+ * @return The key, with the unit as a suffix.
+ */
+static inline const char* _bench_reference_key(bench_reference_t kind) {
+  static const char* keys[BENCH_REFERENCE_COUNT] = {
+    "l1_latency_ns",
+    "l2_latency_ns",
+    "l3_latency_ns",
+    "dram_latency_ns",
+    "read_bytes_per_sec",
+    "simd_read_bytes_per_sec",
+    "write_bytes_per_sec",
+    "stream_write_bytes_per_sec",
+    "copy_bytes_per_sec",
+    "atomic_add_ns",
+    "atomic_cas_ns"
+  };
+  return keys[kind];
+}
+
+/**
+ * A bench namespace.
+ *
+ * @property name The name of the benchmark suite.
+ * @property out The target to which output is written.
+ * @property indent The indentation level for sub-groups.
+ * @property data A free pointer slot to pass data into sub-groups.
+ * @property target_time The approximate time in nanoseconds to run each measurement.
+ * @property batch_time The minimum time in nanoseconds of each sample. When
+ *   non-zero, calls are batched so clock overhead is amortized across them.
+ * @property clock The clock source used to time samples.
+ * @property show_cycles Whether to also print results in cycles per iteration.
+ * @property subtract_overhead Whether to subtract the overhead measured by
+ *   `bench_subtract_overhead` from results.
+ * @property warmup_time The minimum time in nanoseconds to run a measurement
+ *   before recording samples.
+ * @property warmup_iterations The minimum number of calls to run before
+ *   recording samples.
+ * @property steady_state When non-zero, keep warming up until the relative
+ *   standard deviation of recent samples falls to this ratio (e.g. 0.05),
+ *   for at most `target_time`.
+ * @property target_rme When non-zero, stop each measurement as soon as the
+ *   relative margin of error of the mean at 95% confidence falls to this
+ *   percentage (e.g. 1.0), rather than after `target_time`.
+ * @property min_time The minimum time in nanoseconds to record samples for
+ *   when `target_rme` is set.
+ * @property max_time The maximum time in nanoseconds to record samples for
+ *   when `target_rme` is set, or 0 to use `target_time`.
+ * @property percentiles Whether to print latency percentiles and max.
+ * @property cpu The CPU to pin the measuring thread to, or -1 to not pin.
+ * @property placement How to pin the threads of parallel measurements.
+ * @property cpu_list The CPUs to use with `BENCH_PLACEMENT_LIST`.
+ * @property cpu_list_size The number of CPUs in `cpu_list`.
+ * @property counters Whether to collect hardware performance counters.
+ * @property allocations Whether to track heap allocations, when built with
+ *   `BENCH_TRACK_ALLOCATIONS`.
+ * @property bytes The number of bytes each iteration processes, to report
+ *   throughput in bytes per second. For range measurements, this is per unit
+ *   of the argument.
+ * @property items The number of items each iteration processes, to report
+ *   throughput in items per second. For range measurements, this is per unit
+ *   of the argument.
+ * @property complexity Whether to fit the results of range measurements to a
+ *   complexity class when comparing them.
+ * @property measurements The list of measurements.
+ * @property order The order in which the measurements of a group are run.
+ *   Other than sequentially, measurements are deferred until the group is
+ *   compared, then run in rounds so drift affects them all alike. Parallel
+ *   measurements always run in place.
+ * @property round_time The time in nanoseconds each measurement records
+ *   samples for in a round, when not run sequentially.
+ * @property repetitions The number of times to repeat each measurement. The
+ *   samples of every repetition are aggregated, and the spread of the means
+ *   of the repetitions is reported.
+ * @property arrival How open-loop measurements schedule their calls.
+ * @property isolation Whether to run each measurement or group in its own
+ *   child process, on POSIX systems. See `bench_isolation_t`.
+ * @property filter When set on the top-level suite, only measurements whose
+ *   slash-separated path, such as `bench/group/name`, matches this extended
+ *   regular expression are run. A filter which is not a valid expression
+ *   matches paths containing it instead.
+ * @property list When set on the top-level suite, print the path of each
+ *   measurement rather than running it.
+ * @property regression_threshold The slowdown in percent of the mean over the
+ *   baseline beyond which a significant difference counts as a regression.
+ * @property jobs When above one on the top-level suite, its groups are run
+ *   concurrently by this many workers, each pinned to its own core, which
+ *   becomes the `cpu` of the group. The output of each group is buffered and
+ *   printed in the order the groups were added.
+ * @property parent The bench namespace of the enclosing group, or NULL.
+ * @property reporters The reporters results are exported to, kept on the
+ *   top-level suite.
+ * @property baseline The results loaded with `bench_load_baseline`, kept on
+ *   the top-level suite.
+ * @property groups The groups waiting for the workers, kept on the top-level
+ *   suite when `jobs` is above one.
+ * @property regressions The number of measurements which regressed against
+ *   the baseline, counted on the top-level suite.
+ * @property reference The results of `bench_reference`, indexed by
+ *   `bench_reference_t` and zero when not measured, kept on the top-level
+ *   suite.
+ * @property environment The environment probed by `bench_environment` on
+ *   the top-level suite, or NULL.
+ * @property filter_regex The compiled `filter`.
+ * @property filter_invalid Whether `filter` could not be compiled, so it is
+ *   not compiled again.
+ * @property trace The trace raw samples are streamed to, set with
+ *   `bench_trace` on the top-level suite, or NULL.
+ * @property arena The arena the bookkeeping of the suite and all of its
+ *   groups is allocated from, kept on the top-level suite.
+ * @property lock The mutex guarding the top-level suite while groups run
+ *   concurrently, or NULL.
+ * @property header_printed Whether the `# name` header has been printed.
+ */
+typedef struct bench_s {
+  const char* name;
+  FILE* out;
+  int indent;
+  void* data;
+  uint64_t target_time;
+  uint64_t batch_time;
+  bench_clock_t clock;
+  bool show_cycles;
+  bool subtract_overhead;
+  uint64_t warmup_time;
+  uint64_t warmup_iterations;
+  float steady_state;
+  float target_rme;
+  uint64_t min_time;
+  uint64_t max_time;
+  bool percentiles;
+  int cpu;
+  bench_placement_t placement;
+  const int* cpu_list;
+  size_t cpu_list_size;
+  bool counters;
+  bool allocations;
+  uint64_t bytes;
+  uint64_t items;
+  bool complexity;
+  bench_measurements_t measurements;
+  bench_order_t order;
+  uint64_t round_time;
+  uint32_t repetitions;
+  bench_arrival_t arrival;
+  bench_isolation_t isolation;
+  const char* filter;
+  bool list;
+  float regression_threshold;
+  uint32_t jobs;
+  struct bench_s* parent;
+  bench_array_t reporters;
+  bench_array_t baseline;
+  bench_array_t groups;
+  size_t regressions;
+  double reference[BENCH_REFERENCE_COUNT];
+  struct bench_environment_s* environment;
+  void* filter_regex;
+  bool filter_invalid;
+  struct bench_trace_s* trace;
+  bench_arena_t arena;
+  void* lock;
+  bool header_printed;
+} bench_t;
+
+// Defined with the threads, which run the trace writer
+static inline void _bench_trace_free(struct bench_trace_s* trace);
+
+/*!
+ * Allocate bookkeeping memory from the arena of the suite.
+ *
+ * @private
+ * @param b bench namespace
+ * @param size The number of bytes to allocate.
+ * @return The zeroed memory, or NULL.
+ */
+static inline void* _bench_alloc(bench_t* b, size_t size) {
+  while (b->parent != NULL) b = b->parent;
+  return bench_arena_alloc(&b->arena, size);
+}
+
+/*!
+ * Copy a string into the arena of the suite.
+ *
+ * @private
+ * @param b bench namespace
+ * @param value The string to copy.
+ * @return The copy, or NULL.
+ */
+static inline char* _bench_strdup(bench_t* b, const char* value) {
+  while (b->parent != NULL) b = b->parent;
+  return bench_arena_strdup(&b->arena, value);
+}
+
+/*!
+ * Free the benchmark. The memory of a sub-group stays in the arena until the
+ * top-level suite is freed, which releases all of it at once.
+ *
+ * @private
+ * @param b bench namespace
+ */
+static inline void bench_free(bench_t* b) {
+  for (size_t i = 0; i < b->measurements.size; i++) {
+    bench_measurement_free((bench_measurement_t*) b->measurements.entries[i]);
+  }
+  bench_array_clear(&b->measurements);
+  for (size_t i = 0; i < b->reporters.size; i++) {
+    free(b->reporters.entries[i]);
+  }
+  bench_array_clear(&b->reporters);
+  bench_array_clear(&b->baseline);
+  bench_array_clear(&b->groups);
+#ifndef _WIN32
+  if (b->filter_regex != NULL) {
+    regfree((regex_t*) b->filter_regex);
+  }
+#endif
+  free(b->filter_regex);
+  if (b->trace != NULL) {
+    _bench_trace_free(b->trace);
+  }
+  if (b->parent == NULL) {
+    bench_arena_free(&b->arena);
+    free(b);
+  }
+}
+
+/*!
+ * Print indentation level for sub-groups
+ *
+ * @private
+ * @param b bench namespace
+ */
+static inline void _bench_print_indent(bench_t* b) {
+  for (int i = 0; i < b->indent; i++) {
+    fprintf(b->out, " ");
+  }
+}
+
+/*!
+ * Print the `# name` header of a bench namespace, and of the groups it
+ * belongs to if they have not been printed yet.
+ *
+ * @private
+ * @param b bench namespace
+ */
+static inline void _bench_print_header(bench_t* b) {
+  if (b->header_printed) return;
+  if (b->parent != NULL) {
+    _bench_print_header(b->parent);
+  }
+
+  // For top-level suite, print the version too
+  if (b->indent == 0) {
+    fprintf(b->out, "benc.h v" BENCH_VERSION "\n");
+  }
+  _bench_print_indent(b);
+  fprintf(b->out, "# %s\n", b->name);
+  b->header_printed = true;
+}
+
+/*!
+ * Create a bench namespace, optionally leaving its header to be printed
+ * with its first measurement.
+ *
+ * @private
+ * @param parent The bench namespace of the enclosing group, whose arena the
+ *   namespace is allocated from, or NULL for a top-level suite.
+ * @param name The name of the benchmark suite
+ * @param out FILE to which the benchmark output will be written
+ * @param indent The indentation level for sub-groups
+ * @param data A free pointer slot to pass data into sub-groups
+ * @param header Whether to print the header now
+ * @return bench_t
+ */
+static inline bench_t* _bench_create(bench_t* parent, const char* name, FILE* out, int indent, void* data, bool header) {
+  bench_t* b = parent == NULL
+    ? (bench_t*) calloc(1, sizeof(bench_t))
+    : (bench_t*) _bench_alloc(parent, sizeof(bench_t));
+  if (b == NULL) return NULL;
+  b->parent = parent;
+  if (parent == NULL) {
+    bench_arena_init(&b->arena);
+  }
+
+  b->out = out;
+  b->indent = indent;
+  b->data = data;
+  b->target_time = SECONDS;
+  b->batch_time = 0;
+  b->clock = BENCH_CLOCK_MONOTONIC;
+  b->show_cycles = false;
+  b->subtract_overhead = false;
+  b->warmup_time = 0;
+  b->warmup_iterations = 0;
+  b->steady_state = 0;
+  b->target_rme = 0;
+  b->min_time = 0;
+  b->max_time = 0;
+  b->percentiles = false;
+  b->cpu = -1;
+  b->placement = BENCH_PLACEMENT_NONE;
+  b->cpu_list = NULL;
+  b->cpu_list_size = 0;
+  b->counters = false;
+  b->allocations = false;
+  b->bytes = 0;
+  b->items = 0;
+  b->complexity = false;
+  b->order = BENCH_ORDER_SEQUENTIAL;
+  b->round_time = 10 * MILLIS;
+  b->regression_threshold = 5;
+  b->repetitions = 1;
+  b->arrival = BENCH_ARRIVAL_CONSTANT;
+  b->isolation = BENCH_ISOLATION_NONE;
+  b->filter = NULL;
+  b->list = false;
+  b->jobs = 0;
+  b->regressions = 0;
+  for (int i = 0; i < BENCH_REFERENCE_COUNT; i++) {
+    b->reference[i] = 0;
+  }
+  b->environment = NULL;
+  b->filter_regex = NULL;
+  b->filter_invalid = false;
+  b->trace = NULL;
+  b->lock = NULL;
+  b->header_printed = false;
+
+  // Attempt to allocate the name and bench arrays
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  // Reporters are only kept on the top-level suite
+  b->name = _bench_strdup(b, name);
+  if (b->name == NULL ||
+      (parent == NULL && !bench_array_init_arena(&b->reporters, 4, &root->arena)) ||
+      !bench_array_init_arena(&b->baseline, 16, &root->arena) ||
+      !bench_array_init_arena(&b->groups, 4, &root->arena) ||
+      !bench_array_init_arena((bench_measurements_t*) &b->measurements, 16, &root->arena)) {
+    bench_free(b);
+    return NULL;
+  }
+
+  if (header) {
+    _bench_print_header(b);
+  }
+
+  return b;
+}
+
+/**
+ * Creates a benchmark writing to the given FILE.
+ *
+ * ```c
+ * bench_t* b = bench_create("name", stdout);
+ * // or...
+ * bench_t* b = bench_create("name", fopen("out.bench", "w"));
+ * ```
+ *
+ * @param name The name of the benchmark suite
+ * @param out FILE to which the benchmark output will be written
+ * @param indent The indentation level for sub-groups
+ * @param data A free pointer slot to pass data into sub-groups
+ * @return bench_t
+ */
+static inline bench_t* bench_create(const char* name, FILE* out, int indent, void* data, ...) {
+  return _bench_create(NULL, name, out, indent, data, true);
+}
+// Make out parameter optional, defaulting to stdout
+#define bench_create(name, out, ...) bench_create(name, out, ##__VA_ARGS__, 0, NULL)
+
+/**
+ * Preallocate memory for the bookkeeping of a suite, such as its groups and
+ * measurements, before measuring starts. Bookkeeping memory is mapped
+ * directly from the operating system rather than taken from the heap used by
+ * the code being measured, and is freed all at once with the suite.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_reserve(b, 4 * 1024 * 1024);
+ * ```
+ *
+ * @param b bench namespace
+ * @param bytes The number of bytes to preallocate.
+ * @return Whether the memory was preallocated.
+ */
+static inline bool bench_reserve(bench_t* b, size_t bytes) {
+  while (b->parent != NULL) b = b->parent;
+  return bench_arena_reserve(&b->arena, bytes);
+}
+
+/*!
+ * Compare two measurements to sort by operations per second.
+ *
+ * @private
+ * @param a The first measurement cast as `const void*`.
+ * @param b The second measurement cast as `const void*`.
+ */
+static inline int _bench_compare_measurement(const void* a, const void* b) {
+  bench_measurement_t* ma = *(bench_measurement_t**) a;
+  bench_measurement_t* mb = *(bench_measurement_t**) b;
+
+  double current = bench_measurement_ops_per_sec(ma);
+  double next = bench_measurement_ops_per_sec(mb);
+
+  if (current > next) return -1;
+  if (current < next) return 1;
+  return 0;
+}
+
+/**
+ * Reporters.
+ */
+
+/**
+ * A reporter exports results in a machine-readable form, alongside the human
+ * readable output written to `b->out`. Any number of reporters can be added
+ * to a suite with `bench_add_reporter`.
+ *
+ * @property measurement Called with each measurement as it completes, and
+ *   the slash-separated path of the group it belongs to.
+ * @property finish Called once the top-level suite has been compared.
+ * @property out The file to which the reporter writes.
+ * @property count The number of measurements reported so far.
+ * @property data A free pointer slot for custom reporters.
+ */
+typedef struct bench_reporter_s {
+  void (*measurement)(struct bench_reporter_s* r, bench_t* b, const char* group, bench_measurement_t* m);
+  void (*finish)(struct bench_reporter_s* r, bench_t* b);
+  FILE* out;
+  size_t count;
+  void* data;
+} bench_reporter_t;
+
+/**
+ * Add a reporter to the suite. The reporter must be allocated with `malloc`,
+ * and is freed along with the top-level suite.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_add_reporter(b, bench_json_reporter(fopen("bench.json", "w")));
+ * ```
+ *
+ * @param b bench namespace
+ * @param reporter The reporter to add.
+ * @return Whether the reporter could be added.
+ */
+static inline bool bench_add_reporter(bench_t* b, bench_reporter_t* reporter) {
+  if (reporter == NULL) return false;
+  while (b->parent != NULL) b = b->parent;
+  if (!bench_array_push(&b->reporters, reporter)) {
+    free(reporter);
+    return false;
+  }
+  return true;
+}
+
+/*!
+ * Write the slash-separated path of a group, from the top-level suite down.
+ *
+ * @private
+ * @param b bench namespace
+ * @param path The buffer to write to.
+ * @param size The size of the buffer.
+ * @return The length of the path written.
+ */
+static inline size_t _bench_group_path(bench_t* b, char* path, size_t size) {
+  size_t length = 0;
+  if (b->parent != NULL) {
+    length = _bench_group_path(b->parent, path, size);
+    if (length + 1 < size) path[length++] = '/';
+  }
+  int written = snprintf(path + length, length < size ? size - length : 0, "%s", b->name);
+  length += written > 0 ? (size_t) written : 0;
+  return length < size ? length : size - 1;
+}
+
+/*!
+ * Compile the filter of a top-level suite, the first time it is needed. A
+ * filter which fails to compile sets `filter_invalid` and is not compiled
+ * again.
+ *
+ * @private
+ * @param root The top-level bench namespace
+ * @return Whether `filter_regex` holds the compiled filter.
+ */
+static inline bool _bench_filter_compile(bench_t* root) {
+#ifdef _WIN32
+  (void) root;
+  return false;
+#else
+  if (root->filter == NULL || root->filter_invalid) return false;
+  if (root->filter_regex == NULL) {
+    // Without memory to compile it, the filter matches substrings for now
+    regex_t* regex = (regex_t*) malloc(sizeof(regex_t));
+    if (regex == NULL) return false;
+    if (regcomp(regex, root->filter, REG_EXTENDED | REG_NOSUB) != 0) {
+      free(regex);
+      root->filter_invalid = true;
+      return false;
+    }
+    root->filter_regex = regex;
+  }
+  return true;
+#endif
+}
+
+/*!
+ * Whether a measurement should be skipped, because it does not match the
+ * filter of the suite or the suite is only listing measurements, in which
+ * case its path is printed.
+ *
+ * @private
+ * @param b bench namespace the measurement belongs to
+ * @param name Measurement name
+ * @return Whether to skip the measurement.
+ */
+static inline bool _bench_skip(bench_t* b, const char* name) {
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  if (root->filter == NULL && !root->list) return false;
+
+  char path[768];
+  size_t length = _bench_group_path(b, path, sizeof(path) - 1);
+  snprintf(path + length, sizeof(path) - length, "/%s", name);
+
+  if (root->filter != NULL) {
+#ifdef _WIN32
+    // Without POSIX regular expressions, filters match substrings
+    if (strstr(path, root->filter) == NULL) return true;
+#else
+    if (!_bench_filter_compile(root)) {
+      // Filters which are not valid expressions match substrings
+      if (strstr(path, root->filter) == NULL) return true;
+    } else if (regexec((regex_t*) root->filter_regex, path, 0, NULL, 0) != 0) {
+      return true;
+    }
+#endif
+  }
+
+  if (root->list) {
+    fprintf(b->out, "%s\n", path);
+    return true;
+  }
+  return false;
+}
+
+// Defined with the threads, which provide the mutex
+static inline void _bench_lock(bench_t* root);
+static inline void _bench_unlock(bench_t* root);
+
+/*!
+ * Pass a completed measurement to every reporter of the suite.
+ *
+ * @private
+ * @param b bench namespace the measurement belongs to
+ * @param m The measurement to report.
+ */
+static inline void _bench_report(bench_t* b, bench_measurement_t* m) {
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  if (root->reporters.size == 0) return;
+
+  char group[512];
+  _bench_group_path(b, group, sizeof(group));
+  _bench_lock(root);
+  for (size_t i = 0; i < root->reporters.size; i++) {
+    bench_reporter_t* r = (bench_reporter_t*) root->reporters.entries[i];
+    if (r->measurement) r->measurement(r, b, group, m);
+    r->count++;
+  }
+  _bench_unlock(root);
+}
+
+/*!
+ * Finish every reporter of a top-level suite.
+ *
+ * @private
+ * @param b The top-level bench namespace
+ */
+static inline void _bench_report_finish(bench_t* b) {
+  for (size_t i = 0; i < b->reporters.size; i++) {
+    bench_reporter_t* r = (bench_reporter_t*) b->reporters.entries[i];
+    if (r->finish) r->finish(r, b);
+    if (r->out) fflush(r->out);
+  }
+}
+
+/*!
+ * Allocate a reporter with the given callbacks.
+ *
+ * @private
+ */
+static inline bench_reporter_t* _bench_reporter_create(
+  FILE* out,
+  void (*measurement)(bench_reporter_t* r, bench_t* b, const char* group, bench_measurement_t* m),
+  void (*finish)(bench_reporter_t* r, bench_t* b)
+) {
+  if (out == NULL) return NULL;
+  bench_reporter_t* r = (bench_reporter_t*) malloc(sizeof(bench_reporter_t));
+  if (r == NULL) return NULL;
+  r->measurement = measurement;
+  r->finish = finish;
+  r->out = out;
+  r->count = 0;
+  r->data = NULL;
+  return r;
+}
+
+/*!
+ * The operating system the suite was built for.
+ *
+ * @private
+ */
+static inline const char* _bench_env_os() {
+#if defined(__APPLE__)
+  return "macos";
+#elif defined(_WIN32)
+  return "windows";
+#elif defined(__linux__)
+  return "linux";
+#elif defined(__FreeBSD__)
+  return "freebsd";
+#else
+  return "unknown";
+#endif
+}
+
+/*!
+ * The CPU architecture the suite was built for.
+ *
+ * @private
+ */
+static inline const char* _bench_env_arch() {
+#if defined(__x86_64__) || defined(_M_X64)
+  return "x86_64";
+#elif defined(__i386__) || defined(_M_IX86)
+  return "x86";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  return "aarch64";
+#elif defined(__arm__) || defined(_M_ARM)
+  return "arm";
+#else
+  return "unknown";
+#endif
+}
+
+/*!
+ * The number of online CPUs.
+ *
+ * @private
+ */
+static inline long _bench_env_cpus() {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (long) info.dwNumberOfProcessors;
+#else
+  return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/**
+ * Environment probe.
+ */
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+// Defined by the build to record the compiler flags, as there is no macro
+// holding them, e.g. -DBENCH_COMPILE_FLAGS="\"$(CFLAGS)\""
+#ifndef BENCH_COMPILE_FLAGS
+#define BENCH_COMPILE_FLAGS ""
+#endif
+
+#define _BENCH_STRINGIFY(value) #value
+#define _BENCH_VERSION_STRING(value) _BENCH_STRINGIFY(value)
+
+/**
+ * The machine and build a suite runs on, for telling changes in the code
+ * apart from changes in the setup. Settings which could not be read are
+ * empty, or -1.
+ *
+ * @property cpu_model The CPU model name
+ * @property cpus The number of online CPUs
+ * @property governor The CPU frequency scaling governor
+ * @property max_mhz The maximum CPU frequency in MHz
+ * @property boost Whether turbo boost is enabled
+ * @property smt Whether simultaneous multithreading is active
+ * @property aslr The level of address space layout randomization, where 0
+ *   is disabled
+ * @property load The load average over the last minute
+ * @property compiler The name and version of the compiler
+ * @property flags The compiler flags given as `BENCH_COMPILE_FLAGS`
+ * @property optimized Whether the suite was built with optimizations
+ * @property debug Whether assertions are enabled, without `NDEBUG`
+ */
+typedef struct bench_environment_s {
+  char cpu_model[128];
+  long cpus;
+  char governor[32];
+  long max_mhz;
+  int boost;
+  int smt;
+  int aslr;
+  double load;
+  const char* compiler;
+  const char* flags;
+  bool optimized;
+  bool debug;
+} bench_environment_t;
+
+/*!
+ * Read the first line of a file, without its line break.
+ *
+ * @private
+ * @param path The file to read.
+ * @param out Where to write the line.
+ * @param size The size of `out`.
+ * @return Whether the file could be read.
+ */
+static inline bool _bench_read_line(const char* path, char* out, size_t size) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) return false;
+  bool read = fgets(out, (int) size, file) != NULL;
+  fclose(file);
+  if (!read) return false;
+  out[strcspn(out, "\r\n")] = '\0';
+  return true;
+}
+
+/*!
+ * Read a file holding a single integer.
+ *
+ * @private
+ * @param path The file to read.
+ * @param fallback The value when the file could not be read.
+ */
+static inline long _bench_read_long(const char* path, long fallback) {
+  char line[32];
+  if (!_bench_read_line(path, line, sizeof(line))) return fallback;
+  char* end;
+  long value = strtol(line, &end, 10);
+  return end != line ? value : fallback;
+}
+
+/*!
+ * Find the CPU model name.
+ *
+ * @private
+ * @param out Where to write the name.
+ * @param size The size of `out`.
+ */
+static inline void _bench_env_cpu_model(char* out, size_t size) {
+  out[0] = '\0';
+#if defined(__linux__)
+  // x86 names the model, while ARM only has a part number in the cpuinfo
+  FILE* file = fopen("/proc/cpuinfo", "r");
+  if (file == NULL) return;
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strncmp(line, "model name", 10) != 0 && strncmp(line, "Model", 5) != 0) continue;
+    char* value = strchr(line, ':');
+    if (value == NULL) continue;
+    value += strspn(value + 1, " \t") + 1;
+    value[strcspn(value, "\r\n")] = '\0';
+    snprintf(out, size, "%s", value);
+    break;
+  }
+  fclose(file);
+#elif defined(__APPLE__)
+  size_t length = size;
+  if (sysctlbyname("machdep.cpu.brand_string", out, &length, NULL, 0) != 0) out[0] = '\0';
+#elif defined(_WIN32)
+  DWORD length = (DWORD) size;
+  HKEY key;
+  if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", 0, KEY_READ, &key) == ERROR_SUCCESS) {
+    if (RegQueryValueExA(key, "ProcessorNameString", NULL, NULL, (LPBYTE) out, &length) != ERROR_SUCCESS) out[0] = '\0';
+    RegCloseKey(key);
+  }
+#endif
+}
+
+/*!
+ * Read the load average over the last minute.
+ *
+ * @private
+ * @return The load average, or -1 if it is not available.
+ */
+static inline double _bench_env_load() {
+#if defined(__linux__)
+  char line[64];
+  if (_bench_read_line("/proc/loadavg", line, sizeof(line))) return atof(line);
+#elif defined(__APPLE__)
+  struct loadavg load;
+  size_t length = sizeof(load);
+  if (sysctlbyname("vm.loadavg", &load, &length, NULL, 0) == 0 && load.fscale > 0) {
+    return (double) load.ldavg[0] / load.fscale;
+  }
+#endif
+  return -1;
+}
+
+/*!
+ * The name and version of the compiler the suite was built with.
+ *
+ * @private
+ */
+static inline const char* _bench_env_compiler() {
+#if defined(__clang__)
+  return "clang " __clang_version__;
+#elif defined(__GNUC__)
+  return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  return "msvc " _BENCH_VERSION_STRING(_MSC_FULL_VER);
+#else
+  return "unknown";
+#endif
+}
+
+/**
+ * Probe the machine and build the suite runs on.
+ *
+ * @param env Where to write the environment.
+ */
+static inline void bench_environment_probe(bench_environment_t* env) {
+  _bench_env_cpu_model(env->cpu_model, sizeof(env->cpu_model));
+  env->cpus = _bench_env_cpus();
+  env->governor[0] = '\0';
+  env->max_mhz = -1;
+  env->boost = -1;
+  env->smt = -1;
+  env->aslr = -1;
+  env->load = _bench_env_load();
+  env->compiler = _bench_env_compiler();
+  env->flags = BENCH_COMPILE_FLAGS;
+
+#ifdef __linux__
+  if (!_bench_read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", env->governor, sizeof(env->governor))) {
+    env->governor[0] = '\0';
+  }
+  long khz = _bench_read_long("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", -1);
+  env->max_mhz = khz > 0 ? khz / 1000 : -1;
+
+  // intel_pstate inverts the setting of the other drivers
+  long no_turbo = _bench_read_long("/sys/devices/system/cpu/intel_pstate/no_turbo", -1);
+  long boost = _bench_read_long("/sys/devices/system/cpu/cpufreq/boost", -1);
+  env->boost = no_turbo >= 0 ? no_turbo == 0 : boost >= 0 ? boost != 0 : -1;
+
+  env->smt = (int) _bench_read_long("/sys/devices/system/cpu/smt/active", -1);
+  env->aslr = (int) _bench_read_long("/proc/sys/kernel/randomize_va_space", -1);
+#endif
+
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+  env->optimized = true;
+#else
+  env->optimized = false;
+#endif
+#ifdef NDEBUG
+  env->debug = false;
+#else
+  env->debug = true;
+#endif
+}
+
+/*!
+ * Print a setting which may be unknown.
+ *
+ * @private
+ */
+static inline void _bench_env_print_flag(FILE* out, const char* name, int value) {
+  fprintf(out, ", %s %s", name, value < 0 ? "unknown" : value > 0 ? "on" : "off");
+}
+
+/**
+ * Probe the environment the suite runs in and print it, with a warning for
+ * each setting known to add noise to measurements: CPU frequency scaling,
+ * turbo boost, a build without optimizations, and other busy processes. The
+ * environment is also written by the JSON reporter.
+ *
+ * Compiler flags can not be found from within the build, so are only known
+ * when defined as `BENCH_COMPILE_FLAGS`.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_environment(b);
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ * cpu: AMD EPYC 7763 64-Core Processor (16 cpus, max 3529MHz), governor
+ *   schedutil, boost on, smt on, aslr 2, load 0.42
+ * build: gcc 12.2.0, optimized, assertions on, flags -O2
+ * warning: CPU frequency scaling is enabled (governor schedutil)
+ * warning: turbo boost is enabled
+ * ```
+ *
+ * @param b The top-level bench namespace
+ * @return The environment, or NULL if it could not be allocated.
+ */
+static inline bench_environment_t* bench_environment(bench_t* b) {
+  while (b->parent != NULL) b = b->parent;
+  if (b->environment == NULL) {
+    b->environment = (bench_environment_t*) _bench_alloc(b, sizeof(bench_environment_t));
+    if (b->environment == NULL) return NULL;
+  }
+  bench_environment_t* env = b->environment;
+  bench_environment_probe(env);
+
+  _bench_print_header(b);
+  FILE* out = b->out;
+  _bench_print_indent(b);
+  fprintf(out, "cpu: %s (%ld cpus", env->cpu_model[0] ? env->cpu_model : "unknown", env->cpus);
+  if (env->max_mhz > 0) fprintf(out, ", max %ldMHz", env->max_mhz);
+  fprintf(out, "), governor %s", env->governor[0] ? env->governor : "unknown");
+  _bench_env_print_flag(out, "boost", env->boost);
+  _bench_env_print_flag(out, "smt", env->smt);
+  if (env->aslr >= 0) {
+    fprintf(out, ", aslr %d", env->aslr);
+  }
+  if (env->load >= 0) {
+    fprintf(out, ", load %.2f", env->load);
+  }
+  fprintf(out, "\n");
+
+  _bench_print_indent(b);
+  fprintf(out, "build: %s, %s, assertions %s", env->compiler,
+    env->optimized ? "optimized" : "unoptimized", env->debug ? "on" : "off");
+  if (env->flags[0]) fprintf(out, ", flags %s", env->flags);
+  fprintf(out, "\n");
+
+  if (env->governor[0] && strcmp(env->governor, "performance") != 0) {
+    _bench_print_indent(b);
+    fprintf(out, "warning: CPU frequency scaling is enabled (governor %s)\n", env->governor);
+  }
+  if (env->boost > 0) {
+    _bench_print_indent(b);
+    fprintf(out, "warning: turbo boost is enabled\n");
+  }
+  if (!env->optimized) {
+    _bench_print_indent(b);
+    fprintf(out, "warning: built without optimizations\n");
+  }
+  if (env->load > 1) {
+    _bench_print_indent(b);
+    fprintf(out, "warning: other processes are busy (load %.2f)\n", env->load);
+  }
+  return env;
+}
+
+/*!
+ * Write a string as a JSON string literal.
+ *
+ * @private
+ * @param out The file to write to.
+ * @param value The string to write.
+ */
+static inline void _bench_json_string(FILE* out, const char* value) {
+  fputc('"', out);
+  for (const char* c = value; *c; c++) {
+    switch (*c) {
+      case '"': fputs("\\\"", out); break;
+      case '\\': fputs("\\\\", out); break;
+      case '\n': fputs("\\n", out); break;
+      case '\r': fputs("\\r", out); break;
+      case '\t': fputs("\\t", out); break;
+      default:
+        if ((unsigned char) *c < 0x20) {
+          fprintf(out, "\\u%04x", (unsigned char) *c);
+        } else {
+          fputc(*c, out);
+        }
+    }
+  }
+  fputc('"', out);
+}
+
+/*!
+ * Write a number as JSON, which has no representation for infinity or NaN.
+ *
+ * @private
+ * @param out The file to write to.
+ * @param value The number to write.
+ */
+static inline void _bench_json_number(FILE* out, double value) {
+  if (isfinite(value)) {
+    fprintf(out, "%.6g", value);
+  } else {
+    fputs("null", out);
+  }
+}
+
+/*!
+ * Write a measurement as an entry of the JSON reporter's benchmarks array.
+ *
+ * @private
+ */
+static inline void _bench_json_measurement(
+  bench_reporter_t* r,
+  bench_t* b,
+  const char* group,
+  bench_measurement_t* m
+) {
+  FILE* out = r->out;
+  double ops = bench_measurement_ops_per_sec(m);
+
+  fprintf(out, "%s\n    {\n      \"group\": ", r->count > 0 ? "," : "");
+  _bench_json_string(out, group);
+  fprintf(out, ",\n      \"name\": ");
+  _bench_json_string(out, m->name);
+  fprintf(out, ",\n      \"iterations\": %llu", (unsigned long long) m->stats.count);
+  fprintf(out, ",\n      \"samples\": %llu", (unsigned long long) m->stats.samples);
+  fprintf(out, ",\n      \"total_ns\": %llu", (unsigned long long) m->stats.total);
+  fprintf(out, ",\n      \"mean_ns\": ");
+  _bench_json_number(out, m->stats.mean);
+  fprintf(out, ",\n      \"stddev_ns\": ");
+  _bench_json_number(out, bench_stats_stddev(&m->stats));
+  fprintf(out, ",\n      \"rme\": ");
+  _bench_json_number(out, bench_stats_rme(&m->stats));
+  fprintf(out, ",\n      \"ops_per_sec\": ");
+  _bench_json_number(out, ops);
+  fprintf(out, ",\n      \"threads\": %u", m->threads);
+  if (m->in_flight > 0) {
+    fprintf(out, ",\n      \"in_flight\": %u", m->in_flight);
+  }
+  if (m->rate > 0) {
+    fprintf(out, ",\n      \"target_rate\": ");
+    _bench_json_number(out, m->rate);
+  }
+  if (m->has_arg) {
+    fprintf(out, ",\n      \"arg\": %llu", (unsigned long long) m->arg);
+  }
+  if (m->bytes > 0) {
+    fprintf(out, ",\n      \"bytes_per_sec\": ");
+    _bench_json_number(out, m->bytes * ops);
+  }
+  if (m->items > 0) {
+    fprintf(out, ",\n      \"items_per_sec\": ");
+    _bench_json_number(out, m->items * ops);
+  }
+  if (m->repetitions.samples > 1) {
+    fprintf(out, ",\n      \"repetitions\": %llu", (unsigned long long) m->repetitions.samples);
+    fprintf(out, ",\n      \"repetition_stddev_ns\": ");
+    _bench_json_number(out, bench_stats_stddev(&m->repetitions) / BENCH_HISTOGRAM_SCALE);
+  }
+  if (m->allocs.tracked) {
+    uint64_t iterations = m->stats.count > 0 ? m->stats.count : 1;
+    fprintf(out, ",\n      \"allocs_per_iter\": ");
+    _bench_json_number(out, (double) m->allocs.count / iterations);
+    fprintf(out, ",\n      \"alloc_bytes_per_iter\": ");
+    _bench_json_number(out, (double) m->allocs.bytes / iterations);
+    fprintf(out, ",\n      \"peak_bytes\": %lld", (long long) m->allocs.peak);
+  }
+  if (b->percentiles || m->rate > 0) {
+    static const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+    static const char* names[] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns" };
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+      uint64_t value = bench_histogram_percentile(&m->histogram, percentiles[i]);
+      fprintf(out, ",\n      \"%s\": ", names[i]);
+      _bench_json_number(out, (double) value / BENCH_HISTOGRAM_SCALE);
+    }
+  }
+  fprintf(out, "\n    }");
+}
+
+/*!
+ * Close the JSON reporter's benchmarks array and document, after adding the
+ * results of `bench_reference`, `bench_subtract_overhead` and
+ * `bench_environment` when they were run.
+ *
+ * @private
+ */
+static inline void _bench_json_finish(bench_reporter_t* r, bench_t* b) {
+  fprintf(r->out, "%s  ]", r->count > 0 ? "\n" : "");
+
+  // Reference results describe the machine, to normalize results across them
+  bool reference = false;
+  for (int i = 0; i < BENCH_REFERENCE_COUNT; i++) {
+    if (b->reference[i] <= 0) continue;
+    fprintf(r->out, "%s\n    \"%s\": ", reference ? "," : ",\n  \"reference\": {", _bench_reference_key((bench_reference_t) i));
+    _bench_json_number(r->out, b->reference[i]);
+    reference = true;
+  }
+  if (reference) fprintf(r->out, "\n  }");
+
+  bench_overhead_t* overhead = &_bench_overheads[b->clock == BENCH_CLOCK_CYCLES];
+  if (b->subtract_overhead && overhead->timer >= 0) {
+    fprintf(r->out, ",\n  \"overhead\": {\n    \"timer_ns\": ");
+    _bench_json_number(r->out, overhead->timer);
+    fprintf(r->out, ",\n    \"call_ns\": ");
+    _bench_json_number(r->out, overhead->call);
+    if (overhead->function >= 0) {
+      fprintf(r->out, ",\n    \"function_ns\": ");
+      _bench_json_number(r->out, overhead->function);
+    }
+    fprintf(r->out, "\n  }");
+  }
+
+  bench_environment_t* env = b->environment;
+  if (env != NULL) {
+    fprintf(r->out, ",\n  \"environment\": {\n    \"cpu_model\": ");
+    _bench_json_string(r->out, env->cpu_model);
+    fprintf(r->out, ",\n    \"cpus\": %ld", env->cpus);
+    fprintf(r->out, ",\n    \"governor\": ");
+    _bench_json_string(r->out, env->governor);
+    fprintf(r->out, ",\n    \"max_mhz\": %ld", env->max_mhz);
+    fprintf(r->out, ",\n    \"boost\": %d", env->boost);
+    fprintf(r->out, ",\n    \"smt\": %d", env->smt);
+    fprintf(r->out, ",\n    \"aslr\": %d", env->aslr);
+    fprintf(r->out, ",\n    \"load\": ");
+    _bench_json_number(r->out, env->load);
+    fprintf(r->out, ",\n    \"compiler\": ");
+    _bench_json_string(r->out, env->compiler);
+    fprintf(r->out, ",\n    \"flags\": ");
+    _bench_json_string(r->out, env->flags);
+    fprintf(r->out, ",\n    \"optimized\": %s", env->optimized ? "true" : "false");
+    fprintf(r->out, ",\n    \"debug\": %s\n  }", env->debug ? "true" : "false");
+  }
+
+  fprintf(r->out, "\n}\n");
+}
+
+/**
+ * Create a reporter writing results to the given file as a JSON document,
+ * with the environment the suite ran in and an entry per measurement.
+ *
+ * ```json
+ * {
+ *   "context": {
+ *     "version": "1.0.0",
+ *     "date": "2024-01-01T00:00:00Z",
+ *     "os": "linux",
+ *     "arch": "x86_64",
+ *     "cpus": 8
+ *   },
+ *   "benchmarks": [
+ *     {
+ *       "group": "bench",
+ *       "name": "fast",
+ *       "iterations": 26920000,
+ *       ...
+ *     }
+ *   ],
+ *   "reference": {
+ *     "l1_latency_ns": 1.2,
+ *     ...
+ *   }
+ * }
+ * ```
+ *
+ * The `reference` object holds the results of `bench_reference`, the
+ * `overhead` object those of `bench_subtract_overhead`, and the
+ * `environment` object those of `bench_environment`. Each is only written
+ * when it was run.
+ *
+ * @param out The file to write to.
+ * @return The reporter to add with `bench_add_reporter`, or NULL.
+ */
+static inline bench_reporter_t* bench_json_reporter(FILE* out) {
+  bench_reporter_t* r = _bench_reporter_create(out, _bench_json_measurement, _bench_json_finish);
+  if (r == NULL) return NULL;
+
+  char date[32];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  fprintf(out, "{\n  \"context\": {\n");
+  fprintf(out, "    \"version\": \"%s\",\n", BENCH_VERSION);
+  fprintf(out, "    \"date\": \"%s\",\n", date);
+  fprintf(out, "    \"os\": \"%s\",\n", _bench_env_os());
+  fprintf(out, "    \"arch\": \"%s\",\n", _bench_env_arch());
+  fprintf(out, "    \"cpus\": %ld\n", _bench_env_cpus());
+  fprintf(out, "  },\n  \"benchmarks\": [");
+  return r;
+}
+
+/*!
+ * Write a string as a CSV field, quoted when it needs to be.
+ *
+ * @private
+ * @param out The file to write to.
+ * @param value The string to write.
+ */
+static inline void _bench_csv_string(FILE* out, const char* value) {
+  if (strpbrk(value, ",\"\r\n") == NULL) {
+    fputs(value, out);
+    return;
+  }
+  fputc('"', out);
+  for (const char* c = value; *c; c++) {
+    if (*c == '"') fputc('"', out);
+    fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+/*!
+ * Write a measurement as a row of the CSV reporter.
+ *
+ * @private
+ */
+static inline void _bench_csv_measurement(
+  bench_reporter_t* r,
+  bench_t* b,
+  const char* group,
+  bench_measurement_t* m
+) {
+  FILE* out = r->out;
+  double ops = bench_measurement_ops_per_sec(m);
+
+  _bench_csv_string(out, group);
+  fputc(',', out);
+  _bench_csv_string(out, m->name);
+  fprintf(out, ",%llu,%llu,%llu,%.6g,%.6g,%.6g,%.6g,%u,",
+    (unsigned long long) m->stats.count,
+    (unsigned long long) m->stats.samples,
+    (unsigned long long) m->stats.total,
+    m->stats.mean,
+    bench_stats_stddev(&m->stats),
+    bench_stats_rme(&m->stats),
+    ops,
+    m->threads);
+  if (m->has_arg) fprintf(out, "%llu", (unsigned long long) m->arg);
+  fputc(',', out);
+  if (m->bytes > 0) fprintf(out, "%.6g", m->bytes * ops);
+  fputc(',', out);
+  if (m->items > 0) fprintf(out, "%.6g", m->items * ops);
+
+  static const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    fputc(',', out);
+    if (b->percentiles) {
+      uint64_t value = bench_histogram_percentile(&m->histogram, percentiles[i]);
+      fprintf(out, "%.6g", (double) value / BENCH_HISTOGRAM_SCALE);
+    }
+  }
+  fputc('\n', out);
+}
+
+/**
+ * Create a reporter writing results to the given file as CSV, with a header
+ * row and a row per measurement. Columns which do not apply to a measurement,
+ * such as percentiles when they are not enabled, are left empty.
+ *
+ * ```
+ * group,name,iterations,samples,total_ns,mean_ns,stddev_ns,rme,ops_per_sec,threads,arg,bytes_per_sec,items_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns
+ * bench,fast,26920000,26920000,1000000000,34.11,17.01,0.02,2.692e+07,1,,,,,,,,
+ * ```
+ *
+ * @param out The file to write to.
+ * @return The reporter to add with `bench_add_reporter`, or NULL.
+ */
+static inline bench_reporter_t* bench_csv_reporter(FILE* out) {
+  bench_reporter_t* r = _bench_reporter_create(out, _bench_csv_measurement, NULL);
+  if (r == NULL) return NULL;
+
+  fprintf(out,
+    "group,name,iterations,samples,total_ns,mean_ns,stddev_ns,rme,ops_per_sec,threads,"
+    "arg,bytes_per_sec,items_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+  return r;
+}
+
+/**
+ * Baseline comparison.
+ */
+
+/*!
+ * A measurement loaded from a previous JSON result. The group path and name
+ * are stored after the struct.
+ *
+ * @private
+ */
+typedef struct bench_baseline_s {
+  const char* group;
+  const char* name;
+  uint64_t samples;
+  double mean;
+  double stddev;
+} bench_baseline_t;
+
+/*!
+ * Skip whitespace in a JSON document.
+ *
+ * @private
+ */
+static inline void _bench_json_skip_ws(const char** p) {
+  while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r') (*p)++;
+}
+
+/*!
+ * Parse a JSON string literal, truncating it to fit the buffer. Escaped
+ * characters outside of ASCII are replaced with `?`.
+ *
+ * @private
+ * @param p The parse position, just before the opening quote.
+ * @param out The buffer to write the string to.
+ * @param size The size of the buffer.
+ * @return Whether a string was parsed.
+ */
+static inline bool _bench_json_parse_string(const char** p, char* out, size_t size) {
+  _bench_json_skip_ws(p);
+  if (**p != '"') return false;
+  (*p)++;
+
+  size_t length = 0;
+  while (**p && **p != '"') {
+    char c = *(*p)++;
+    if (c == '\\') {
+      c = *(*p)++;
+      switch (c) {
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u': {
+          unsigned int code = 0;
+          for (int i = 0; i < 4 && isxdigit((unsigned char) **p); i++) {
+            char h = *(*p)++;
+            code = code * 16 + (isdigit((unsigned char) h) ? h - '0' : (tolower(h) - 'a' + 10));
+          }
+          c = code < 0x80 ? (char) code : '?';
+          break;
+        }
+        case '\0': return false;
+        default: break;
+      }
+    }
+    if (length + 1 < size) out[length++] = c;
+  }
+  if (size > 0) out[length] = '\0';
+  if (**p != '"') return false;
+  (*p)++;
+  return true;
+}
+
+/*!
+ * Skip a JSON value of any type.
+ *
+ * @private
+ * @param p The parse position, just before the value.
+ * @return Whether a value was skipped.
+ */
+static inline bool _bench_json_skip_value(const char** p) {
+  _bench_json_skip_ws(p);
+  if (**p == '"') {
+    char ignored[1];
+    return _bench_json_parse_string(p, ignored, sizeof(ignored));
+  }
+  if (**p == '{' || **p == '[') {
+    int depth = 0;
+    while (**p) {
+      if (**p == '"') {
+        char ignored[1];
+        if (!_bench_json_parse_string(p, ignored, sizeof(ignored))) return false;
+        continue;
+      }
+      if (**p == '{' || **p == '[') depth++;
+      if (**p == '}' || **p == ']') depth--;
+      (*p)++;
+      if (depth == 0) return true;
+    }
+    return false;
+  }
+  const char* start = *p;
+  while (**p && **p != ',' && **p != '}' && **p != ']' && !isspace((unsigned char) **p)) (*p)++;
+  return *p != start;
+}
+
+/*!
+ * Parse one entry of the benchmarks array of a JSON result.
+ *
+ * @private
+ * @param b The bench namespace whose arena the entry is allocated from.
+ * @param p The parse position, just before the entry.
+ * @return The baseline entry, or NULL if it could not be parsed.
+ */
+static inline bench_baseline_t* _bench_json_parse_baseline(bench_t* b, const char** p) {
+  char group[512] = "";
+  char name[256] = "";
+  char key[32];
+  uint64_t samples = 0;
+  double mean = 0;
+  double stddev = 0;
+
+  _bench_json_skip_ws(p);
+  if (**p != '{') return NULL;
+  (*p)++;
+
+  for (;;) {
+    _bench_json_skip_ws(p);
+    if (**p == '}') {
+      (*p)++;
+      break;
+    }
+    if (!_bench_json_parse_string(p, key, sizeof(key))) return NULL;
+    _bench_json_skip_ws(p);
+    if (**p != ':') return NULL;
+    (*p)++;
+    _bench_json_skip_ws(p);
+
+    if (strcmp(key, "group") == 0) {
+      if (!_bench_json_parse_string(p, group, sizeof(group))) return NULL;
+    } else if (strcmp(key, "name") == 0) {
+      if (!_bench_json_parse_string(p, name, sizeof(name))) return NULL;
+    } else if (strcmp(key, "samples") == 0) {
+      samples = strtoull(*p, NULL, 10);
+      if (!_bench_json_skip_value(p)) return NULL;
+    } else if (strcmp(key, "mean_ns") == 0) {
+      mean = strtod(*p, NULL);
+      if (!_bench_json_skip_value(p)) return NULL;
+    } else if (strcmp(key, "stddev_ns") == 0) {
+      stddev = strtod(*p, NULL);
+      if (!_bench_json_skip_value(p)) return NULL;
+    } else if (!_bench_json_skip_value(p)) {
+      return NULL;
+    }
+
+    _bench_json_skip_ws(p);
+    if (**p == ',') (*p)++;
+  }
+
+  size_t group_size = strlen(group) + 1;
+  size_t name_size = strlen(name) + 1;
+  bench_baseline_t* entry = (bench_baseline_t*) _bench_alloc(b, sizeof(bench_baseline_t) + group_size + name_size);
+  if (entry == NULL) return NULL;
+  char* strings = (char*) (entry + 1);
+  memcpy(strings, group, group_size);
+  memcpy(strings + group_size, name, name_size);
+  entry->group = strings;
+  entry->name = strings + group_size;
+  entry->samples = samples;
+  entry->mean = mean;
+  entry->stddev = stddev;
+  return entry;
+}
+
+/**
+ * Load a result written by `bench_json_reporter` as the baseline to compare
+ * measurements against. Measurements are matched to the baseline by group
+ * path and name, and `bench_compare` prints the change in the mean of each,
+ * with whether Welch's t-test finds it significant at 95% confidence.
+ *
+ * A significant slowdown beyond `b->regression_threshold` percent counts as
+ * a regression, and `bench_compare` returns the number of them, so a suite
+ * can fail when it regresses:
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_load_baseline(b, "main.json");
+ * bench_measure(b, "fast", bench_fast);
+ * return bench_compare(b) > 0;
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ * fast - 24.11m i/s (±0.21%) (41.48ns/i)
+ * Baseline...
+ *   - fast (11.66% slower, significant, regression)
+ * ```
+ *
+ * @param b bench namespace
+ * @param path The JSON file to load.
+ * @return Whether the file could be loaded.
+ */
+static inline bool bench_load_baseline(bench_t* b, const char* path) {
+  while (b->parent != NULL) b = b->parent;
+
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) return false;
+
+  size_t size = 0;
+  size_t capacity = 4096;
+  char* json = (char*) malloc(capacity);
+  while (json != NULL) {
+    size += fread(json + size, 1, capacity - size - 1, file);
+    if (size < capacity - 1) break;
+    capacity *= 2;
+    char* grown = (char*) realloc(json, capacity);
+    if (grown == NULL) free(json);
+    json = grown;
+  }
+  fclose(file);
+  if (json == NULL) return false;
+  json[size] = '\0';
+
+  bool loaded = false;
+  const char* p = strstr(json, "\"benchmarks\"");
+  if (p != NULL && (p = strchr(p, '[')) != NULL) {
+    p++;
+    for (;;) {
+      _bench_json_skip_ws(&p);
+      if (*p == ']') {
+        loaded = true;
+        break;
+      }
+      bench_baseline_t* entry = _bench_json_parse_baseline(b, &p);
+      if (entry == NULL || !bench_array_push(&b->baseline, entry)) break;
+      _bench_json_skip_ws(&p);
+      if (*p == ',') p++;
+    }
+  }
+
+  free(json);
+  return loaded;
+}
+
+/*!
+ * Print the change of each measurement of a group against the baseline,
+ * counting regressions on the top-level suite.
+ *
+ * @private
+ * @param b bench namespace
+ */
+static inline void _bench_baseline_print(bench_t* b) {
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  if (root->baseline.size == 0) return;
+
+  char group[512];
+  _bench_group_path(b, group, sizeof(group));
+
+  bool printed = false;
+  for (size_t i = 0; i < b->measurements.size; i++) {
+    bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[i];
+
+    bench_baseline_t* base = NULL;
+    for (size_t j = 0; j < root->baseline.size && base == NULL; j++) {
+      bench_baseline_t* entry = (bench_baseline_t*) root->baseline.entries[j];
+      if (strcmp(entry->group, group) == 0 && strcmp(entry->name, m->name) == 0) {
+        base = entry;
+      }
+    }
+    if (base == NULL || base->mean <= 0) continue;
+
+    // Welch's t-test, with Welch-Satterthwaite degrees of freedom
+    double n1 = (double) m->stats.samples;
+    double n2 = (double) base->samples;
+    bool significant = false;
+    if (n1 >= 2 && n2 >= 2) {
+      double stddev = bench_stats_stddev(&m->stats);
+      double v1 = stddev * stddev / n1;
+      double v2 = base->stddev * base->stddev / n2;
+      double se = sqrt(v1 + v2);
+      if (se > 0) {
+        double t = fabs(m->stats.mean - base->mean) / se;
+        double df = (v1 + v2) * (v1 + v2) / (v1 * v1 / (n1 - 1) + v2 * v2 / (n2 - 1));
+        significant = t > _bench_t_critical(df >= 1 ? (uint64_t) df : 1);
+      } else {
+        significant = m->stats.mean != base->mean;
+      }
+    }
+
+    double delta = (m->stats.mean / base->mean) * 100 - 100;
+    bool regression = significant && delta > b->regression_threshold;
+    if (regression) {
+      _bench_lock(root);
+      root->regressions++;
+      _bench_unlock(root);
+    }
+
+    if (!printed) {
+      _bench_print_indent(b);
+      fprintf(b->out, "Baseline...\n");
+      printed = true;
+    }
+    _bench_print_indent(b);
+    fprintf(b->out, "  - %s (%.2f%% %s, %s%s)\n",
+      m->name,
+      fabs(delta),
+      delta > 0 ? "slower" : "faster",
+      significant ? "significant" : "not significant",
+      regression ? ", regression" : "");
+  }
+}
+
+/**
+ * Complexity classes which range measurements are fitted to.
+ */
+typedef enum bench_complexity_e {
+  BENCH_COMPLEXITY_O1,
+  BENCH_COMPLEXITY_OLOGN,
+  BENCH_COMPLEXITY_ON,
+  BENCH_COMPLEXITY_ONLOGN,
+  BENCH_COMPLEXITY_COUNT
+} bench_complexity_t;
+
+/*!
+ * Evaluate the function of a complexity class.
+ *
+ * @private
+ * @param complexity The complexity class.
+ * @param n The argument.
+ * @return The value of the class function at `n`.
+ */
+static inline double _bench_complexity_fn(bench_complexity_t complexity, double n) {
+  switch (complexity) {
+    case BENCH_COMPLEXITY_OLOGN: return n > 1 ? log2(n) : 0;
+    case BENCH_COMPLEXITY_ON: return n;
+    case BENCH_COMPLEXITY_ONLOGN: return n > 1 ? n * log2(n) : 0;
+    default: return 1;
+  }
+}
+
+/*!
+ * Fit the range measurements of a group to each complexity class by least
+ * squares, and print the class with the lowest normalized RMS error.
+ *
+ * @private
+ * @param b bench namespace
+ */
+static inline void _bench_complexity_print(bench_t* b) {
+  static const char* terms[BENCH_COMPLEXITY_COUNT] = {
+    "1", "log n", "n", "n log n"
+  };
+
+  bench_array_t* m = &b->measurements;
+  size_t points = 0;
+  double mean = 0;
+  for (size_t i = 0; i < m->size; i++) {
+    bench_measurement_t* measurement = (bench_measurement_t*) m->entries[i];
+    if (!measurement->has_arg) continue;
+    mean += measurement->stats.mean;
+    points++;
+  }
+  if (points < 2 || mean <= 0) return;
+  mean /= points;
+
+  int best = -1;
+  double best_coefficient = 0;
+  double best_rms = 0;
+  for (int c = 0; c < BENCH_COMPLEXITY_COUNT; c++) {
+    // Least squares of time = coefficient * f(n) has a closed form
+    double ft = 0;
+    double ff = 0;
+    for (size_t i = 0; i < m->size; i++) {
+      bench_measurement_t* measurement = (bench_measurement_t*) m->entries[i];
+      if (!measurement->has_arg) continue;
+      double f = _bench_complexity_fn((bench_complexity_t) c, (double) measurement->arg);
+      ft += f * measurement->stats.mean;
+      ff += f * f;
+    }
+    if (ff == 0) continue;
+    double coefficient = ft / ff;
+
+    double error = 0;
+    for (size_t i = 0; i < m->size; i++) {
+      bench_measurement_t* measurement = (bench_measurement_t*) m->entries[i];
+      if (!measurement->has_arg) continue;
+      double f = _bench_complexity_fn((bench_complexity_t) c, (double) measurement->arg);
+      double delta = measurement->stats.mean - coefficient * f;
+      error += delta * delta;
+    }
+    double rms = sqrt(error / points) / mean;
+    if (best < 0 || rms < best_rms) {
+      best = c;
+      best_coefficient = coefficient;
+      best_rms = rms;
+    }
+  }
+  if (best < 0) return;
+
+  _bench_print_indent(b);
+  fprintf(b->out, "Complexity: O(%s) (", terms[best]);
+  if (best_coefficient >= 1) {
+    bench_human_number(b->out, best_coefficient, true);
+  } else {
+    // Per-unit coefficients are often well below a nanosecond
+    fprintf(b->out, "%.4fns", best_coefficient);
+  }
+  if (best != BENCH_COMPLEXITY_O1) {
+    fprintf(b->out, " * %s", terms[best]);
+  }
+  fprintf(b->out, ", rms %.2f%%)\n", best_rms * 100);
+}
+
+// Defined with the sampling core, which needs the clocks
+static inline void _bench_run_rounds(bench_t* b);
+
+// Defined after the parallel measurements, which share the threads
+static inline void _bench_run_groups(bench_t* b);
+
+/**
+ * Compare results of the benchmark.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_measure(b, "fast", bench_fast);
+ * bench_measure(b, "slow", bench_slow);
+ * bench_compare(b);
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ * fast - 26.92m i/s (±49.87%) (34.11ns/i)
+ * slow - 3.53m i/s (±165.47%) (278.89ns/i)
+ * ```
+ *
+ * When a baseline is loaded with `bench_load_baseline`, each measurement is
+ * also compared against it. Groups waiting for the workers of a suite with
+ * `jobs` set are run first.
+ *
+ * @param b bench namespace
+ * @return For the top-level suite, the number of measurements which
+ *   regressed against the baseline.
+ */
+static inline int bench_compare(bench_t* b) {
+  _bench_run_rounds(b);
+  if (b->parent == NULL) {
+    _bench_run_groups(b);
+  }
+
+  bench_array_t* m = &b->measurements;
+
+  // Only show comparison if there's more than one measurement.
+  if (m->size > 1) {
+    // Sort the order of the measurements by the number of operations per second
+    qsort(m->entries, m->size, sizeof(void**), _bench_compare_measurement);
+
+    _bench_print_indent(b);
+    fprintf(b->out, "Comparing...\n");
+
+    double fastest = 0;
+
+    for (size_t i = 0; i < m->size; i++) {
+      bench_measurement_t* measurement = (bench_measurement_t*) m->entries[i];
+      double ops = bench_measurement_ops_per_sec(measurement);
+      _bench_print_indent(b);
+      if (i == 0) {
+        fprintf(b->out, "  - %s (fastest", measurement->name);
+        fastest = ops;
+      } else {
+        fprintf(b->out, "  - %s", measurement->name);
+        fprintf(b->out, " (%.2f%% slower", (fastest / ops) * 100 - 100);
+      }
+      if (b->percentiles) {
+        fprintf(b->out, ", ");
+        bench_histogram_print(&measurement->histogram, b->out);
+      }
+      fprintf(b->out, ")\n");
+    }
+
+    if (b->complexity) {
+      _bench_complexity_print(b);
+    }
+  }
+
+  _bench_baseline_print(b);
+
+  int regressions = (int) b->regressions;
+  if (b->parent == NULL) {
+    _bench_report_finish(b);
+  }
+  bench_free(b);
+  return regressions;
+}
+
+/**
+ * Sub-group function signature
+ *
+ * @param b bench namespace
+ */
+typedef void (*bench_group_fn)(bench_t* b);
+
+/*!
+ * Copy the measurement options of a parent bench namespace to a sub-group.
+ *
+ * @private
+ * @param b The sub-group to configure.
+ * @param parent The bench namespace the sub-group belongs to.
+ */
+static inline void _bench_inherit(bench_t* b, bench_t* parent) {
+  b->target_time = parent->target_time;
+  b->batch_time = parent->batch_time;
+  b->clock = parent->clock;
+  b->show_cycles = parent->show_cycles;
+  b->subtract_overhead = parent->subtract_overhead;
+  b->warmup_time = parent->warmup_time;
+  b->warmup_iterations = parent->warmup_iterations;
+  b->steady_state = parent->steady_state;
+  b->target_rme = parent->target_rme;
+  b->min_time = parent->min_time;
+  b->max_time = parent->max_time;
+  b->percentiles = parent->percentiles;
+  b->cpu = parent->cpu;
+  b->placement = parent->placement;
+  b->cpu_list = parent->cpu_list;
+  b->cpu_list_size = parent->cpu_list_size;
+  b->counters = parent->counters;
+  b->allocations = parent->allocations;
+  b->bytes = parent->bytes;
+  b->items = parent->items;
+  b->complexity = parent->complexity;
+  b->order = parent->order;
+  b->round_time = parent->round_time;
+  b->repetitions = parent->repetitions;
+  b->arrival = parent->arrival;
+  b->isolation = parent->isolation;
+  b->regression_threshold = parent->regression_threshold;
+}
+
+/*!
+ * A top-level group waiting for the workers of its suite.
+ *
+ * @private
+ * @property name Group name, stored after the struct
+ * @property fn Group function
+ * @property ptr Pointer attached to the bench_t given to the group function
+ * @property ptr_free Frees `ptr` once the group has run, or NULL.
+ * @property exclusive Whether the group runs alone, after the others
+ * @property out The file the output of the group is buffered in
+ * @property done Whether the group has finished
+ */
+typedef struct bench_pending_group_s {
+  const char* name;
+  bench_group_fn fn;
+  void* ptr;
+  void (*ptr_free)(void* ptr);
+  bool exclusive;
+  FILE* out;
+  bool done;
+} bench_pending_group_t;
+
+/*!
+ * Create the bench namespace of a sub-group.
+ *
+ * @private
+ * @param b The bench namespace the sub-group belongs to.
+ * @param name Group name
+ * @param ptr Pointer to attach to the sub-group
+ * @param out The file the sub-group prints to.
+ * @return The sub-group, or NULL if it could not be allocated.
+ */
+static inline bench_t* _bench_group_create(bench_t* b, const char* name, void* ptr, FILE* out) {
+  // With a filter, a group's header waits for a measurement which matches it
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  bool lazy = root->filter != NULL || root->list;
+
+  bench_t* b2 = _bench_create(b, name, out, b->indent + 2, ptr, !lazy);
+  if (b2 == NULL) return NULL;
+  _bench_inherit(b2, b);
+  return b2;
+}
+
+// Defined with process isolation, which needs the sampling core
+static inline bool _bench_group_isolated(bench_t* b, const char* name, bench_group_fn fn, void* ptr);
+
+/*!
+ * Run a sub-group in place.
+ *
+ * @private
+ * @param b The bench namespace the sub-group belongs to.
+ * @param name Group name
+ * @param fn Group function
+ * @param ptr Pointer to attach to the sub-group
+ * @param ptr_free Frees `ptr` once the group has run, or NULL.
+ */
+static inline void _bench_group_run(
+  bench_t* b,
+  const char* name,
+  bench_group_fn fn,
+  void* ptr,
+  void (*ptr_free)(void* ptr)
+) {
+  // An isolated group only runs in the child, but its pointer is owned here
+  if (b->isolation != BENCH_ISOLATION_GROUP || !_bench_group_isolated(b, name, fn, ptr)) {
+    bench_t* b2 = _bench_group_create(b, name, ptr, b->out);
+    if (b2 != NULL) {
+      fn(b2);
+      bench_compare(b2);
+    }
+  }
+  if (ptr_free != NULL) ptr_free(ptr);
+}
+
+/*!
+ * Run a sub-group, or queue it for the workers when it belongs to a suite
+ * with `jobs` set.
+ *
+ * @private
+ * @param b The bench namespace the sub-group belongs to.
+ * @param name Group name
+ * @param fn Group function
+ * @param ptr Pointer to attach to the sub-group
+ * @param ptr_free Frees `ptr` once the group has run, or NULL.
+ * @param exclusive Whether the group must run alone.
+ */
+static inline void _bench_group_add(
+  bench_t* b,
+  const char* name,
+  bench_group_fn fn,
+  void* ptr,
+  void (*ptr_free)(void* ptr),
+  bool exclusive
+) {
+  if (b->parent == NULL && b->jobs > 1) {
+    size_t length = strlen(name) + 1;
+    bench_pending_group_t* group = (bench_pending_group_t*) _bench_alloc(b, sizeof(bench_pending_group_t) + length);
+    if (group != NULL) {
+      char* copy = (char*) (group + 1);
+      memcpy(copy, name, length);
+      group->name = copy;
+      group->fn = fn;
+      group->ptr = ptr;
+      group->ptr_free = ptr_free;
+      group->exclusive = exclusive;
+      group->out = NULL;
+      group->done = false;
+      if (bench_array_push(&b->groups, group)) return;
+    }
+  }
+  _bench_group_run(b, name, fn, ptr, ptr_free);
+}
+
+/**
+ * Add a named sub-group
+ *
+ * ```c
+ * void sub_group(bench_t* b) {
+ *   bench_measure(b, "fast", bench_fast);
+ *   bench_measure(b, "slow", bench_slow);
+ * }
+ *
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_group(b, "sub-group", sub_group);
+ * bench_compare(b);
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ *   # sub-group
+ *   fast - 26.92m i/s (±49.87%) (34.11ns/i)
+ *   slow - 3.53m i/s (±165.47%) (278.89ns/i)
+ * ```
+ *
+ * When `jobs` is set on the top-level suite, its groups are instead queued
+ * and run concurrently by `bench_compare`, so `ptr` must stay valid until
+ * then.
+ *
+ * @param b bench namespace
+ * @param name Group name
+ * @param fn Group function
+ * @param ptr Optional pointer to attach to bench_t given to group function
+ */
+static inline void bench_group(bench_t* b, const char *name, bench_group_fn fn, void *ptr, ...) {
+  _bench_group_add(b, name, fn, ptr, NULL, false);
+}
+
+// Hack to make ptr optional
+#define bench_group(t, name, fn, ...) \
+  bench_group(t, name, fn, ##__VA_ARGS__, NULL)
+
+/**
+ * Add a named sub-group which never runs concurrently with other groups,
+ * such as one measuring memory bandwidth or using many threads. When `jobs`
+ * is set on the top-level suite, exclusive groups run one at a time once the
+ * other groups have finished, and are still printed in the order they were
+ * added. Otherwise this is the same as `bench_group`.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * b->jobs = 8;
+ * bench_group(b, "parsing", parsing);
+ * bench_group(b, "hashing", hashing);
+ * bench_group_exclusive(b, "memcpy", memcpy_bandwidth);
+ * bench_compare(b);
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Group name
+ * @param fn Group function
+ * @param ptr Optional pointer to attach to bench_t given to group function
+ */
+static inline void bench_group_exclusive(bench_t* b, const char *name, bench_group_fn fn, void *ptr, ...) {
+  _bench_group_add(b, name, fn, ptr, NULL, true);
+}
+
+// Hack to make ptr optional
+#define bench_group_exclusive(t, name, fn, ...) \
+  bench_group_exclusive(t, name, fn, ##__VA_ARGS__, NULL)
+
+/*!
+ * Initialize a new bench measurement.
+ *
+ * @private
+ * @param m The measurement to initialize.
+ * @param name The name of the measurement, which must outlive it.
+ */
+static inline void bench_measurement_init(
+  bench_measurement_t* m,
+  const char* name
+) {
+  m->name = name;
+  bench_stats_init(&m->stats);
+  bench_histogram_init(&m->histogram);
+  bench_counters_init(&m->counters);
+  bench_allocs_init(&m->allocs);
+  bench_stats_init(&m->repetitions);
+  m->threads = 1;
+  m->wall = 0;
+  m->in_flight = 0;
+  m->rate = 0;
+  m->overhead = 0;
+  m->chunk = 0;
+  m->cpus = NULL;
+  m->nodes = NULL;
+  m->arg = 0;
+  m->has_arg = false;
+  m->bytes = 0;
+  m->items = 0;
+  m->run = NULL;
+  m->ctx = NULL;
+  m->ctx_free = NULL;
+  m->iterations = 0;
+  m->trace = NULL;
+}
+
+/*!
+ * Allocate a measurement and a copy of its name from the arena of the suite.
+ *
+ * @private
+ * @param b bench namespace
+ * @param name The name of the measurement.
+ * @return The measurement, or NULL.
+ */
+static inline bench_measurement_t* _bench_measurement_create(bench_t* b, const char* name) {
+  bench_measurement_t* m = (bench_measurement_t*) _bench_alloc(b, sizeof(bench_measurement_t));
+  const char* copy = _bench_strdup(b, name);
+  if (m == NULL || copy == NULL) return NULL;
+  bench_measurement_init(m, copy);
+  return m;
+}
+
+/**
+ * Measure function signature
+ *
+ * @param data Optional pointer passed through from `bench_measure`
+ */
+typedef void (*bench_measure_fn)(void* data);
+
+/*!
+ * Get high-resolution monotonic timestamp.
+ *
+ * @private
+ * @return Monotonic timestamp in nanoseconds.
+ */
+static inline uint64_t bench_now() {
+#ifdef __APPLE__
+  return mach_continuous_time() * timebase.numer / timebase.denom;
+#elif defined(_WIN32)
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  uint64_t ticks = counter.QuadPart;
+  uint64_t frequency = performance_frequency.QuadPart;
+  return ticks / frequency * SECONDS + ticks % frequency * SECONDS / frequency;
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * SECONDS + t.tv_nsec;
+#endif
+}
+
+/*!
+ * Read the cycle counter at the start of a timed region. The fence keeps
+ * earlier instructions from leaking into the region.
+ *
+ * @private
+ * @return The current cycle counter value.
+ */
+static inline uint64_t _bench_cycles_start() {
+#if defined(__aarch64__)
+  uint64_t value;
+  __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(value) : : "memory");
+  return value;
+#elif defined(BENCH_HAS_CYCLES)
+  _mm_lfence();
+  uint64_t value = __rdtsc();
+  _mm_lfence();
+  return value;
+#else
+  return bench_now();
+#endif
+}
+
+/*!
+ * Read the cycle counter at the end of a timed region. `rdtscp` waits for the
+ * region to retire and the trailing fence keeps later work out of it.
+ *
+ * @private
+ * @return The current cycle counter value.
+ */
+static inline uint64_t _bench_cycles_stop() {
+#if defined(__aarch64__)
+  uint64_t value;
+  __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(value) : : "memory");
+  return value;
+#elif defined(BENCH_HAS_CYCLES)
+  unsigned int aux;
+  uint64_t value = __rdtscp(&aux);
+  _mm_lfence();
+  return value;
+#else
+  return bench_now();
+#endif
+}
+
+/*!
+ * Check whether the cycle counter ticks at a constant rate, independent of
+ * frequency scaling and sleep states.
+ *
+ * @private
+ * @return Whether the cycle counter can be used as a clock.
+ */
+static inline bool _bench_cycles_invariant() {
+#if defined(__aarch64__)
+  return true;
+#elif defined(BENCH_HAS_CYCLES) && defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0x80000000);
+  if ((unsigned int) regs[0] < 0x80000007) return false;
+  __cpuid(regs, 0x80000007);
+  return (regs[3] & (1 << 8)) != 0;
+#elif defined(BENCH_HAS_CYCLES)
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+  return (edx & (1 << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+/*!
+ * Calibrate the cycle counter against the monotonic clock.
+ *
+ * @private
+ */
+static inline void _bench_cycles_calibrate() {
+  if (!_bench_cycles_invariant()) return;
+
+#if defined(__aarch64__)
+  uint64_t frequency;
+  __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+  cycles_per_ns = (double) frequency / SECONDS;
+#else
+  // Spin for ~10ms and compare how far each clock advanced
+  uint64_t start = bench_now();
+  uint64_t start_cycles = _bench_cycles_start();
+  uint64_t end;
+  do {
+    end = bench_now();
+  } while (end - start < 10 * MILLIS);
+  uint64_t end_cycles = _bench_cycles_stop();
+  cycles_per_ns = (double) (end_cycles - start_cycles) / (end - start);
+#endif
+}
+
+/*!
+ * Initialize the clock sources. Cycle counters are calibrated against the
+ * monotonic clock once per process, the first time they are needed.
+ *
+ * @private
+ * @param b bench namespace
+ * @param cycles Whether the cycle counter should be calibrated.
+ */
+static inline void _bench_clock_init(bench_t* b, bool cycles) {
+#ifdef __APPLE__
   if (!timebase_initialized) {
     mach_timebase_info(&timebase);
     timebase_initialized = true;
   }
+#elif defined(_WIN32)
+  if (!performance_frequency_initialized) {
+    QueryPerformanceFrequency(&performance_frequency);
+    performance_frequency_initialized = true;
+  }
+#endif
+
+  if (!cycles) return;
+
+  // Groups running on workers share the calibration, and only read the rate
+  // once the one calibrating it has released the lock
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  _bench_lock(root);
+  if (!cycles_initialized) {
+    _bench_cycles_calibrate();
+    cycles_initialized = true;
+  }
+  _bench_unlock(root);
+}
+
+/*!
+ * Whether the given clock reads the cycle counter.
+ *
+ * @private
+ * @param clock The clock source.
+ * @return Whether cycles are read.
+ */
+static inline bool _bench_clock_is_cycles(bench_clock_t clock) {
+  return clock == BENCH_CLOCK_CYCLES && cycles_per_ns > 0;
+}
+
+/*!
+ * Read the given clock at the start of a timed region.
+ *
+ * @param clock The clock source.
+ * @return Clock ticks, to be converted with `bench_clock_elapsed`.
+ */
+static inline uint64_t bench_clock_start(bench_clock_t clock) {
+  return _bench_clock_is_cycles(clock) ? _bench_cycles_start() : bench_now();
+}
+
+/*!
+ * Read the given clock at the end of a timed region.
+ *
+ * @param clock The clock source.
+ * @return Clock ticks, to be converted with `bench_clock_elapsed`.
+ */
+static inline uint64_t bench_clock_stop(bench_clock_t clock) {
+  return _bench_clock_is_cycles(clock) ? _bench_cycles_stop() : bench_now();
+}
+
+/*!
+ * Convert a span of clock ticks to nanoseconds.
+ *
+ * @param clock The clock source.
+ * @param ticks The difference between two readings of the clock.
+ * @return The span in nanoseconds.
+ */
+static inline uint64_t bench_clock_elapsed(bench_clock_t clock, uint64_t ticks) {
+  if (!_bench_clock_is_cycles(clock)) return ticks;
+  return (uint64_t) (ticks / cycles_per_ns + 0.5);
+}
+
+/**
+ * Threads.
+ */
+
+#ifdef _WIN32
+typedef HANDLE bench_thread_t;
+#else
+typedef pthread_t bench_thread_t;
+#endif
+
+/*!
+ * Thread entry point signature
+ *
+ * @private
+ * @param arg The pointer given to `_bench_thread_create`.
+ */
+typedef void (*bench_thread_fn)(void* arg);
+
+/*!
+ * Entry point and argument of a new thread.
+ *
+ * @private
+ */
+typedef struct bench_thread_start_s {
+  bench_thread_fn fn;
+  void* arg;
+} bench_thread_start_t;
+
+#ifdef _WIN32
+static DWORD WINAPI _bench_thread_main(LPVOID ptr) {
+#else
+static void* _bench_thread_main(void* ptr) {
+#endif
+  bench_thread_start_t start = *(bench_thread_start_t*) ptr;
+  free(ptr);
+  start.fn(start.arg);
+  return 0;
+}
+
+/*!
+ * Start a new thread.
+ *
+ * @private
+ * @param thread Where to store the thread handle.
+ * @param fn The function to run on the thread.
+ * @param arg The pointer to pass to `fn`.
+ * @return Whether the thread was started.
+ */
+static inline bool _bench_thread_create(bench_thread_t* thread, bench_thread_fn fn, void* arg) {
+  bench_thread_start_t* start = (bench_thread_start_t*) malloc(sizeof(bench_thread_start_t));
+  if (start == NULL) return false;
+  start->fn = fn;
+  start->arg = arg;
+#ifdef _WIN32
+  *thread = CreateThread(NULL, 0, _bench_thread_main, start, 0, NULL);
+  if (*thread != NULL) return true;
+#else
+  if (pthread_create(thread, NULL, _bench_thread_main, start) == 0) return true;
+#endif
+  free(start);
+  return false;
+}
+
+/*!
+ * Wait for a thread to finish.
+ *
+ * @private
+ * @param thread The thread to wait for.
+ */
+static inline void _bench_thread_join(bench_thread_t thread) {
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+/*!
+ * Lock the mutex guarding a top-level suite, if its groups are running
+ * concurrently.
+ *
+ * @private
+ * @param root The top-level bench namespace
+ */
+static inline void _bench_lock(bench_t* root) {
+  if (root->lock == NULL) return;
+  _bench_mutex_lock((bench_mutex_t*) root->lock);
+}
+
+/*!
+ * Unlock the mutex locked by `_bench_lock`.
+ *
+ * @private
+ * @param root The top-level bench namespace
+ */
+static inline void _bench_unlock(bench_t* root) {
+  if (root->lock == NULL) return;
+  _bench_mutex_unlock((bench_mutex_t*) root->lock);
+}
+
+/*!
+ * A one-shot barrier which releases every thread once all have arrived.
+ *
+ * @private
+ * @property count The number of threads to wait for.
+ * @property arrived The number of threads which have arrived.
+ */
+typedef struct bench_barrier_s {
+#ifdef _WIN32
+  SRWLOCK lock;
+  CONDITION_VARIABLE cond;
+#else
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+#endif
+  size_t count;
+  size_t arrived;
+} bench_barrier_t;
+
+/*!
+ * Initialize a barrier for the given number of threads.
+ *
+ * @private
+ * @param barrier The barrier to initialize.
+ * @param count The number of threads to wait for.
+ */
+static inline void _bench_barrier_init(bench_barrier_t* barrier, size_t count) {
+#ifdef _WIN32
+  InitializeSRWLock(&barrier->lock);
+  InitializeConditionVariable(&barrier->cond);
+#else
+  pthread_mutex_init(&barrier->lock, NULL);
+  pthread_cond_init(&barrier->cond, NULL);
+#endif
+  barrier->count = count;
+  barrier->arrived = 0;
+}
+
+/*!
+ * Wait until all threads have arrived at the barrier.
+ *
+ * @private
+ * @param barrier The barrier to wait at.
+ */
+static inline void _bench_barrier_wait(bench_barrier_t* barrier) {
+#ifdef _WIN32
+  AcquireSRWLockExclusive(&barrier->lock);
+  if (++barrier->arrived == barrier->count) {
+    WakeAllConditionVariable(&barrier->cond);
+  }
+  while (barrier->arrived < barrier->count) {
+    SleepConditionVariableSRW(&barrier->cond, &barrier->lock, INFINITE, 0);
+  }
+  ReleaseSRWLockExclusive(&barrier->lock);
+#else
+  pthread_mutex_lock(&barrier->lock);
+  if (++barrier->arrived == barrier->count) {
+    pthread_cond_broadcast(&barrier->cond);
+  }
+  while (barrier->arrived < barrier->count) {
+    pthread_cond_wait(&barrier->cond, &barrier->lock);
+  }
+  pthread_mutex_unlock(&barrier->lock);
+#endif
+}
+
+/*!
+ * Release the resources of a barrier.
+ *
+ * @private
+ * @param barrier The barrier to destroy.
+ */
+static inline void _bench_barrier_destroy(bench_barrier_t* barrier) {
+#ifndef _WIN32
+  pthread_mutex_destroy(&barrier->lock);
+  pthread_cond_destroy(&barrier->cond);
+#else
+  (void) barrier;
+#endif
+}
+
+/**
+ * Sample tracing.
+ */
+
+/*!
+ * A raw sample of a traced measurement.
+ *
+ * @private
+ * @property timestamp The monotonic time the sample started at, in
+ *   nanoseconds
+ * @property iterations The number of iterations in the sample
+ * @property elapsed The time the sample took in nanoseconds
+ */
+typedef struct bench_trace_sample_s {
+  uint64_t timestamp;
+  uint64_t iterations;
+  uint64_t elapsed;
+} bench_trace_sample_t;
+
+/*!
+ * The samples of one traced measurement. Only the thread recording the
+ * measurement advances `head` and only the trace writer advances `tail`, so
+ * neither needs a lock. The fields each side writes are padded onto cache
+ * lines of their own, so recording does not contend with writing.
+ *
+ * @private
+ * @property path The slash-separated path of the measurement
+ * @property samples The preallocated samples, `capacity` of them
+ * @property mask `capacity - 1`, with `capacity` a power of two
+ * @property head The number of samples recorded
+ * @property tail The number of samples written
+ * @property dropped The number of samples lost because the ring was full
+ * @property closed Whether the measurement has finished
+ * @property next The next ring of the trace, or of its spare rings
+ */
+typedef struct bench_trace_ring_s {
+  char path[768];
+  bench_trace_sample_t* samples;
+  uint64_t mask;
+  struct bench_trace_ring_s* next;
+  char producer_pad[BENCH_CACHE_LINE];
+  uint64_t head;
+  uint64_t dropped;
+  uint64_t closed;
+  char consumer_pad[BENCH_CACHE_LINE];
+  uint64_t tail;
+  char end_pad[BENCH_CACHE_LINE];
+} bench_trace_ring_t;
+
+/*!
+ * A CSV file the raw samples of every measurement are streamed to by a
+ * writer thread.
+ *
+ * @private
+ * @property out The file written to
+ * @property lock Guards the list of rings
+ * @property rings The rings of measurements which have not been fully written
+ * @property spare Fully written rings, reused by later measurements so the
+ *   arena does not grow with each one
+ * @property stop Set once the suite is done, to stop the writer
+ * @property started Whether the writer thread is running
+ * @property thread The writer thread
+ */
+typedef struct bench_trace_s {
+  FILE* out;
+  bench_mutex_t lock;
+  bench_trace_ring_t* rings;
+  bench_trace_ring_t* spare;
+  uint64_t stop;
+  bool started;
+  bench_thread_t thread;
+} bench_trace_t;
+
+// The ring samples recorded on this thread are traced to, or NULL
+static BENCH_THREAD_LOCAL bench_trace_ring_t* _bench_thread_trace = NULL;
+
+// Whether the batches run on this thread are recorded, rather than warming
+// up or calibrating
+static BENCH_THREAD_LOCAL bool _bench_thread_recording = false;
+
+/*!
+ * Read a value shared between threads, with acquire ordering.
+ *
+ * @private
+ */
+static inline uint64_t _bench_atomic_load(uint64_t* value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return (uint64_t) InterlockedCompareExchange64((volatile LONG64*) value, 0, 0);
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/*!
+ * Write a value shared between threads, with release ordering.
+ *
+ * @private
+ */
+static inline void _bench_atomic_store(uint64_t* value, uint64_t next) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  InterlockedExchange64((volatile LONG64*) value, (LONG64) next);
+#else
+  __atomic_store_n(value, next, __ATOMIC_RELEASE);
+#endif
+}
+
+/*!
+ * Record a sample to the ring of the calling thread, if it is traced. Never
+ * blocks or allocates; samples are dropped while the ring is full.
+ *
+ * @private
+ * @param timestamp The monotonic time the sample started at.
+ * @param iterations The number of iterations in the sample.
+ * @param elapsed The time the sample took in nanoseconds.
+ */
+static inline void _bench_trace_record(uint64_t timestamp, uint64_t iterations, uint64_t elapsed) {
+  bench_trace_ring_t* ring = _bench_thread_trace;
+  if (ring == NULL) return;
+
+  uint64_t head = ring->head;
+  if (head - _bench_atomic_load(&ring->tail) > ring->mask) {
+    ring->dropped++;
+    return;
+  }
+  bench_trace_sample_t* sample = &ring->samples[head & ring->mask];
+  sample->timestamp = timestamp;
+  sample->iterations = iterations;
+  sample->elapsed = elapsed;
+  _bench_atomic_store(&ring->head, head + 1);
+}
+
+/*!
+ * Write the samples of a ring which have not been written yet. Called by
+ * the writer, or with the lock held when there is no writer thread.
+ *
+ * @private
+ * @param trace The trace.
+ * @param ring The ring to drain.
+ * @return Whether any sample was written.
+ */
+static inline bool _bench_trace_drain(bench_trace_t* trace, bench_trace_ring_t* ring) {
+  uint64_t head = _bench_atomic_load(&ring->head);
+  uint64_t tail = ring->tail;
+  if (tail == head) return false;
+
+  for (; tail != head; tail++) {
+    bench_trace_sample_t* sample = &ring->samples[tail & ring->mask];
+    _bench_csv_string(trace->out, ring->path);
+    fprintf(trace->out, ",%llu,%llu,%llu\n",
+      (unsigned long long) sample->timestamp,
+      (unsigned long long) sample->iterations,
+      (unsigned long long) sample->elapsed);
+  }
+  _bench_atomic_store(&ring->tail, tail);
+  return true;
+}
+
+/*!
+ * Move the rings of finished measurements to the spare rings once they are
+ * fully written. Called with the lock held.
+ *
+ * @private
+ * @param trace The trace.
+ * @return Whether any sample was written.
+ */
+static inline bool _bench_trace_flush(bench_trace_t* trace) {
+  bool written = false;
+  bench_trace_ring_t** link = &trace->rings;
+  while (*link != NULL) {
+    bench_trace_ring_t* ring = *link;
+    // The last samples are recorded before the ring is closed
+    bool closed = _bench_atomic_load(&ring->closed) != 0;
+    written = _bench_trace_drain(trace, ring) || written;
+    if (!closed) {
+      link = &ring->next;
+      continue;
+    }
+
+    if (ring->dropped > 0) {
+      fprintf(stderr, "benc.h: dropped %llu trace samples of %s\n", (unsigned long long) ring->dropped, ring->path);
+    }
+    *link = ring->next;
+    ring->next = trace->spare;
+    trace->spare = ring;
+  }
+  return written;
+}
+
+/*!
+ * The trace writer thread, which streams samples out of the rings until the
+ * suite is done.
+ *
+ * @private
+ * @param arg The trace.
+ */
+static inline void _bench_trace_writer(void* arg) {
+  bench_trace_t* trace = (bench_trace_t*) arg;
+  for (;;) {
+    bool stop = _bench_atomic_load(&trace->stop) != 0;
+    _bench_mutex_lock(&trace->lock);
+    _bench_trace_flush(trace);
+    bool empty = trace->rings == NULL;
+    _bench_mutex_unlock(&trace->lock);
+    if (stop && empty) break;
+
+    // Sleep even while samples wait, so the writer only wakes up briefly
+    // rather than competing with the measurement for its core
+#ifdef _WIN32
+    Sleep((DWORD) (BENCH_TRACE_INTERVAL / (MILLIS)));
+#else
+    struct timespec delay = { 0, (long) BENCH_TRACE_INTERVAL };
+    nanosleep(&delay, NULL);
+#endif
+  }
+  fflush(trace->out);
+}
+
+/*!
+ * Start tracing the samples of a measurement recorded on the calling thread.
+ *
+ * @private
+ * @param b bench namespace the measurement belongs to
+ * @param name Measurement name
+ * @return The ring of the measurement, or NULL if it is not traced.
+ */
+static inline bench_trace_ring_t* _bench_trace_open(bench_t* b, const char* name) {
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  bench_trace_t* trace = root->trace;
+  if (trace == NULL) return NULL;
+
+  uint64_t capacity = 1;
+  while (capacity < BENCH_TRACE_CAPACITY) capacity <<= 1;
+
+  _bench_mutex_lock(&trace->lock);
+  bench_trace_ring_t* ring = trace->spare;
+  if (ring != NULL) trace->spare = ring->next;
+  _bench_mutex_unlock(&trace->lock);
+
+  if (ring == NULL) {
+    ring = (bench_trace_ring_t*) _bench_alloc(b, sizeof(bench_trace_ring_t));
+    if (ring == NULL) return NULL;
+    ring->samples = (bench_trace_sample_t*) _bench_alloc(b, capacity * sizeof(bench_trace_sample_t));
+    if (ring->samples == NULL) return NULL;
+  }
+
+  size_t length = _bench_group_path(b, ring->path, sizeof(ring->path) - 1);
+  snprintf(ring->path + length, sizeof(ring->path) - length, "/%s", name);
+  ring->mask = capacity - 1;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->dropped = 0;
+  ring->closed = 0;
+
+  _bench_mutex_lock(&trace->lock);
+  ring->next = trace->rings;
+  trace->rings = ring;
+  _bench_mutex_unlock(&trace->lock);
+  return ring;
+}
+
+/*!
+ * Finish tracing a measurement. Its remaining samples are written by the
+ * writer thread, or right away when there is none.
+ *
+ * @private
+ * @param b bench namespace the measurement belongs to
+ * @param ring The ring returned by `_bench_trace_open`, or NULL.
+ */
+static inline void _bench_trace_close(bench_t* b, bench_trace_ring_t* ring) {
+  if (ring == NULL) return;
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  bench_trace_t* trace = root->trace;
+
+  _bench_atomic_store(&ring->closed, 1);
+  if (!trace->started) {
+    _bench_mutex_lock(&trace->lock);
+    _bench_trace_flush(trace);
+    _bench_mutex_unlock(&trace->lock);
+  }
+}
+
+/*!
+ * Stop the trace writer once every sample is written. The trace and its
+ * rings are freed with the arena of the suite.
+ *
+ * @private
+ * @param trace The trace.
+ */
+static inline void _bench_trace_free(bench_trace_t* trace) {
+  _bench_atomic_store(&trace->stop, 1);
+  if (trace->started) {
+    _bench_thread_join(trace->thread);
+  } else {
+    _bench_trace_flush(trace);
+    fflush(trace->out);
+  }
+  _bench_mutex_destroy(&trace->lock);
+}
+
+// Defined with thread placement, which lists the CPUs
+static inline size_t _bench_cpus_available(int* cpus, size_t max);
+
+/**
+ * Stream the raw samples of every measurement of the suite, other than
+ * parallel ones, to a CSV file,
+ * with the monotonic time each sample started at, to find periodic stalls or
+ * line samples up with system traces. The clock is `CLOCK_MONOTONIC` on
+ * Linux, as used by `perf record -k CLOCK_MONOTONIC`.
+ *
+ * Samples are recorded to a preallocated ring per measurement, without any
+ * locking, allocation or I/O, and written by a background thread which
+ * drains the rings every `BENCH_TRACE_INTERVAL`. With fewer than two CPUs to
+ * run on, there is no writer thread, and each ring is written once its
+ * measurement finishes instead, so the writer never takes turns with the
+ * measurement on its core. Samples are dropped, with a warning, if more
+ * than `BENCH_TRACE_CAPACITY` of them are waiting to be written. The file
+ * stays open and is flushed once the suite is compared. Measurements are
+ * not isolated in child processes while tracing.
+ *
+ * Unbatched measurements record a sample per call, so a 30ns function
+ * records about 33k samples each millisecond. The ring must hold the
+ * samples of one writer interval, or of the whole measurement without a
+ * writer thread: `target_time` divided by the time per sample. Set
+ * `batch_time` so each sample spans many calls, or define
+ * `BENCH_TRACE_CAPACITY` before including the header to raise it.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_trace(b, fopen("trace.csv", "w"));
+ * bench_measure(b, "fast", bench_fast);
+ * bench_compare(b);
+ * ```
+ *
+ * ```
+ * path,timestamp_ns,iterations,elapsed_ns
+ * bench/fast,5902189496714,1024,34862
+ * ...
+ * ```
+ *
+ * @param b The top-level bench namespace
+ * @param out The file to write to.
+ * @return Whether tracing was started.
+ */
+static inline bool bench_trace(bench_t* b, FILE* out) {
+  while (b->parent != NULL) b = b->parent;
+  if (out == NULL || b->trace != NULL) return false;
+
+  bench_trace_t* trace = (bench_trace_t*) _bench_alloc(b, sizeof(bench_trace_t));
+  if (trace == NULL) return false;
+  trace->out = out;
+  _bench_mutex_init(&trace->lock);
+  trace->rings = NULL;
+  trace->spare = NULL;
+  trace->stop = 0;
+  fprintf(out, "path,timestamp_ns,iterations,elapsed_ns\n");
+
+  // Without a writer thread, each measurement is written once it finishes
+  int cpus[BENCH_MAX_CPUS];
+  bool spare = _bench_cpus_available(cpus, BENCH_MAX_CPUS) > 1;
+  trace->started = spare && _bench_thread_create(&trace->thread, _bench_trace_writer, trace);
+  b->trace = trace;
+  return true;
+}
+
+/**
+ * CPU affinity.
+ */
+
+/*!
+ * The affinity of a thread before it was pinned, to restore afterwards.
+ *
+ * @private
+ * @property pinned Whether the thread was pinned.
+ */
+typedef struct bench_affinity_s {
+  bool pinned;
+#ifdef __linux__
+  unsigned long mask[BENCH_MAX_CPUS / (8 * sizeof(unsigned long))];
+#elif defined(_WIN32)
+  DWORD_PTR mask;
+#endif
+} bench_affinity_t;
+
+/*!
+ * List the CPUs this process may run on.
+ *
+ * @private
+ * @param cpus Where to write the CPU numbers, in ascending order.
+ * @param max The capacity of `cpus`.
+ * @return The number of CPUs written.
+ */
+static inline size_t _bench_cpus_available(int* cpus, size_t max) {
+  size_t count = 0;
+#ifdef __linux__
+  unsigned long mask[BENCH_MAX_CPUS / (8 * sizeof(unsigned long))] = { 0 };
+  if (syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask) > 0) {
+    for (int cpu = 0; cpu < BENCH_MAX_CPUS && count < max; cpu++) {
+      if (mask[cpu / (8 * sizeof(unsigned long))] & (1UL << (cpu % (8 * sizeof(unsigned long))))) {
+        cpus[count++] = cpu;
+      }
+    }
+    return count;
+  }
+#endif
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  long online = (long) info.dwNumberOfProcessors;
+#else
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  for (long cpu = 0; cpu < online && count < max; cpu++) {
+    cpus[count++] = (int) cpu;
+  }
+  return count;
+}
+
+/*!
+ * Find the socket a CPU belongs to.
+ *
+ * @private
+ * @param cpu The CPU number.
+ * @return The physical package id, or 0 when unknown.
+ */
+static inline int _bench_cpu_package(int cpu) {
+  int package = 0;
+#ifdef __linux__
+  char path[96];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+  FILE* file = fopen(path, "r");
+  if (file != NULL) {
+    if (fscanf(file, "%d", &package) != 1) package = 0;
+    fclose(file);
+  }
+#else
+  (void) cpu;
+#endif
+  return package;
+}
+
+/*!
+ * Find the physical core a CPU belongs to.
+ *
+ * @private
+ * @param cpu The CPU number.
+ * @return The first CPU of the core, which is `cpu` itself when unknown.
+ */
+static inline int _bench_cpu_core(int cpu) {
+  int core = cpu;
+#ifdef __linux__
+  char path[96];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+  FILE* file = fopen(path, "r");
+  if (file != NULL) {
+    if (fscanf(file, "%d", &core) != 1) core = cpu;
+    fclose(file);
+  }
+#endif
+  return core;
+}
+
+/*!
+ * Choose the CPUs for the threads of a parallel measurement.
+ *
+ * @private
+ * @param b bench namespace
+ * @param order Where to write the CPU of each thread.
+ * @param threads The number of threads.
+ * @return Whether CPUs were chosen; false if threads should not be pinned.
+ */
+static inline bool _bench_placement(bench_t* b, int* order, uint32_t threads) {
+  if (b->placement == BENCH_PLACEMENT_NONE) return false;
+
+  if (b->placement == BENCH_PLACEMENT_LIST) {
+    if (b->cpu_list == NULL || b->cpu_list_size == 0) return false;
+    for (uint32_t i = 0; i < threads; i++) {
+      order[i] = b->cpu_list[i % b->cpu_list_size];
+    }
+    return true;
+  }
+
+  int* cpus = (int*) malloc(BENCH_MAX_CPUS * sizeof(int));
+  int* packages = (int*) malloc(BENCH_MAX_CPUS * sizeof(int));
+  size_t count = cpus && packages ? _bench_cpus_available(cpus, BENCH_MAX_CPUS) : 0;
+  if (count == 0) {
+    free(cpus);
+    free(packages);
+    return false;
+  }
+
+  // Sort CPUs by socket, keeping them in ascending order within each socket
+  for (size_t i = 0; i < count; i++) {
+    packages[i] = _bench_cpu_package(cpus[i]);
+  }
+  for (size_t i = 1; i < count; i++) {
+    int cpu = cpus[i];
+    int package = packages[i];
+    size_t j = i;
+    for (; j > 0 && packages[j - 1] > package; j--) {
+      cpus[j] = cpus[j - 1];
+      packages[j] = packages[j - 1];
+    }
+    cpus[j] = cpu;
+    packages[j] = package;
+  }
+
+  bool placed = true;
+  if (b->placement == BENCH_PLACEMENT_COMPACT) {
+    for (uint32_t i = 0; i < threads; i++) {
+      order[i] = cpus[i % count];
+    }
+  } else {
+    // Take the next unused CPU of each socket in turn, or leave the threads
+    // unpinned without room to track them
+    bool* used = (bool*) calloc(count, sizeof(bool));
+    placed = used != NULL;
+    size_t taken = 0;
+    uint32_t i = 0;
+    while (used != NULL && i < threads) {
+      if (taken == count) {
+        memset(used, 0, count * sizeof(bool));
+        taken = 0;
+      }
+      int last_package = -1;
+      for (size_t c = 0; c < count && i < threads; c++) {
+        if (used[c] || packages[c] == last_package) continue;
+        used[c] = true;
+        taken++;
+        last_package = packages[c];
+        order[i++] = cpus[c];
+      }
+    }
+    free(used);
+  }
+
+  free(cpus);
+  free(packages);
+  return placed;
+}
+
+/*!
+ * Pin the calling thread to a CPU. On macOS this sets an affinity tag, which
+ * the scheduler treats as a hint.
+ *
+ * @private
+ * @param cpu The CPU number.
+ * @param saved Where to save the previous affinity.
+ * @return Whether the thread was pinned.
+ */
+static inline bool _bench_pin_thread(int cpu, bench_affinity_t* saved) {
+  saved->pinned = false;
+  if (cpu < 0 || cpu >= BENCH_MAX_CPUS) return false;
+#ifdef __linux__
+  if (syscall(SYS_sched_getaffinity, 0, sizeof(saved->mask), saved->mask) <= 0) return false;
+  unsigned long mask[BENCH_MAX_CPUS / (8 * sizeof(unsigned long))] = { 0 };
+  mask[cpu / (8 * sizeof(unsigned long))] = 1UL << (cpu % (8 * sizeof(unsigned long)));
+  saved->pinned = syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#elif defined(__APPLE__)
+  thread_affinity_policy_data_t policy = { cpu + 1 };
+  saved->pinned = thread_policy_set(
+    pthread_mach_thread_np(pthread_self()),
+    THREAD_AFFINITY_POLICY,
+    (thread_policy_t) &policy,
+    THREAD_AFFINITY_POLICY_COUNT
+  ) == KERN_SUCCESS;
+#elif defined(_WIN32)
+  if (cpu >= (int) (8 * sizeof(DWORD_PTR))) return false;
+  saved->mask = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu);
+  saved->pinned = saved->mask != 0;
+#endif
+  return saved->pinned;
+}
+
+/*!
+ * Restore the affinity a thread had before `_bench_pin_thread`.
+ *
+ * @private
+ * @param saved The affinity saved by `_bench_pin_thread`.
+ */
+static inline void _bench_unpin_thread(bench_affinity_t* saved) {
+  if (!saved->pinned) return;
+#ifdef __linux__
+  syscall(SYS_sched_setaffinity, 0, sizeof(saved->mask), saved->mask);
+#elif defined(__APPLE__)
+  thread_affinity_policy_data_t policy = { THREAD_AFFINITY_TAG_NULL };
+  thread_policy_set(
+    pthread_mach_thread_np(pthread_self()),
+    THREAD_AFFINITY_POLICY,
+    (thread_policy_t) &policy,
+    THREAD_AFFINITY_POLICY_COUNT
+  );
+#elif defined(_WIN32)
+  SetThreadAffinityMask(GetCurrentThread(), saved->mask);
+#endif
+  saved->pinned = false;
+}
+
+/*!
+ * Find the CPU and NUMA node the calling thread is running on.
+ *
+ * @private
+ * @param cpu Where to write the CPU number, or -1 when unknown.
+ * @param node Where to write the NUMA node, or -1 when unknown.
+ */
+static inline void _bench_current_cpu(int* cpu, int* node) {
+  *cpu = -1;
+  *node = -1;
+#ifdef __linux__
+  unsigned int c, n;
+  if (syscall(SYS_getcpu, &c, &n, NULL) == 0) {
+    *cpu = (int) c;
+    *node = (int) n;
+  }
+#elif defined(_WIN32)
+  PROCESSOR_NUMBER number;
+  GetCurrentProcessorNumberEx(&number);
+  *cpu = number.Group * 64 + number.Number;
+  USHORT n;
+  if (GetNumaProcessorNodeEx(&number, &n)) *node = n;
+#endif
+}
+
+/**
+ * Hardware performance counters.
+ */
+
+/*!
+ * An open group of performance counters for the calling thread.
+ *
+ * @private
+ * @property fds The file descriptor of each counter, or -1.
+ * @property leader The file descriptor of the group leader, or -1.
+ * @property order The counter read at each position of a group read.
+ * @property opened The number of counters in the group.
+ */
+typedef struct bench_perf_s {
+  int fds[BENCH_COUNTER_COUNT];
+  int leader;
+  bench_counter_t order[BENCH_COUNTER_COUNT];
+  size_t opened;
+} bench_perf_t;
+
+/*!
+ * Open the performance counters of the calling thread. Counters which are
+ * unavailable, such as in containers or virtual machines, are skipped.
+ *
+ * @private
+ * @param perf The counter group to open.
+ * @return Whether any counters could be opened.
+ */
+static inline bool _bench_perf_open(bench_perf_t* perf) {
+  perf->leader = -1;
+  perf->opened = 0;
+  for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+    perf->fds[i] = -1;
+  }
+
+#ifdef __linux__
+  static const uint32_t types[] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+  };
+  static const uint64_t configs[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+  };
+
+  for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = perf->leader == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP
+      | PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, perf->leader, 0);
+    if (fd < 0) continue;
+    if (perf->leader == -1) perf->leader = fd;
+    perf->fds[i] = fd;
+    perf->order[perf->opened++] = (bench_counter_t) i;
+  }
+#endif
+
+  return perf->opened > 0;
+}
+
+/*!
+ * Reset and start the performance counters.
+ *
+ * @private
+ * @param perf The counter group.
+ */
+static inline void _bench_perf_start(bench_perf_t* perf) {
+#ifdef __linux__
+  if (perf->leader == -1) return;
+  ioctl(perf->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  (void) perf;
+#endif
+}
+
+/*!
+ * Stop the performance counters and add their values to the given totals.
+ * Values are scaled up if the kernel had to multiplex the counters.
+ *
+ * @private
+ * @param perf The counter group.
+ * @param counters The totals to add to.
+ */
+static inline void _bench_perf_stop(bench_perf_t* perf, bench_counters_t* counters) {
+#ifdef __linux__
+  if (perf->leader == -1) return;
+  ioctl(perf->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  uint64_t buffer[3 + BENCH_COUNTER_COUNT];
+  ssize_t size = read(perf->leader, buffer, sizeof(buffer));
+  if (size < (ssize_t) (3 * sizeof(uint64_t)) || buffer[0] != perf->opened) return;
+
+  uint64_t enabled = buffer[1];
+  uint64_t running = buffer[2];
+  if (running == 0) return;
+
+  for (size_t i = 0; i < perf->opened; i++) {
+    bench_counter_t counter = perf->order[i];
+    counters->values[counter] += (uint64_t) ((double) buffer[3 + i] * enabled / running);
+    counters->available |= 1u << counter;
+  }
+#else
+  (void) perf;
+  (void) counters;
+#endif
+}
+
+/*!
+ * Close the performance counters.
+ *
+ * @private
+ * @param perf The counter group.
+ */
+static inline void _bench_perf_close(bench_perf_t* perf) {
+#ifdef __linux__
+  for (int i = 0; i < BENCH_COUNTER_COUNT; i++) {
+    if (perf->fds[i] != -1) close(perf->fds[i]);
+  }
+#endif
+  perf->leader = -1;
+  perf->opened = 0;
+}
+
+/*!
+ * A measurement function and its data, run by `_bench_fn_batch`.
+ *
+ * @private
+ */
+typedef struct bench_fn_data_s {
+  bench_measure_fn fn;
+  void* data;
+} bench_fn_data_t;
+
+/*!
+ * Batch runner calling a `bench_measure_fn`.
+ *
+ * @private
+ * @param ctx The bench_fn_data_t to call.
+ * @param clock The clock source.
+ * @param iterations The number of calls to make.
+ * @return The time taken by the batch in nanoseconds.
+ */
+static inline uint64_t _bench_fn_batch(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_measure_fn fn = ((bench_fn_data_t*) ctx)->fn;
+  void* data = ((bench_fn_data_t*) ctx)->data;
+
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    fn(data);
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/**
+ * Overhead calibration.
+ */
+
+/*!
+ * Measurement function which does nothing, to measure the cost of calls.
+ *
+ * @private
+ */
+static inline void _bench_empty(void* data) {
+  (void) data;
+}
+
+/*!
+ * Sort doubles in ascending order with `qsort`.
+ *
+ * @private
+ */
+static inline int _bench_compare_double(const void* a, const void* b) {
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/*!
+ * Find the median time per iteration of a batch runner, less the time
+ * spent reading the clock.
+ *
+ * @private
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ * @param clock The clock source.
+ * @param iterations The number of iterations per sample.
+ * @param timer The nanoseconds per sample spent reading the clock.
+ * @return The median nanoseconds per iteration, at least 0.
+ */
+static inline double _bench_overhead_median(
+  bench_batch_fn run,
+  void* ctx,
+  bench_clock_t clock,
+  uint64_t iterations,
+  double timer
+) {
+  double samples[BENCH_OVERHEAD_SAMPLES];
+  for (size_t i = 0; i < BENCH_OVERHEAD_SAMPLES; i++) {
+    samples[i] = ((double) run(ctx, clock, iterations) - timer) / (iterations > 0 ? iterations : 1);
+  }
+  qsort(samples, BENCH_OVERHEAD_SAMPLES, sizeof(double), _bench_compare_double);
+  double median = samples[BENCH_OVERHEAD_SAMPLES / 2];
+  return median > 0 ? median : 0;
+}
+
+/*!
+ * Measure the overhead of the given clock source, once per process.
+ *
+ * @private
+ * @param b bench namespace
+ * @param clock The clock source.
+ * @return The overhead of the clock source.
+ */
+static inline bench_overhead_t* _bench_overhead_calibrate(bench_t* b, bench_clock_t clock) {
+  bench_overhead_t* overhead = &_bench_overheads[clock == BENCH_CLOCK_CYCLES];
+  _bench_clock_init(b, clock == BENCH_CLOCK_CYCLES);
+
+  // Groups running on workers measure it once between them
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  _bench_lock(root);
+  if (overhead->timer < 0) {
+    // Called through volatile pointers, so the empty loop is not optimized out
+    bench_batch_fn volatile run = _bench_fn_batch;
+    bench_measure_fn volatile empty = _bench_empty;
+    bench_fn_data_t ctx = { empty, NULL };
+
+    double timer = _bench_overhead_median(run, &ctx, clock, 0, 0);
+    overhead->call = _bench_overhead_median(run, &ctx, clock, BENCH_OVERHEAD_ITERATIONS, timer);
+    overhead->timer = timer;
+  }
+  _bench_unlock(root);
+  return overhead;
+}
+
+/*!
+ * Print the overhead subtracted from the measurements of a suite.
+ *
+ * @private
+ */
+static inline void _bench_overhead_print(bench_t* b, bench_overhead_t* overhead) {
+  _bench_print_indent(b);
+  fprintf(b->out, "overhead: ");
+  bench_human_number(b->out, overhead->timer, true);
+  fprintf(b->out, "/sample timer, ");
+  bench_human_number(b->out, overhead->call, true);
+  fprintf(b->out, "/i call");
+  if (overhead->function >= 0) {
+    fprintf(b->out, ", ");
+    bench_human_number(b->out, overhead->function, true);
+    fprintf(b->out, "/i std::function");
+  }
+  fprintf(b->out, " (subtracted)\n");
+}
+
+/*!
+ * Subtract the overhead of the timer and of the calls from a measurement
+ * once it has been sampled, when `subtract_overhead` is set. Every sample
+ * read the clock as often and made as many calls, so the overhead shifts
+ * every iteration by the same time and leaves the variance as it is.
+ *
+ * @private
+ * @param b bench namespace
+ * @param m The measurement to correct.
+ */
+static inline void _bench_overhead_subtract(bench_t* b, bench_measurement_t* m) {
+  if (!b->subtract_overhead || m->stats.count == 0) return;
+  bench_overhead_t* overhead = _bench_overhead_calibrate(b, b->clock);
+
+  // Code indistinguishable from the overhead is left at a picosecond per
+  // iteration, so its throughput stays finite
+  double floor = 1.0 / BENCH_HISTOGRAM_SCALE;
+  // Samples timed in chunks read the clock once per chunk
+  uint64_t reads = 1;
+  if (m->chunk > 0) {
+    uint64_t iterations = m->stats.count / m->stats.samples;
+    reads = (iterations + m->chunk - 1) / m->chunk;
+  }
+  double shift = overhead->timer * reads * m->stats.samples / m->stats.count + m->overhead;
+  if (shift > m->stats.mean - floor) shift = m->stats.mean > floor ? m->stats.mean - floor : 0;
+  m->stats.mean -= shift;
+  uint64_t total = (uint64_t) (shift * m->stats.count);
+  m->stats.total = m->stats.total > total ? m->stats.total - total : 1;
+
+  if (m->repetitions.samples > 0) {
+    m->repetitions.mean -= shift * BENCH_HISTOGRAM_SCALE;
+    if (m->repetitions.mean < 0) m->repetitions.mean = 0;
+  }
+
+  // Move each bucket of the histogram down by the same time, in place.
+  // Buckets only move down, into buckets which were already moved.
+  bench_histogram_t* hist = &m->histogram;
+  uint64_t min = hist->min;
+  uint64_t max = hist->max;
+  hist->count = 0;
+  hist->min = UINT64_MAX;
+  hist->max = 0;
+  uint64_t offset = (uint64_t) (shift * BENCH_HISTOGRAM_SCALE);
+  for (size_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++) {
+    uint64_t count = hist->counts[i];
+    if (count == 0) continue;
+    hist->counts[i] = 0;
+    uint64_t value = _bench_histogram_value(i);
+    if (value > max) value = max;
+    if (value < min) value = min;
+    bench_histogram_record(hist, value > offset ? value - offset : 0, count);
+  }
+}
+
+/**
+ * Measure the overhead the framework adds to every measurement, and
+ * subtract it from the results of the suite and the groups added to it
+ * afterwards. The time spent reading the clock is subtracted from every
+ * sample, and the time spent calling the measurement function through a
+ * pointer from each iteration of `bench_measure`, `bench_measure_range` and
+ * `bench_measure_parallel`. The overhead is measured once per process and
+ * printed under the header. Results within the overhead are left at a
+ * picosecond per iteration.
+ *
+ * Without subtraction, the overhead inflates the time of tiny measurements
+ * and shrinks the difference between them. With it, an empty function
+ * measures close to zero.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_subtract_overhead(b);
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ * overhead: 21.36ns/sample timer, 1.42ns/i call (subtracted)
+ * ```
+ *
+ * @param b bench namespace
+ * @return The overhead subtracted with the suite's clock source.
+ */
+static inline bench_overhead_t* bench_subtract_overhead(bench_t* b) {
+  _bench_overhead_calibrate(b, BENCH_CLOCK_MONOTONIC);
+  _bench_overhead_calibrate(b, BENCH_CLOCK_CYCLES);
+  bench_overhead_t* overhead = _bench_overhead_calibrate(b, b->clock);
+  b->subtract_overhead = true;
+
+  _bench_print_header(b);
+  _bench_overhead_print(b, overhead);
+  return overhead;
+}
+
+/*!
+ * Run the code untimed until both the warmup time and the warmup iteration
+ * count have been reached.
+ *
+ * @private
+ * @param b bench namespace
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ */
+static inline void _bench_warmup(bench_t* b, bench_batch_fn run, void* ctx) {
+  uint64_t start = bench_now();
+  uint64_t calls = 0;
+
+  while (calls < b->warmup_iterations || bench_now() - start < b->warmup_time) {
+    run(ctx, BENCH_CLOCK_MONOTONIC, 1);
+    calls++;
+  }
+}
+
+/*!
+ * Take samples until the relative standard deviation of the most recent
+ * `BENCH_STEADY_WINDOW` of them drops to `steady_state`, or until
+ * `target_time` passes without settling. The samples are not recorded.
+ *
+ * @private
+ * @param b bench namespace
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ * @param iterations The number of iterations per sample.
+ */
+static inline void _bench_wait_steady(
+  bench_t* b,
+  bench_batch_fn run,
+  void* ctx,
+  uint64_t iterations
+) {
+  if (b->steady_state <= 0) return;
+
+  float window[BENCH_STEADY_WINDOW];
+  size_t samples = 0;
+  uint64_t start = bench_now();
+
+  while (bench_now() - start < b->target_time) {
+    uint64_t elapsed = run(ctx, b->clock, iterations);
+    window[samples++ % BENCH_STEADY_WINDOW] = (float) elapsed / iterations;
+    if (samples < BENCH_STEADY_WINDOW) continue;
+
+    float mean = 0;
+    for (size_t i = 0; i < BENCH_STEADY_WINDOW; i++) {
+      mean += window[i];
+    }
+    mean /= BENCH_STEADY_WINDOW;
+
+    float d_squared = 0;
+    for (size_t i = 0; i < BENCH_STEADY_WINDOW; i++) {
+      d_squared += (window[i] - mean) * (window[i] - mean);
+    }
+
+    float stddev = sqrt(d_squared / BENCH_STEADY_WINDOW);
+    if (mean > 0 && stddev / mean <= b->steady_state) return;
+  }
+}
+
+/*!
+ * Find how many calls fit in a sample of at least `batch_time` nanoseconds.
+ * The calibration samples are not recorded.
+ *
+ * @private
+ * @param b bench namespace
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ * @return The number of iterations to run per sample.
+ */
+static inline uint64_t _bench_calibrate_batch(bench_t* b, bench_batch_fn run, void* ctx) {
+  uint64_t iterations = 1;
+  if (b->batch_time == 0) return iterations;
+
+  while (true) {
+    uint64_t elapsed = run(ctx, b->clock, iterations);
+    if (elapsed >= b->batch_time || iterations >= BENCH_MAX_BATCH) return iterations;
+
+    // Scale towards the batch time, growing at most 10x per round so a noisy
+    // first sample can not overshoot wildly.
+    uint64_t next = elapsed > 0
+      ? iterations * b->batch_time / elapsed + 1
+      : iterations * 10;
+    if (next > iterations * 10) next = iterations * 10;
+    if (next <= iterations) next = iterations * 2;
+    iterations = next < BENCH_MAX_BATCH ? next : BENCH_MAX_BATCH;
+  }
+}
+
+/*!
+ * Warm up the given batch runner, then calibrate its batch size and wait for
+ * it to reach a steady state.
+ *
+ * @private
+ * @param b bench namespace
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ * @return The number of iterations to run per sample.
+ */
+static inline uint64_t _bench_sample_prepare(bench_t* b, bench_batch_fn run, void* ctx) {
+  _bench_warmup(b, run, ctx);
+  uint64_t iterations = _bench_calibrate_batch(b, run, ctx);
+  _bench_wait_steady(b, run, ctx, iterations);
+  return iterations;
+}
+
+/*!
+ * Whether enough samples have been recorded, either because `target_time`
+ * (or `max_time`) has been spent or the margin of error reached `target_rme`.
+ *
+ * @private
+ * @param b bench namespace
+ * @param stats The stats recorded so far.
+ */
+static inline bool _bench_sample_done(bench_t* b, bench_stats_t* stats) {
+  uint64_t max_time = b->target_rme > 0 && b->max_time > 0 ? b->max_time : b->target_time;
+  if (stats->total >= max_time) return true;
+
+  return b->target_rme > 0 &&
+    stats->total >= b->min_time &&
+    stats->samples >= BENCH_ADAPTIVE_MIN_SAMPLES &&
+    bench_stats_rme(stats) <= b->target_rme;
+}
+
+/*!
+ * Record samples of the given batch runner until done, or until `budget`
+ * more nanoseconds have been recorded.
+ *
+ * @private
+ * @param b bench namespace
+ * @param stats The stats to record samples to.
+ * @param histogram The histogram to record samples to.
+ * @param counters The performance counter totals to add to.
+ * @param allocs The allocation totals to add to.
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ * @param iterations The number of iterations to run per sample.
+ * @param budget The most time in nanoseconds to record samples for.
+ */
+static inline void _bench_sample_record(
+  bench_t* b,
+  bench_stats_t* stats,
+  bench_histogram_t* histogram,
+  bench_counters_t* counters,
+  bench_allocs_t* allocs,
+  bench_batch_fn run,
+  void* ctx,
+  uint64_t iterations,
+  uint64_t budget
+) {
+  bench_perf_t perf = { { 0 }, -1, { BENCH_COUNTER_CYCLES }, 0 };
+  bool perf_opened = b->counters && _bench_perf_open(&perf);
+  if (perf_opened) {
+    _bench_perf_start(&perf);
+  }
+
+  _bench_allocs_start(b->allocations);
+
+  bench_clock_t clock = b->clock;
+  uint64_t until = budget < UINT64_MAX - stats->total ? stats->total + budget : UINT64_MAX;
+  bool traced = _bench_thread_trace != NULL;
+  uint64_t stalled = 0;
+  _bench_thread_recording = true;
+  while (stats->total < until && !_bench_sample_done(b, stats)) {
+    uint64_t timestamp = traced ? bench_now() : 0;
+    uint64_t elapsed = run(ctx, clock, iterations);
+    stalled = elapsed > 0 ? 0 : stalled + 1;
+    if (stalled > BENCH_STALLED_SAMPLES) break;
+    _bench_trace_record(timestamp, iterations, elapsed);
+    bench_stats_push_batch(stats, elapsed, iterations);
+    bench_histogram_record(histogram, elapsed * BENCH_HISTOGRAM_SCALE / iterations, iterations);
+  }
+  _bench_thread_recording = false;
+
+  _bench_allocs_stop(allocs);
+
+  if (perf_opened) {
+    _bench_perf_stop(&perf, counters);
+    _bench_perf_close(&perf);
+  }
+}
+
+/*!
+ * Warm up, calibrate and then record samples of the given batch runner until
+ * `target_time` has been spent in it.
+ *
+ * @private
+ * @param b bench namespace
+ * @param stats The stats to record samples to.
+ * @param histogram The histogram to record samples to.
+ * @param counters The performance counter totals to add to.
+ * @param allocs The allocation totals to add to.
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ */
+static inline void _bench_sample(
+  bench_t* b,
+  bench_stats_t* stats,
+  bench_histogram_t* histogram,
+  bench_counters_t* counters,
+  bench_allocs_t* allocs,
+  bench_batch_fn run,
+  void* ctx
+) {
+  uint64_t iterations = _bench_sample_prepare(b, run, ctx);
+  _bench_sample_record(b, stats, histogram, counters, allocs, run, ctx, iterations, UINT64_MAX);
+}
+
+/*!
+ * Print the results of a measurement, completing its line of output.
+ *
+ * @private
+ * @param b bench namespace
+ * @param m The measurement to print.
+ */
+static inline void _bench_measurement_print(bench_t* b, bench_measurement_t* m) {
+  if (m->threads > 1) {
+    bench_human_number(b->out, bench_measurement_ops_per_sec(m), false);
+    fprintf(b->out, " i/s (±%.2f%%) (", bench_stats_rme(&m->stats));
+    bench_human_number(b->out, m->stats.mean, true);
+    fprintf(b->out, "/i per thread, %u threads)", m->threads);
+  } else if (m->in_flight > 0) {
+    bench_human_number(b->out, bench_measurement_ops_per_sec(m), false);
+    fprintf(b->out, " i/s (±%.2f%%) (", bench_stats_rme(&m->stats));
+    bench_human_number(b->out, m->stats.mean, true);
+    fprintf(b->out, "/i latency, %u in flight)", m->in_flight);
+  } else if (m->rate > 0) {
+    bench_human_number(b->out, bench_measurement_ops_per_sec(m), false);
+    fprintf(b->out, " i/s (±%.2f%%) (", bench_stats_rme(&m->stats));
+    bench_human_number(b->out, m->stats.mean, true);
+    fprintf(b->out, "/i latency, ");
+    bench_human_number(b->out, m->rate, false);
+    fprintf(b->out, " i/s target)");
+  } else {
+    bench_stats_print(&m->stats, b->out);
+  }
+  if (m->bytes > 0) {
+    fprintf(b->out, " (");
+    bench_human_bytes(b->out, m->bytes * bench_measurement_ops_per_sec(m));
+    fprintf(b->out, "/s)");
+  }
+  if (m->items > 0) {
+    fprintf(b->out, " (");
+    bench_human_number(b->out, m->items * bench_measurement_ops_per_sec(m), false);
+    fprintf(b->out, " items/s)");
+  }
+  if (b->show_cycles && cycles_per_ns > 0) {
+    fprintf(b->out, " (%.2f cycles/i)", m->stats.mean * cycles_per_ns);
+  }
+  if (b->percentiles || m->rate > 0) {
+    fprintf(b->out, " (");
+    bench_histogram_print(&m->histogram, b->out);
+    fprintf(b->out, ")");
+  }
+  if (m->counters.available != 0) {
+    fprintf(b->out, " (");
+    bench_counters_print(&m->counters, m->stats.count, b->out);
+    fprintf(b->out, ")");
+  }
+  if (m->allocs.tracked) {
+    fprintf(b->out, " (");
+    bench_allocs_print(&m->allocs, m->stats.count, b->out);
+    fprintf(b->out, ")");
+  }
+  if (m->repetitions.samples > 1) {
+    fprintf(b->out, " (%llu reps, ±%.2f%% between reps)",
+      (unsigned long long) m->repetitions.samples,
+      bench_stats_stddev(&m->repetitions) / m->repetitions.mean * 100);
+  }
+  if (m->cpus != NULL && m->nodes != NULL) {
+    fprintf(b->out, m->threads > 1 ? " [cpus " : " [cpu ");
+    for (uint32_t i = 0; i < m->threads; i++) {
+      fprintf(b->out, i > 0 ? ",%d" : "%d", m->cpus[i]);
+    }
+    fprintf(b->out, m->threads > 1 ? ", nodes " : ", node ");
+    for (uint32_t i = 0; i < m->threads; i++) {
+      fprintf(b->out, i > 0 ? ",%d" : "%d", m->nodes[i]);
+    }
+    fprintf(b->out, "]");
+  }
+  fprintf(b->out, "\n");
+}
+
+/**
+ * Process isolation.
+ */
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+/*!
+ * Set in child processes, so nothing forks again within them.
+ *
+ * @private
+ */
+static bool _bench_isolated = false;
+
+/*!
+ * The results of a measurement sent back from its child process.
+ *
+ * @private
+ */
+typedef struct bench_isolated_result_s {
+  bench_stats_t stats;
+  bench_stats_t repetitions;
+  bench_histogram_t histogram;
+  bench_counters_t counters;
+  bench_allocs_t allocs;
+  int cpu;
+  int node;
+} bench_isolated_result_t;
+
+/*!
+ * The effects of a group on its top-level suite, sent back from its child
+ * process. Reporter counts follow it.
+ *
+ * @private
+ */
+typedef struct bench_isolated_group_s {
+  size_t regressions;
+  double reference[BENCH_REFERENCE_COUNT];
+  bool header_printed;
+} bench_isolated_group_t;
+
+#ifndef _WIN32
+/*!
+ * Write a whole buffer to a pipe.
+ *
+ * @private
+ */
+static inline bool _bench_write_all(int fd, const void* data, size_t size) {
+  const char* p = (const char*) data;
+  while (size > 0) {
+    ssize_t written = write(fd, p, size);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    p += written;
+    size -= (size_t) written;
+  }
+  return true;
+}
+
+/*!
+ * Read a whole buffer from a pipe.
+ *
+ * @private
+ */
+static inline bool _bench_read_all(int fd, void* data, size_t size) {
+  char* p = (char*) data;
+  while (size > 0) {
+    ssize_t got = read(fd, p, size);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return false;
+    p += got;
+    size -= (size_t) got;
+  }
+  return true;
+}
+
+/*!
+ * Fork a child process with a pipe back to the parent. Forking is only safe
+ * while no other threads run, so it is refused while groups run
+ * concurrently or the trace writer runs, which is warned about once.
+ *
+ * @private
+ * @param b bench namespace
+ * @param fds Where to write the read and write ends of the pipe.
+ * @return The pid of the child in the parent, 0 in the child, or -1 if no
+ *   process could be forked.
+ */
+static inline pid_t _bench_fork(bench_t* b, int* fds) {
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  if (_bench_isolated || root->lock != NULL) return -1;
+  if (root->trace != NULL) {
+    static bool warned = false;
+    if (!warned) {
+      fprintf(stderr, "benc.h: measurements are not isolated while tracing samples\n");
+      warned = true;
+    }
+    return -1;
+  }
+  if (pipe(fds) != 0) return -1;
+
+  // Anything left buffered would be written by both processes
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    _bench_isolated = true;
+    return 0;
+  }
+  close(fds[1]);
+  return pid;
+}
+
+/*!
+ * Leave a child process once its results are sent, flushing only the
+ * output of the suite, so no other stream is written twice.
+ *
+ * @private
+ * @param b bench namespace
+ * @param fd The write end of the pipe to the parent.
+ * @param sent Whether the results were sent in full.
+ */
+static inline void _bench_child_exit(bench_t* b, int fd, bool sent) {
+  close(fd);
+  bench_t* root = b;
+  fflush(b->out);
+  while (root->parent != NULL) {
+    root = root->parent;
+    fflush(root->out);
+  }
+  for (size_t i = 0; i < root->reporters.size; i++) {
+    bench_reporter_t* r = (bench_reporter_t*) root->reporters.entries[i];
+    if (r->out) fflush(r->out);
+  }
+  _exit(sent ? 0 : 1);
+}
+
+/*!
+ * Wait for a child process.
+ *
+ * @private
+ * @param pid The child process.
+ * @param received Whether its results were read in full.
+ * @return 0 if the child succeeded, the signal which killed it, or -1 if it
+ *   failed otherwise.
+ */
+static inline int _bench_wait_child(pid_t pid, bool received) {
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+
+  if (WIFSIGNALED(status)) return WTERMSIG(status);
+  if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+  return 0;
+}
+
+/*!
+ * Print how a child process failed, completing a line of output.
+ *
+ * @private
+ * @param out The output to print to.
+ * @param failure The result of `_bench_wait_child`.
+ */
+static inline void _bench_print_child_failure(FILE* out, int failure) {
+  if (failure > 0) {
+    fprintf(out, "failed in isolated process (signal %d)\n", failure);
+  } else {
+    fprintf(out, "failed in isolated process\n");
+  }
+}
+#endif
+
+/*!
+ * Sample a measurement, repeating it if needed, with its samples traced.
+ *
+ * @private
+ */
+static inline void _bench_measure_samples(bench_t* b, bench_measurement_t* m, bench_batch_fn run, void* ctx) {
+  m->trace = _bench_trace_open(b, m->name);
+  _bench_thread_trace = m->trace;
+
+  if (b->repetitions > 1) {
+    for (uint32_t i = 0; i < b->repetitions; i++) {
+      bench_stats_t repetition;
+      bench_stats_init(&repetition);
+      _bench_sample(b, &repetition, &m->histogram, &m->counters, &m->allocs, run, ctx);
+      bench_stats_merge(&m->stats, &repetition);
+      bench_stats_push(&m->repetitions, (uint64_t) llround(repetition.mean * BENCH_HISTOGRAM_SCALE));
+    }
+  } else {
+    _bench_sample(b, &m->stats, &m->histogram, &m->counters, &m->allocs, run, ctx);
+  }
+
+  _bench_thread_trace = NULL;
+  _bench_trace_close(b, m->trace);
+  m->trace = NULL;
+}
+
+/*!
+ * Sample a measurement in a child process, so it does not share the heap,
+ * caches and page tables warmed by the measurements before it.
+ *
+ * @private
+ * @return 1 when sampled, 0 when it could not be isolated and should be
+ *   sampled in place, or -1 if the child failed.
+ */
+static inline int _bench_measure_isolated(bench_t* b, bench_measurement_t* m, bench_batch_fn run, void* ctx) {
+#ifdef _WIN32
+  (void) b; (void) m; (void) run; (void) ctx;
+  return 0;
+#else
+  bench_isolated_result_t buffer;
+  bench_isolated_result_t* result = &buffer;
+
+  int fds[2];
+  pid_t pid = _bench_fork(b, fds);
+  if (pid < 0) return 0;
+
+  if (pid == 0) {
+    _bench_measure_samples(b, m, run, ctx);
+    result->stats = m->stats;
+    result->repetitions = m->repetitions;
+    result->histogram = m->histogram;
+    result->counters = m->counters;
+    result->allocs = m->allocs;
+    _bench_current_cpu(&result->cpu, &result->node);
+    _bench_child_exit(b, fds[1], _bench_write_all(fds[1], result, sizeof(bench_isolated_result_t)));
+  }
+
+  bool received = _bench_read_all(fds[0], result, sizeof(bench_isolated_result_t));
+  close(fds[0]);
+  int failure = _bench_wait_child(pid, received);
+  if (failure != 0) {
+    _bench_print_child_failure(b->out, failure);
+  } else {
+    m->stats = result->stats;
+    m->repetitions = result->repetitions;
+    m->histogram = result->histogram;
+    m->counters = result->counters;
+    m->allocs = result->allocs;
+    if (m->cpus != NULL && m->nodes != NULL) {
+      m->cpus[0] = result->cpu;
+      m->nodes[0] = result->node;
+    }
+  }
+  return failure == 0 ? 1 : -1;
+#endif
+}
+
+/*!
+ * Run a sub-group in a child process. The child prints and reports as
+ * usual, writing to the same files, then sends back the regressions,
+ * reference results and reporter counts the parent needs to carry on.
+ *
+ * @private
+ * @return Whether the group was run, or false when it could not be isolated
+ *   and should be run in place.
+ */
+static inline bool _bench_group_isolated(bench_t* b, const char* name, bench_group_fn fn, void* ptr) {
+#ifdef _WIN32
+  (void) b; (void) name; (void) fn; (void) ptr;
+  return false;
+#else
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  size_t reporters = root->reporters.size;
+
+  int fds[2];
+  pid_t pid = _bench_fork(b, fds);
+  if (pid < 0) return false;
+
+  if (pid == 0) {
+    bench_t* b2 = _bench_group_create(b, name, ptr, b->out);
+    if (b2 != NULL) {
+      fn(b2);
+      bench_compare(b2);
+    }
+
+    bench_isolated_group_t group;
+    memset(&group, 0, sizeof(group));
+    group.regressions = root->regressions;
+    memcpy(group.reference, root->reference, sizeof(group.reference));
+    group.header_printed = b->header_printed;
+    bool sent = _bench_write_all(fds[1], &group, sizeof(group));
+    for (size_t i = 0; sent && i < reporters; i++) {
+      bench_reporter_t* r = (bench_reporter_t*) root->reporters.entries[i];
+      if (r->out) fflush(r->out);
+      sent = _bench_write_all(fds[1], &r->count, sizeof(size_t));
+    }
+    _bench_child_exit(b, fds[1], sent);
+  }
+
+  bench_isolated_group_t group;
+  bool received = _bench_read_all(fds[0], &group, sizeof(group));
+  if (received) {
+    root->regressions = group.regressions;
+    memcpy(root->reference, group.reference, sizeof(root->reference));
+    if (group.header_printed) {
+      for (bench_t* parent = b; parent != NULL; parent = parent->parent) {
+        parent->header_printed = true;
+      }
+    }
+    for (size_t i = 0; received && i < reporters; i++) {
+      bench_reporter_t* r = (bench_reporter_t*) root->reporters.entries[i];
+      received = _bench_read_all(fds[0], &r->count, sizeof(size_t));
+    }
+  }
+  close(fds[0]);
+
+  // The child may have stopped partway through a line of output
+  int failure = _bench_wait_child(pid, received);
+  if (failure != 0) {
+    fprintf(b->out, "group %s ", name);
+    _bench_print_child_failure(b->out, failure);
+  }
+  return true;
+#endif
+}
+
+/*!
+ * Measure the code run by the given batch runner, as part of a range when
+ * `has_arg` is set.
+ *
+ * @private
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ * @param ctx_free Frees `ctx` once the measurement has run, or NULL.
+ * @param has_arg Whether the measurement is part of a range.
+ * @param arg The argument of the range measurement.
+ * @param overhead The nanoseconds per iteration spent calling the code, to
+ *   subtract along with the timer overhead.
+ * @param chunk The most iterations `run` times per clock read, or 0 when it
+ *   reads the clock once per call.
+ */
+static inline int _bench_measure_batch(
+  bench_t* b,
+  const char* name,
+  bench_batch_fn run,
+  void* ctx,
+  void (*ctx_free)(void* ctx),
+  bool has_arg,
+  uint64_t arg,
+  double overhead,
+  uint64_t chunk
+) {
+  if (_bench_skip(b, name)) {
+    if (ctx_free != NULL) ctx_free(ctx);
+    return 0;
+  }
+
+  // Create a new measurement
+  bench_measurement_t* m = _bench_measurement_create(b, name);
+  if (m == NULL || !bench_array_push(&b->measurements, m)) {
+    if (ctx_free != NULL) ctx_free(ctx);
+    return -1;
+  }
+  m->arg = arg;
+  m->has_arg = has_arg;
+  m->overhead = overhead;
+  m->chunk = chunk;
+  m->bytes = b->bytes * (has_arg ? arg : 1);
+  m->items = b->items * (has_arg ? arg : 1);
+
+  // Leave it to run in rounds with the rest of the group
+  if (b->order != BENCH_ORDER_SEQUENTIAL) {
+    m->run = run;
+    m->ctx = ctx;
+    m->ctx_free = ctx_free;
+    return 0;
+  }
+
+  _bench_clock_init(b, b->clock == BENCH_CLOCK_CYCLES || b->show_cycles);
+
+  _bench_print_header(b);
+  _bench_print_indent(b);
+  fprintf(b->out, "%s - ", name);
+  fflush(b->out);
+
+  bench_affinity_t affinity;
+  if (_bench_pin_thread(b->cpu, &affinity)) {
+    m->cpus = (int*) _bench_alloc(b, sizeof(int));
+    m->nodes = (int*) _bench_alloc(b, sizeof(int));
+  }
+  int isolated = b->isolation == BENCH_ISOLATION_MEASUREMENT ? _bench_measure_isolated(b, m, run, ctx) : 0;
+  if (isolated == 0) {
+    _bench_measure_samples(b, m, run, ctx);
+    if (m->cpus != NULL && m->nodes != NULL) {
+      _bench_current_cpu(m->cpus, m->nodes);
+    }
+  }
+  _bench_unpin_thread(&affinity);
+
+  // A failed child has already explained itself
+  if (isolated < 0) {
+    b->measurements.size--;
+    if (ctx_free != NULL) ctx_free(ctx);
+    return -1;
+  }
+
+  _bench_overhead_subtract(b, m);
+  _bench_measurement_print(b, m);
+  _bench_report(b, m);
+  if (ctx_free != NULL) ctx_free(ctx);
+  return 0;
+}
+
+/*!
+ * Run the measurements of a group deferred by `b->order` in rounds of
+ * `b->round_time` each, until every one of them is done, then print them in
+ * the order they were declared.
+ *
+ * @private
+ * @param b bench namespace
+ */
+static inline void _bench_run_rounds(bench_t* b) {
+  size_t pending = 0;
+  for (size_t i = 0; i < b->measurements.size; i++) {
+    bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[i];
+    if (m->run != NULL) pending++;
+  }
+  if (pending == 0) return;
+
+  bench_measurement_t** active = (bench_measurement_t**) _bench_alloc(b, pending * sizeof(bench_measurement_t*));
+  if (active == NULL) return;
+  size_t remaining = 0;
+  for (size_t i = 0; i < b->measurements.size; i++) {
+    bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[i];
+    if (m->run != NULL) active[remaining++] = m;
+  }
+
+  _bench_clock_init(b, b->clock == BENCH_CLOCK_CYCLES || b->show_cycles);
+
+  bench_affinity_t affinity;
+  bool pinned = _bench_pin_thread(b->cpu, &affinity);
+
+  // Calibrate everything up front, so rounds only record samples
+  for (size_t i = 0; i < remaining; i++) {
+    active[i]->iterations = _bench_sample_prepare(b, active[i]->run, active[i]->ctx);
+    active[i]->trace = _bench_trace_open(b, active[i]->name);
+  }
+
+  uint64_t seed = bench_now() | 1;
+  uint64_t round_time = b->round_time > 0 ? b->round_time : 1;
+  while (remaining > 0) {
+    if (b->order == BENCH_ORDER_RANDOM) {
+      for (size_t i = remaining - 1; i > 0; i--) {
+        // xorshift64, so the order does not depend on or disturb rand()
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        size_t j = (size_t) (seed % (i + 1));
+        bench_measurement_t* swap = active[i];
+        active[i] = active[j];
+        active[j] = swap;
+      }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < remaining; i++) {
+      bench_measurement_t* m = active[i];
+      _bench_thread_trace = m->trace;
+      _bench_sample_record(
+        b, &m->stats, &m->histogram, &m->counters, &m->allocs, m->run, m->ctx, m->iterations, round_time
+      );
+      _bench_thread_trace = NULL;
+      if (!_bench_sample_done(b, &m->stats)) {
+        active[kept++] = m;
+      } else {
+        _bench_trace_close(b, m->trace);
+        m->trace = NULL;
+      }
+    }
+    remaining = kept;
+  }
+
+  int cpu = -1;
+  int node = -1;
+  if (pinned) {
+    _bench_current_cpu(&cpu, &node);
+  }
+  _bench_unpin_thread(&affinity);
+
+  for (size_t i = 0; i < b->measurements.size; i++) {
+    bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[i];
+    if (m->run == NULL) continue;
+
+    if (pinned) {
+      m->cpus = (int*) _bench_alloc(b, sizeof(int));
+      m->nodes = (int*) _bench_alloc(b, sizeof(int));
+      if (m->cpus != NULL && m->nodes != NULL) {
+        m->cpus[0] = cpu;
+        m->nodes[0] = node;
+      }
+    }
+
+    _bench_print_header(b);
+    _bench_print_indent(b);
+    fprintf(b->out, "%s - ", m->name);
+    _bench_overhead_subtract(b, m);
+    _bench_measurement_print(b, m);
+    _bench_report(b, m);
+
+    if (m->ctx_free != NULL) m->ctx_free(m->ctx);
+    m->run = NULL;
+    m->ctx = NULL;
+    m->ctx_free = NULL;
+  }
+}
+
+/**
+ * Measure performance of the code run by the given batch runner. This is what
+ * `bench_measure` builds on, and lets the timing loop be specialized for the
+ * code it calls, so that code can be inlined into the loop.
+ *
+ * ```c
+ * bench_measure_batch(b, "inlined", run_inlined, NULL);
+ * ```
+ *
+ * Set `b->batch_time` to time batches of calls instead of each call on its
+ * own, which keeps clock overhead out of very fast functions:
+ *
+ * ```c
+ * b->batch_time = 10 * MICROS;
+ * ```
+ *
+ * For the finest resolution, read the cycle counter instead of the OS clock
+ * and optionally report cycles per iteration too:
+ *
+ * ```c
+ * b->clock = BENCH_CLOCK_CYCLES;
+ * b->show_cycles = true;
+ * ```
+ *
+ * To keep cold caches and frequency ramp-up out of the results, warm up
+ * before recording, optionally until samples settle:
+ *
+ * ```c
+ * b->warmup_time = 100 * MILLIS;
+ * b->steady_state = 0.05;
+ * ```
+ *
+ * Rather than always sampling for `target_time`, a measurement can stop as
+ * soon as its margin of error is small enough, so stable code finishes early
+ * and noisy code gets more time, up to `max_time`:
+ *
+ * ```c
+ * b->target_rme = 1.0;
+ * b->min_time = 50 * MILLIS;
+ * b->max_time = 5 * SECONDS;
+ * ```
+ *
+ * Every measurement keeps a histogram of its per-iteration times. Set
+ * `b->percentiles` to print p50/p90/p99/p99.9 and max with the results.
+ *
+ * Set `b->cpu` to pin the measuring thread to a CPU for the duration of the
+ * measurement. The CPU and NUMA node it ran on are printed with the results.
+ *
+ * On Linux, set `b->counters` to also report instructions per cycle and
+ * hardware counters per iteration. Where counters can not be opened, they
+ * are silently left out.
+ *
+ * When built with `BENCH_TRACK_ALLOCATIONS`, set `b->allocations` to also
+ * report heap allocations and bytes per iteration, and peak live bytes.
+ *
+ * Set `b->repetitions` to repeat the whole measurement, warmup included,
+ * and report how much the repetitions disagree.
+ *
+ * Set `b->bytes` or `b->items` to the amount of data each call processes to
+ * also report throughput, in bytes or items per second.
+ *
+ * To compare measurements head to head, set `b->order` to run the
+ * measurements of a group in interleaved rounds of `b->round_time` rather
+ * than one after another. The measurements are deferred until the group is
+ * compared, so `ctx` must stay valid until then:
+ *
+ * ```c
+ * b->order = BENCH_ORDER_RANDOM;
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`
+ */
+static inline int bench_measure_batch(bench_t* b, const char* name, bench_batch_fn run, void* ctx) {
+  return _bench_measure_batch(b, name, run, ctx, NULL, false, 0, 0, 0);
+}
+
+/**
+ * Measure performance of the given function.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_measure(b, "fast", bench_fast);
+ * bench_measure(b, "slow", bench_slow);
+ * bench_compare(b);
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ * fast - 26.92m i/s (±49.87%) (34.11ns/i)
+ * slow - 3.53m i/s (±165.47%) (278.89ns/i)
+ * ```
+ *
+ * See `bench_measure_batch` for the options which apply to measurements.
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param fn Measurement function
+ * @param data Optional pointer passed to `fn`
+ */
+static inline int bench_measure(bench_t* b, const char* name, bench_measure_fn fn, void* data, ...) {
+  // Allocated, as the measurement may be deferred to run in rounds
+  bench_fn_data_t* ctx = (bench_fn_data_t*) _bench_alloc(b, sizeof(bench_fn_data_t));
+  if (ctx == NULL) return -1;
+  ctx->fn = fn;
+  ctx->data = data;
+  double overhead = b->subtract_overhead ? _bench_overhead_calibrate(b, b->clock)->call : 0;
+  return _bench_measure_batch(b, name, _bench_fn_batch, ctx, NULL, false, 0, overhead, 0);
+}
+
+// Hack to make ptr optional
+#define bench_measure(b, name, fn, ...) \
+  bench_measure(b, name, fn, ##__VA_ARGS__, NULL)
+
+/**
+ * Setup function signature, called untimed before each iteration.
+ *
+ * @param data Optional pointer passed through from `bench_measure_fixture`
+ * @return The state to pass to the measurement and teardown functions.
+ */
+typedef void* (*bench_setup_fn)(void* data);
+
+/**
+ * Teardown function signature, called untimed after each iteration.
+ *
+ * @param data Optional pointer passed through from `bench_measure_fixture`
+ * @param state The state returned by the setup function.
+ */
+typedef void (*bench_teardown_fn)(void* data, void* state);
+
+/*!
+ * The functions of a fixture measurement, and room for the states of up to
+ * `BENCH_FIXTURE_BATCH` iterations.
+ *
+ * @private
+ */
+typedef struct bench_fixture_s {
+  bench_setup_fn setup;
+  bench_measure_fn fn;
+  bench_teardown_fn teardown;
+  void* data;
+  void* states[BENCH_FIXTURE_BATCH];
+} bench_fixture_t;
+
+/*!
+ * Batch runner which sets up the state for every iteration of a chunk of
+ * the batch up front, times the iterations of the chunk together, then
+ * tears the states down.
+ *
+ * @private
+ * @param ctx The bench_fixture_t to run.
+ * @param clock The clock source.
+ * @param iterations The number of calls to make.
+ * @return The time taken by the calls in nanoseconds.
+ */
+static inline uint64_t _bench_fixture_batch(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_fixture_t* fixture = (bench_fixture_t*) ctx;
+  void** states = fixture->states;
+  bench_measure_fn fn = fixture->fn;
+  uint64_t elapsed = 0;
+
+  for (uint64_t done = 0; done < iterations;) {
+    uint64_t count = iterations - done < BENCH_FIXTURE_BATCH ? iterations - done : BENCH_FIXTURE_BATCH;
+
+    // Allocations of setup and teardown are left out, like their time
+    bool tracked = _bench_allocs_pause();
+    for (uint64_t i = 0; i < count; i++) {
+      states[i] = fixture->setup ? fixture->setup(fixture->data) : fixture->data;
+    }
+    _bench_allocs_resume(tracked);
+
+    uint64_t start = bench_clock_start(clock);
+    for (uint64_t i = 0; i < count; i++) {
+      fn(states[i]);
+    }
+    uint64_t end = bench_clock_stop(clock);
+    elapsed += bench_clock_elapsed(clock, end - start);
+
+    tracked = _bench_allocs_pause();
+    if (fixture->teardown) {
+      for (uint64_t i = 0; i < count; i++) {
+        fixture->teardown(fixture->data, states[i]);
+      }
+    }
+    _bench_allocs_resume(tracked);
+    done += count;
+  }
+
+  return elapsed;
+}
+
+/**
+ * Measure performance of the given function with per-iteration setup and
+ * teardown, which are left out of the timing. In batched mode, the states
+ * of up to `BENCH_FIXTURE_BATCH` iterations are set up before they are timed
+ * together, so no extra clock reads are needed per iteration.
+ *
+ * ```c
+ * void* setup_sort(void* data) {
+ *   return shuffled_copy((int*) data);
+ * }
+ *
+ * void teardown_sort(void* data, void* state) {
+ *   free(state);
+ * }
+ *
+ * bench_measure_fixture(b, "sort", setup_sort, bench_sort, teardown_sort, input);
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param setup Setup function, or NULL to pass `data` through
+ * @param fn Measurement function, given the state returned by `setup`
+ * @param teardown Teardown function, or NULL
+ * @param data Optional pointer passed to `setup` and `teardown`
+ */
+static inline int bench_measure_fixture(
+  bench_t* b,
+  const char* name,
+  bench_setup_fn setup,
+  bench_measure_fn fn,
+  bench_teardown_fn teardown,
+  void* data,
+  ...
+) {
+  // Checked first, so filtered out fixtures do not take room for states
+  if (_bench_skip(b, name)) return 0;
+
+  bench_fixture_t* fixture = (bench_fixture_t*) _bench_alloc(b, sizeof(bench_fixture_t));
+  if (fixture == NULL) {
+    _bench_print_header(b);
+    _bench_print_indent(b);
+    fprintf(b->out, "%s - failed to allocate fixture states\n", name);
+    return -1;
+  }
+  fixture->setup = setup;
+  fixture->fn = fn;
+  fixture->teardown = teardown;
+  fixture->data = data;
+
+  // Each timed iteration calls through a function pointer, like bench_measure
+  double overhead = b->subtract_overhead ? _bench_overhead_calibrate(b, b->clock)->call : 0;
+  return _bench_measure_batch(b, name, _bench_fixture_batch, fixture, NULL, false, 0, overhead, BENCH_FIXTURE_BATCH);
+}
+
+// Hack to make ptr optional
+#define bench_measure_fixture(b, name, setup, fn, teardown, ...) \
+  bench_measure_fixture(b, name, setup, fn, teardown, ##__VA_ARGS__, NULL)
+
+/**
+ * Range measure function signature
+ *
+ * @param data Optional pointer passed through from `bench_measure_range`
+ * @param arg The argument of the current measurement, such as an input size
+ */
+typedef void (*bench_range_fn)(void* data, uint64_t arg);
+
+/*!
+ * A range measure function with its data and current argument.
+ *
+ * @private
+ */
+typedef struct bench_range_s {
+  bench_range_fn fn;
+  void* data;
+  const uint64_t* args;
+  size_t args_size;
+  uint64_t start;
+  uint64_t end;
+  uint64_t multiplier;
+  uint64_t arg;
+} bench_range_t;
+
+/*!
+ * Batch runner calling a range measure function with the current argument.
+ *
+ * @private
+ * @param ctx The bench_range_t to call.
+ * @param clock The clock source.
+ * @param iterations The number of calls to make.
+ * @return The time taken by the calls in nanoseconds.
+ */
+static inline uint64_t _bench_range_batch(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_range_t* range = (bench_range_t*) ctx;
+  bench_range_fn fn = range->fn;
+  void* data = range->data;
+  uint64_t arg = range->arg;
+
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    fn(data, arg);
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * Measure a range function with a single argument, named after it.
+ *
+ * @private
+ * @param b bench namespace of the range
+ * @param range The range to measure.
+ * @param arg The argument to measure with.
+ */
+static inline void _bench_range_measure(bench_t* b, bench_range_t* range, uint64_t arg) {
+  char name[32];
+  snprintf(name, sizeof(name), "%llu", (unsigned long long) arg);
+
+  // Each argument gets its own copy, as it may be deferred to run in rounds
+  bench_range_t* copy = (bench_range_t*) _bench_alloc(b, sizeof(bench_range_t));
+  if (copy == NULL) return;
+  *copy = *range;
+  copy->arg = arg;
+  double overhead = b->subtract_overhead ? _bench_overhead_calibrate(b, b->clock)->call : 0;
+  _bench_measure_batch(b, name, _bench_range_batch, copy, NULL, true, arg, overhead, 0);
+}
+
+/*!
+ * Group function measuring each argument of a range.
+ *
+ * @private
+ * @param b bench namespace of the range
+ */
+static inline void _bench_range(bench_t* b) {
+  bench_range_t* range = (bench_range_t*) b->data;
+
+  if (range->args != NULL) {
+    for (size_t i = 0; i < range->args_size; i++) {
+      _bench_range_measure(b, range, range->args[i]);
+    }
+    return;
+  }
+
+  uint64_t arg = range->start;
+  for (;;) {
+    _bench_range_measure(b, range, arg);
+    if (arg >= range->end) break;
+
+    // Always finish on the end of the range, even if it is not a step
+    if (arg > range->end / range->multiplier) {
+      arg = range->end;
+    } else {
+      arg = arg * range->multiplier > arg ? arg * range->multiplier : arg + 1;
+    }
+  }
+}
+
+/**
+ * Measure the given function over a geometric range of arguments, from
+ * `start` to `end` in steps of `multiplier`, in a sub-group named `name`.
+ *
+ * Set `b->bytes` or `b->items` to report throughput, with the argument
+ * counting units of that size, and `b->complexity` to fit the results to
+ * O(1), O(log n), O(n) or O(n log n) when they are compared.
+ *
+ * ```c
+ * void bench_memset(void* data, uint64_t size) {
+ *   memset(data, 0, size);
+ * }
+ *
+ * b->bytes = 1;
+ * b->complexity = true;
+ * bench_measure_range(b, "memset", bench_memset, 64, 64 << 20, 8, buffer);
+ * ```
+ *
+ * ```
+ *   # memset
+ *   64 - 35.46m i/s (±0.41%) (28.20ns/i) (2.11GiB/s)
+ *   512 - 14.30m i/s (±0.37%) (69.93ns/i) (6.82GiB/s)
+ *   ...
+ *   Comparing...
+ *     - 64 (fastest)
+ *     - 512 (147.97% slower)
+ *   ...
+ *   Complexity: O(n) (0.09ns * n, rms 4.12%)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Sub-group name
+ * @param fn Measurement function, given each argument in turn
+ * @param start The first argument
+ * @param end The last argument
+ * @param multiplier The ratio between consecutive arguments
+ * @param data Optional pointer passed to `fn`
+ */
+static inline void bench_measure_range(
+  bench_t* b,
+  const char* name,
+  bench_range_fn fn,
+  uint64_t start,
+  uint64_t end,
+  uint64_t multiplier,
+  void* data,
+  ...
+) {
+  bench_range_t range = { fn, data, NULL, 0, start, end, multiplier > 1 ? multiplier : 2, 0 };
+  _bench_group_run(b, name, _bench_range, &range, NULL);
+}
+
+// Hack to make ptr optional
+#define bench_measure_range(b, name, fn, start, end, multiplier, ...) \
+  bench_measure_range(b, name, fn, start, end, multiplier, ##__VA_ARGS__, NULL)
+
+/**
+ * Measure the given function with each of a list of arguments, in a
+ * sub-group named `name`. See `bench_measure_range` for reporting
+ * throughput and complexity.
+ *
+ * ```c
+ * static const uint64_t sizes[] = { 1000, 10000, 100000 };
+ * bench_measure_args(b, "sort", bench_sort, sizes, 3, input);
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Sub-group name
+ * @param fn Measurement function, given each argument in turn
+ * @param args The arguments to measure with
+ * @param args_size The number of arguments
+ * @param data Optional pointer passed to `fn`
+ */
+static inline void bench_measure_args(
+  bench_t* b,
+  const char* name,
+  bench_range_fn fn,
+  const uint64_t* args,
+  size_t args_size,
+  void* data,
+  ...
+) {
+  bench_range_t range = { fn, data, args, args_size, 0, 0, 0, 0 };
+  _bench_group_run(b, name, _bench_range, &range, NULL);
+}
+
+// Hack to make ptr optional
+#define bench_measure_args(b, name, fn, args, args_size, ...) \
+  bench_measure_args(b, name, fn, args, args_size, ##__VA_ARGS__, NULL)
+
+/*!
+ * State of one thread of a parallel measurement. Each worker is allocated on
+ * its own so threads never write to shared cache lines while sampling.
+ *
+ * @private
+ * @property b bench namespace
+ * @property run Batch runner
+ * @property ctx Pointer passed to `run`
+ * @property barrier The barrier releasing all workers at once.
+ * @property ready The barrier releasing all workers to record samples, once
+ *   each has warmed up and calibrated.
+ * @property stats The stats recorded by this thread.
+ * @property histogram The histogram recorded by this thread.
+ * @property counters The performance counters recorded by this thread.
+ * @property cpu The CPU to pin this thread to, or -1.
+ * @property ran_cpu The CPU this thread ran on.
+ * @property ran_node The NUMA node this thread ran on.
+ */
+typedef struct bench_worker_s {
+  bench_t* b;
+  bench_batch_fn run;
+  void* ctx;
+  bench_barrier_t* barrier;
+  bench_barrier_t* ready;
+  bench_stats_t stats;
+  bench_histogram_t histogram;
+  bench_counters_t counters;
+  bench_allocs_t allocs;
+  int cpu;
+  int ran_cpu;
+  int ran_node;
+} bench_worker_t;
+
+/*!
+ * Run one thread of a parallel measurement.
+ *
+ * @private
+ * @param arg The bench_worker_t of the thread.
+ */
+static inline void _bench_worker_run(void* arg) {
+  bench_worker_t* w = (bench_worker_t*) arg;
+  bench_affinity_t affinity;
+  _bench_pin_thread(w->cpu, &affinity);
+
+  _bench_barrier_wait(w->barrier);
+  uint64_t iterations = _bench_sample_prepare(w->b, w->run, w->ctx);
+  _bench_barrier_wait(w->ready);
+  _bench_sample_record(w->b, &w->stats, &w->histogram, &w->counters, &w->allocs, w->run, w->ctx, iterations, UINT64_MAX);
+
+  _bench_current_cpu(&w->ran_cpu, &w->ran_node);
+}
+
+/*!
+ * Measure throughput of the code run by the given batch runner, called
+ * concurrently from several threads.
+ *
+ * @private
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param run Batch runner, called from every thread
+ * @param ctx Pointer passed to `run`
+ * @param threads The number of threads to run
+ * @param overhead The nanoseconds per iteration spent calling the code.
+ * @return 0 on success, -1 if the threads could not be started.
+ */
+static inline int _bench_measure_parallel_batch(
+  bench_t* b,
+  const char* name,
+  bench_batch_fn run,
+  void* ctx,
+  uint32_t threads,
+  double overhead
+) {
+  if (_bench_skip(b, name)) return 0;
+
+  _bench_clock_init(b, b->clock == BENCH_CLOCK_CYCLES || b->show_cycles);
+  if (threads == 0) threads = 1;
+
+  _bench_print_header(b);
+  _bench_print_indent(b);
+  fprintf(b->out, "%s - ", name);
+  fflush(b->out);
+
+  bench_worker_t** workers = (bench_worker_t**) _bench_alloc(b, threads * sizeof(bench_worker_t*));
+  bench_thread_t* handles = (bench_thread_t*) _bench_alloc(b, threads * sizeof(bench_thread_t));
+  int* placement = (int*) _bench_alloc(b, threads * sizeof(int));
+  if (workers == NULL || handles == NULL || placement == NULL) {
+    fprintf(b->out, "failed to allocate threads\n");
+    return -1;
+  }
+
+  // The calling thread joins the barriers so it can time the whole run,
+  // leaving out warmup and calibration
+  bench_barrier_t barrier;
+  bench_barrier_t ready;
+  _bench_barrier_init(&barrier, threads + 1);
+  _bench_barrier_init(&ready, threads + 1);
+
+  bool pinned = _bench_placement(b, placement, threads);
+
+  uint32_t started = 0;
+  for (; started < threads; started++) {
+    // Padded, so workers do not share the cache lines their results are in
+    bench_worker_t* w = (bench_worker_t*) _bench_alloc(b, sizeof(bench_worker_t) + BENCH_CACHE_LINE);
+    if (w == NULL) break;
+    w->b = b;
+    w->run = run;
+    w->ctx = ctx;
+    w->barrier = &barrier;
+    w->ready = &ready;
+    w->cpu = pinned ? placement[started] : -1;
+    bench_stats_init(&w->stats);
+    bench_histogram_init(&w->histogram);
+    bench_counters_init(&w->counters);
+    bench_allocs_init(&w->allocs);
+    workers[started] = w;
+    if (!_bench_thread_create(&handles[started], _bench_worker_run, w)) break;
+  }
+
+  // Release any threads already waiting, then give up if some were missing
+  if (started < threads) {
+    barrier.count = started + 1;
+    ready.count = started + 1;
+  }
+  _bench_barrier_wait(&barrier);
+  _bench_barrier_wait(&ready);
+  uint64_t start = bench_now();
+
+  for (uint32_t i = 0; i < started; i++) {
+    _bench_thread_join(handles[i]);
+  }
+  uint64_t wall = bench_now() - start;
+  _bench_barrier_destroy(&barrier);
+  _bench_barrier_destroy(&ready);
+
+  int result = 0;
+  bench_measurement_t* m = started == threads ? _bench_measurement_create(b, name) : NULL;
+  if (started < threads) {
+    fprintf(b->out, "failed to start %u threads\n", threads);
+    result = -1;
+  } else if (m == NULL) {
+    fprintf(b->out, "failed to allocate\n");
+    result = -1;
+  } else {
+    m->threads = threads;
+    m->wall = wall;
+    m->overhead = overhead;
+    m->bytes = b->bytes;
+    m->items = b->items;
+    if (pinned) {
+      m->cpus = (int*) _bench_alloc(b, threads * sizeof(int));
+      m->nodes = (int*) _bench_alloc(b, threads * sizeof(int));
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+      bench_stats_merge(&m->stats, &workers[i]->stats);
+      bench_histogram_merge(&m->histogram, &workers[i]->histogram);
+      bench_counters_merge(&m->counters, &workers[i]->counters);
+      bench_allocs_merge(&m->allocs, &workers[i]->allocs);
+      if (m->cpus != NULL && m->nodes != NULL) {
+        m->cpus[i] = workers[i]->ran_cpu;
+        m->nodes[i] = workers[i]->ran_node;
+      }
+    }
+    bench_array_push(&b->measurements, m);
+    _bench_overhead_subtract(b, m);
+    _bench_measurement_print(b, m);
+    _bench_report(b, m);
+  }
+  return result;
+}
+
+/**
+ * Measure throughput of the code run by the given batch runner, called
+ * concurrently from several threads. See `bench_measure_parallel`.
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param run Batch runner, called from every thread
+ * @param ctx Pointer passed to `run`
+ * @param threads The number of threads to run
+ * @return 0 on success, -1 if the threads could not be started.
+ */
+static inline int bench_measure_parallel_batch(
+  bench_t* b,
+  const char* name,
+  bench_batch_fn run,
+  void* ctx,
+  uint32_t threads
+) {
+  return _bench_measure_parallel_batch(b, name, run, ctx, threads, 0);
+}
+
+/**
+ * Measure throughput of the given function called concurrently from several
+ * threads. Threads are released together and each records its own stats,
+ * which are merged once all have finished. Set `b->placement` to pin each
+ * thread to its own CPU.
+ *
+ * ```c
+ * bench_measure_parallel(b, "queue push", bench_push, 8, queue);
+ * ```
+ *
+ * ```
+ * queue push - 41.72m i/s (±0.61%) (191.75ns/i per thread, 8 threads)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param fn Measurement function, called from every thread
+ * @param threads The number of threads to run
+ * @param data Optional pointer passed to `fn`
+ * @return 0 on success, -1 if the threads could not be started.
+ */
+static inline int bench_measure_parallel(
+  bench_t* b,
+  const char* name,
+  bench_measure_fn fn,
+  uint32_t threads,
+  void* data,
+  ...
+) {
+  double overhead = b->subtract_overhead ? _bench_overhead_calibrate(b, b->clock)->call : 0;
+  bench_fn_data_t ctx = { fn, data };
+  return _bench_measure_parallel_batch(b, name, _bench_fn_batch, &ctx, threads, overhead);
+}
+
+// Hack to make ptr optional
+#define bench_measure_parallel(b, name, fn, threads, ...) \
+  bench_measure_parallel(b, name, fn, threads, ##__VA_ARGS__, NULL)
+
+/*!
+ * Arguments of a parallel scaling sweep.
+ *
+ * @private
+ */
+typedef struct bench_sweep_s {
+  bench_measure_fn fn;
+  uint32_t max_threads;
+  void* data;
+} bench_sweep_t;
+
+/*!
+ * Group function measuring each thread count of a scaling sweep.
+ *
+ * @private
+ * @param b bench namespace of the sweep
+ */
+static inline void _bench_parallel_sweep(bench_t* b) {
+  bench_sweep_t* sweep = (bench_sweep_t*) b->data;
+  char name[32];
+
+  for (uint32_t threads = 1; ; threads *= 2) {
+    if (threads > sweep->max_threads) threads = sweep->max_threads;
+    snprintf(name, sizeof(name), "%u thread%s", threads, threads == 1 ? "" : "s");
+    bench_measure_parallel(b, name, sweep->fn, threads, sweep->data);
+    if (threads == sweep->max_threads) break;
+  }
+}
+
+/**
+ * Measure how throughput of the given function scales with thread count, in
+ * a sub-group running 1, 2, 4, ... threads up to `max_threads`.
+ *
+ * ```c
+ * bench_measure_parallel_sweep(b, "refcount", bench_refcount, 8);
+ * ```
+ *
+ * ```
+ *   # refcount
+ *   1 thread - 96.31m i/s (±0.12%) (10.38ns/i)
+ *   2 threads - 31.17m i/s (±1.02%) (64.16ns/i per thread, 2 threads)
+ *   ...
+ *   Comparing...
+ *     - 1 thread (fastest)
+ *     - 2 threads (208.98% slower)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Sub-group name
+ * @param fn Measurement function, called from every thread
+ * @param max_threads The largest number of threads to run
+ * @param data Optional pointer passed to `fn`
+ */
+static inline void bench_measure_parallel_sweep(
+  bench_t* b,
+  const char* name,
+  bench_measure_fn fn,
+  uint32_t max_threads,
+  void* data,
+  ...
+) {
+  bench_sweep_t sweep = { fn, max_threads > 0 ? max_threads : 1, data };
+  _bench_group_run(b, name, _bench_parallel_sweep, &sweep, NULL);
+}
+
+// Hack to make ptr optional
+#define bench_measure_parallel_sweep(b, name, fn, max_threads, ...) \
+  bench_measure_parallel_sweep(b, name, fn, max_threads, ##__VA_ARGS__, NULL)
+
+/**
+ * An asynchronous operation started by `bench_measure_async`, which calls
+ * `bench_async_done` once the operation completes.
+ *
+ * @property data The pointer given to `bench_measure_async`
+ * @property state A free slot for the state of the operation, NULL until
+ *   `fn` sets it, and kept as the slot is reused by the next operations
+ * @property start The monotonic time the operation was started at
+ * @property end The monotonic time the operation completed at
+ * @property done Set by `bench_async_done`
+ * @property active Whether the operation is in flight
+ */
+typedef struct bench_async_s {
+  void* data;
+  void* state;
+  uint64_t start;
+  uint64_t end;
+  uint64_t done;
+  bool active;
+} bench_async_t;
+
+/**
+ * Asynchronous measure function signature, which starts an operation and
+ * returns. The operation must call `bench_async_done` once it completes,
+ * from any thread.
+ *
+ * @param op The operation to start
+ */
+typedef void (*bench_async_fn)(bench_async_t* op);
+
+/**
+ * Poll function signature, which drives the event loop operations complete
+ * on, such as a call to `uv_run(loop, UV_RUN_NOWAIT)`.
+ *
+ * @param data The pointer given to `bench_measure_async`
+ */
+typedef void (*bench_poll_fn)(void* data);
+
+/**
+ * Signal that an asynchronous operation has completed. Can be called from
+ * any thread, including from within the function which started it.
+ *
+ * @param op The operation which completed
+ */
+static inline void bench_async_done(bench_async_t* op) {
+  op->end = bench_now();
+  _bench_atomic_store(&op->done, 1);
+}
+
+/*!
+ * Start an asynchronous operation.
+ *
+ * @private
+ */
+static inline void _bench_async_start(bench_async_t* op, bench_async_fn fn) {
+  op->done = 0;
+  op->active = true;
+  op->start = bench_now();
+  fn(op);
+}
+
+/*!
+ * Keep operations in flight for the given duration, then wait for the last
+ * ones to complete.
+ *
+ * @private
+ * @param ops The operations, one per slot in flight.
+ * @param in_flight The number of operations.
+ * @param fn Starts an operation.
+ * @param poll Drives the event loop, or NULL.
+ * @param data The pointer passed to `poll`.
+ * @param duration How long to keep starting operations, in nanoseconds.
+ * @param stats Where to record the latency of each operation, or NULL.
+ * @param histogram Where to record the latency of each operation, or NULL.
+ * @return The wall-clock time from the first start to the last completion.
+ */
+static inline uint64_t _bench_async_run(
+  bench_async_t* ops,
+  uint32_t in_flight,
+  bench_async_fn fn,
+  bench_poll_fn poll,
+  void* data,
+  uint64_t duration,
+  bench_stats_t* stats,
+  bench_histogram_t* histogram
+) {
+  uint64_t begin = bench_now();
+  uint64_t deadline = begin + duration;
+  uint32_t active = in_flight;
+  for (uint32_t i = 0; i < in_flight; i++) {
+    _bench_async_start(&ops[i], fn);
+  }
+
+  uint64_t last = begin;
+  while (active > 0) {
+    if (poll != NULL) poll(data);
+    for (uint32_t i = 0; i < in_flight; i++) {
+      bench_async_t* op = &ops[i];
+      if (!op->active || _bench_atomic_load(&op->done) == 0) continue;
+
+      uint64_t latency = op->end > op->start ? op->end - op->start : 0;
+      if (stats != NULL) bench_stats_push(stats, latency);
+      if (histogram != NULL) bench_histogram_record(histogram, latency * BENCH_HISTOGRAM_SCALE, 1);
+      if (op->end > last) last = op->end;
+
+      // Each completion makes room for the next operation
+      if (bench_now() < deadline) {
+        _bench_async_start(op, fn);
+      } else {
+        op->active = false;
+        active--;
+      }
+    }
+  }
+  return last - begin;
+}
+
+/**
+ * Measure latency and throughput of asynchronous operations, such as ones
+ * completing on an event loop, with a number of them in flight at once. The
+ * framework starts operations with `fn` and each one calls
+ * `bench_async_done` when it completes. Whenever one completes, the next one
+ * is started, until `target_time` has passed.
+ *
+ * Between checks for completed operations, `poll` is called to drive the
+ * event loop. Without it, operations must complete on other threads while
+ * the framework spins.
+ *
+ * The latency of each operation, from start to completion, is recorded as a
+ * sample, and the throughput is the number of operations completed over the
+ * wall-clock time. Operations are timed with the monotonic clock.
+ *
+ * ```c
+ * void on_timer(uv_timer_t* timer) {
+ *   bench_async_done((bench_async_t*) timer->data);
+ * }
+ *
+ * void start_timer(bench_async_t* op) {
+ *   // Each slot sets up its timer the first time it is started
+ *   if (op->state == NULL) {
+ *     op->state = malloc(sizeof(uv_timer_t));
+ *     uv_timer_init((uv_loop_t*) op->data, (uv_timer_t*) op->state);
+ *   }
+ *   uv_timer_t* timer = (uv_timer_t*) op->state;
+ *   timer->data = op;
+ *   uv_timer_start(timer, on_timer, 0, 0);
+ * }
+ *
+ * void poll_loop(void* data) {
+ *   uv_run((uv_loop_t*) data, UV_RUN_NOWAIT);
+ * }
+ *
+ * bench_measure_async(b, "timer", start_timer, poll_loop, 16, uv_default_loop());
+ * ```
+ *
+ * ```
+ * timer - 412.32k i/s (±0.81%) (38.80us/i latency, 16 in flight)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param fn Starts an operation
+ * @param poll Drives the event loop, or NULL
+ * @param in_flight The number of operations to keep in flight
+ * @param data Optional pointer given to each operation as `op->data` and
+ *   passed to `poll`
+ * @return 0 on success, or -1 if the operations could not be allocated.
+ */
+static inline int bench_measure_async(
+  bench_t* b,
+  const char* name,
+  bench_async_fn fn,
+  bench_poll_fn poll,
+  uint32_t in_flight,
+  void* data,
+  ...
+) {
+  if (_bench_skip(b, name)) return 0;
+  if (in_flight == 0) in_flight = 1;
+
+  _bench_print_header(b);
+  _bench_print_indent(b);
+  fprintf(b->out, "%s - ", name);
+  fflush(b->out);
+
+  bench_async_t* ops = (bench_async_t*) _bench_alloc(b, in_flight * sizeof(bench_async_t));
+  bench_measurement_t* m = ops != NULL ? _bench_measurement_create(b, name) : NULL;
+  if (m == NULL || !bench_array_push(&b->measurements, m)) {
+    fprintf(b->out, "failed to allocate\n");
+    return -1;
+  }
+  for (uint32_t i = 0; i < in_flight; i++) {
+    ops[i].data = data;
+  }
+
+  _bench_clock_init(b, false);
+  bench_affinity_t affinity;
+  if (_bench_pin_thread(b->cpu, &affinity)) {
+    m->cpus = (int*) _bench_alloc(b, sizeof(int));
+    m->nodes = (int*) _bench_alloc(b, sizeof(int));
+  }
+
+  if (b->warmup_time > 0) {
+    _bench_async_run(ops, in_flight, fn, poll, data, b->warmup_time, NULL, NULL);
+  }
+  m->in_flight = in_flight;
+  m->bytes = b->bytes;
+  m->items = b->items;
+  m->wall = _bench_async_run(ops, in_flight, fn, poll, data, b->target_time, &m->stats, &m->histogram);
+
+  if (m->cpus != NULL && m->nodes != NULL) {
+    _bench_current_cpu(m->cpus, m->nodes);
+  }
+  _bench_unpin_thread(&affinity);
+
+  _bench_measurement_print(b, m);
+  _bench_report(b, m);
+  return 0;
+}
+
+// Hack to make ptr optional
+#define bench_measure_async(b, name, fn, poll, in_flight, ...) \
+  bench_measure_async(b, name, fn, poll, in_flight, ##__VA_ARGS__, NULL)
+
+/**
+ * Open-loop load.
+ */
+
+/*!
+ * Find the time until the next call of an open-loop measurement.
+ *
+ * @private
+ * @param arrival The arrival process.
+ * @param interval The mean interval between calls, in nanoseconds.
+ * @param seed The state of the random number generator.
+ * @return The interval until the next call, in nanoseconds.
+ */
+static inline double _bench_arrival_next(bench_arrival_t arrival, double interval, uint64_t* seed) {
+  if (arrival != BENCH_ARRIVAL_POISSON) return interval;
+
+  // xorshift64, so the schedule does not depend on or disturb rand()
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  double uniform = (double) (*seed >> 11) / (double) (1ULL << 53);
+  return -log(1 - uniform) * interval;
+}
+
+/*!
+ * Call a function on the schedule of an arrival process for the given
+ * duration, timing each call from when it was meant to start.
+ *
+ * @private
+ * @param fn Measurement function
+ * @param data The pointer passed to `fn`.
+ * @param rate The target calls per second.
+ * @param arrival The arrival process.
+ * @param duration How long to schedule calls for, in nanoseconds.
+ * @param stats Where to record the latency of each call, or NULL.
+ * @param histogram Where to record the latency of each call, or NULL.
+ * @return The wall-clock time from the first start to the last completion.
+ */
+static inline uint64_t _bench_rate_run(
+  bench_measure_fn fn,
+  void* data,
+  double rate,
+  bench_arrival_t arrival,
+  uint64_t duration,
+  bench_stats_t* stats,
+  bench_histogram_t* histogram
+) {
+  double interval = 1e9 / rate;
+  uint64_t seed = bench_now() | 1;
+  uint64_t begin = bench_now();
+  uint64_t end = begin;
+  double offset = 0;
+
+  // Once saturated, calls fall behind schedule and the delay counts towards
+  // their latency. Stop on the wall clock too, so a saturated run ends.
+  while (offset < duration && end - begin < duration) {
+    uint64_t intended = begin + (uint64_t) offset;
+    while (bench_now() < intended) {}
+
+    fn(data);
+    end = bench_now();
+
+    uint64_t latency = end - intended;
+    if (stats != NULL) bench_stats_push(stats, latency);
+    if (histogram != NULL) bench_histogram_record(histogram, latency * BENCH_HISTOGRAM_SCALE, 1);
+    offset += _bench_arrival_next(arrival, interval, &seed);
+  }
+  return end - begin;
+}
+
+/**
+ * Measure latency of the given function under an open-loop load, with calls
+ * scheduled at a target rate rather than back to back. Each call is timed
+ * from when it was meant to start, so when calls fall behind schedule the
+ * queueing delay is included, as it would be for requests arriving at a
+ * service. Calls are scheduled as set by `b->arrival`.
+ *
+ * Between calls the measuring thread spins until the next one is due. When
+ * the function cannot keep up with the target rate, the achieved throughput
+ * falls below it and latency grows with the backlog. Latency percentiles
+ * are always printed for open-loop measurements.
+ *
+ * ```c
+ * bench_measure_rate(b, "lookup", bench_lookup, 100000);
+ * ```
+ *
+ * ```
+ * lookup - 99.98k i/s (±0.37%) (412.06ns/i latency, 100.00k i/s target) (p50 ...)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param fn Measurement function
+ * @param rate The target calls per second
+ * @param data Optional pointer passed to `fn`
+ */
+static inline int bench_measure_rate(
+  bench_t* b,
+  const char* name,
+  bench_measure_fn fn,
+  double rate,
+  void* data,
+  ...
+) {
+  if (_bench_skip(b, name)) return 0;
+  if (!(rate > 0)) rate = 1;
+
+  _bench_print_header(b);
+  _bench_print_indent(b);
+  fprintf(b->out, "%s - ", name);
+  fflush(b->out);
+
+  bench_measurement_t* m = _bench_measurement_create(b, name);
+  if (m == NULL || !bench_array_push(&b->measurements, m)) {
+    fprintf(b->out, "failed to allocate\n");
+    return -1;
+  }
+
+  _bench_clock_init(b, false);
+  bench_affinity_t affinity;
+  if (_bench_pin_thread(b->cpu, &affinity)) {
+    m->cpus = (int*) _bench_alloc(b, sizeof(int));
+    m->nodes = (int*) _bench_alloc(b, sizeof(int));
+  }
+
+  if (b->warmup_time > 0) {
+    _bench_rate_run(fn, data, rate, b->arrival, b->warmup_time, NULL, NULL);
+  }
+  m->rate = rate;
+  m->bytes = b->bytes;
+  m->items = b->items;
+  m->wall = _bench_rate_run(fn, data, rate, b->arrival, b->target_time, &m->stats, &m->histogram);
+
+  if (m->cpus != NULL && m->nodes != NULL) {
+    _bench_current_cpu(m->cpus, m->nodes);
+  }
+  _bench_unpin_thread(&affinity);
+
+  _bench_measurement_print(b, m);
+  _bench_report(b, m);
+  return 0;
+}
+
+// Hack to make ptr optional
+#define bench_measure_rate(b, name, fn, rate, ...) \
+  bench_measure_rate(b, name, fn, rate, ##__VA_ARGS__, NULL)
+
+/*!
+ * Arguments of a rate sweep.
+ *
+ * @private
+ */
+typedef struct bench_rate_sweep_s {
+  bench_measure_fn fn;
+  double start;
+  double end;
+  double multiplier;
+  void* data;
+} bench_rate_sweep_t;
+
+/*!
+ * Print the knee of a latency-vs-throughput curve: the highest target rate
+ * which was achieved without the p99 latency more than doubling from the
+ * lowest rate.
+ *
+ * @private
+ * @param b bench namespace of the sweep
+ */
+static inline void _bench_rate_knee(bench_t* b) {
+  bench_measurement_t* knee = NULL;
+  uint64_t base = 0;
+
+  for (size_t i = 0; i < b->measurements.size; i++) {
+    bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[i];
+    if (m->rate <= 0 || m->stats.count == 0) continue;
+
+    uint64_t p99 = bench_histogram_percentile(&m->histogram, 99);
+    if (base == 0) base = p99 > 0 ? p99 : 1;
+    if (bench_measurement_ops_per_sec(m) < m->rate * 0.95 || p99 > 2 * base) break;
+    knee = m;
+  }
+  if (knee == NULL) return;
+
+  _bench_print_indent(b);
+  fprintf(b->out, "Knee at ");
+  bench_human_number(b->out, knee->rate, false);
+  fprintf(b->out, " i/s (p99 ");
+  bench_human_number(b->out, (float) bench_histogram_percentile(&knee->histogram, 99) / BENCH_HISTOGRAM_SCALE, true);
+  fprintf(b->out, ")\n");
+}
+
+/*!
+ * Group function measuring each target rate of a sweep.
+ *
+ * @private
+ * @param b bench namespace of the sweep
+ */
+static inline void _bench_rate_sweep(bench_t* b) {
+  bench_rate_sweep_t* sweep = (bench_rate_sweep_t*) b->data;
+  char name[32];
+
+  for (double rate = sweep->start; ; rate *= sweep->multiplier) {
+    if (rate > sweep->end) rate = sweep->end;
+    snprintf(name, sizeof(name), "%.0f i/s", rate);
+    bench_measure_rate(b, name, sweep->fn, rate, sweep->data);
+    if (rate >= sweep->end) break;
+  }
+  _bench_rate_knee(b);
+}
+
+/**
+ * Measure the latency-vs-throughput curve of the given function, in a
+ * sub-group running `bench_measure_rate` at target rates from `start` to
+ * `end`, multiplying by `multiplier` each time. The knee of the curve is
+ * printed after the measurements: the highest rate achieved before the p99
+ * latency more than doubles from the lowest rate.
+ *
+ * ```c
+ * bench_measure_rate_sweep(b, "lookup", bench_lookup, 10000, 1000000, 2);
+ * ```
+ *
+ * ```
+ *   # lookup
+ *   10000 i/s - 10.00k i/s (±0.41%) (398.12ns/i latency, 10.00k i/s target) (...)
+ *   ...
+ *   Knee at 320.00k i/s (p99 1.21us)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Sub-group name
+ * @param fn Measurement function
+ * @param start The lowest target calls per second
+ * @param end The highest target calls per second
+ * @param multiplier The factor between successive rates, greater than 1
+ * @param data Optional pointer passed to `fn`
+ */
+static inline void bench_measure_rate_sweep(
+  bench_t* b,
+  const char* name,
+  bench_measure_fn fn,
+  double start,
+  double end,
+  double multiplier,
+  void* data,
+  ...
+) {
+  if (!(start > 0)) start = 1;
+  bench_rate_sweep_t sweep = { fn, start, end > start ? end : start, multiplier > 1 ? multiplier : 2, data };
+  _bench_group_run(b, name, _bench_rate_sweep, &sweep, NULL);
+}
+
+// Hack to make ptr optional
+#define bench_measure_rate_sweep(b, name, fn, start, end, multiplier, ...) \
+  bench_measure_rate_sweep(b, name, fn, start, end, multiplier, ##__VA_ARGS__, NULL)
+
+/**
+ * NUMA placement.
+ */
+
+/**
+ * Where the pages of a buffer are placed, relative to the NUMA node of the
+ * thread measuring it.
+ *
+ * - `BENCH_NUMA_DEFAULT` leaves placement to the OS, usually first touch.
+ * - `BENCH_NUMA_LOCAL` binds the pages to the node of the measuring thread.
+ * - `BENCH_NUMA_REMOTE` binds the pages to another node.
+ * - `BENCH_NUMA_INTERLEAVE` spreads the pages across all nodes.
+ */
+typedef enum bench_numa_e {
+  BENCH_NUMA_DEFAULT,
+  BENCH_NUMA_LOCAL,
+  BENCH_NUMA_REMOTE,
+  BENCH_NUMA_INTERLEAVE
+} bench_numa_t;
+
+/**
+ * A buffer placed on NUMA nodes, given to the function measured by
+ * `bench_measure_numa`.
+ *
+ * @property data The buffer
+ * @property size The size of the buffer in bytes
+ * @property policy Where the buffer was placed
+ * @property node The node the buffer was bound to, or -1 when interleaved
+ *   or left to the OS
+ * @property user The pointer given to `bench_measure_numa`
+ */
+typedef struct bench_numa_buffer_s {
+  void* data;
+  size_t size;
+  bench_numa_t policy;
+  int node;
+  void* user;
+} bench_numa_buffer_t;
+
+#ifdef __linux__
+// Memory policy modes and flags of mbind, from <numaif.h>
+#define _BENCH_MPOL_BIND 2
+#define _BENCH_MPOL_INTERLEAVE 3
+#define _BENCH_MPOL_MF_MOVE (1 << 1)
+#endif
+
+/*!
+ * List the online NUMA nodes.
+ *
+ * @private
+ * @param nodes Where to write the node numbers, in ascending order.
+ * @param max The most nodes to list.
+ * @return The number of nodes listed, at least 1.
+ */
+static inline size_t _bench_numa_nodes(int* nodes, size_t max) {
+  size_t count = 0;
+#ifdef __linux__
+  // A list of ranges, such as 0-1,3
+  char line[256];
+  if (_bench_read_line("/sys/devices/system/node/online", line, sizeof(line))) {
+    char* p = line;
+    while (*p != '\0' && count < max) {
+      char* end;
+      long first = strtol(p, &end, 10);
+      if (end == p) break;
+      long last = first;
+      if (*end == '-') {
+        p = end + 1;
+        last = strtol(p, &end, 10);
+      }
+      for (long node = first; node <= last && count < max; node++) {
+        nodes[count++] = (int) node;
+      }
+      p = *end == ',' ? end + 1 : end;
+    }
+  }
+#elif defined(_WIN32)
+  ULONG highest = 0;
+  if (GetNumaHighestNodeNumber(&highest)) {
+    for (ULONG node = 0; node <= highest && count < max; node++) {
+      nodes[count++] = (int) node;
+    }
+  }
+#endif
+  if (count == 0) nodes[count++] = 0;
+  return count;
+}
+
+/*!
+ * Allocate a buffer with its pages placed on NUMA nodes, and touch every
+ * page so it is placed before it is measured.
+ *
+ * @private
+ * @param size The size of the buffer in bytes.
+ * @param policy Where to place the pages.
+ * @param node The node to bind the pages to.
+ * @param placed Set to whether the pages were placed as asked, rather than
+ *   left to the OS.
+ * @return The buffer, to free with `bench_numa_free`, or NULL.
+ */
+static inline void* _bench_numa_alloc(size_t size, bench_numa_t policy, int node, bool* placed) {
+  *placed = policy == BENCH_NUMA_DEFAULT;
+  if (size == 0) return NULL;
+#ifdef _WIN32
+  // Pages can only be given a preferred node, so interleaving is not placed
+  void* data = policy == BENCH_NUMA_LOCAL || policy == BENCH_NUMA_REMOTE
+    ? VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD) node)
+    : NULL;
+  if (data != NULL) *placed = true;
+  if (data == NULL) data = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (data == NULL) return NULL;
+#else
+  void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) return NULL;
+
+#if defined(__linux__) && defined(SYS_mbind)
+  unsigned long mask[BENCH_MAX_CPUS / (8 * sizeof(unsigned long))] = { 0 };
+  int mode = 0;
+  if ((policy == BENCH_NUMA_LOCAL || policy == BENCH_NUMA_REMOTE) && node >= 0 && node < BENCH_MAX_CPUS) {
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    mode = _BENCH_MPOL_BIND;
+  } else if (policy == BENCH_NUMA_INTERLEAVE) {
+    int nodes[BENCH_MAX_CPUS];
+    size_t count = _bench_numa_nodes(nodes, BENCH_MAX_CPUS);
+    for (size_t i = 0; i < count; i++) {
+      mask[nodes[i] / (8 * sizeof(unsigned long))] |= 1UL << (nodes[i] % (8 * sizeof(unsigned long)));
+    }
+    mode = _BENCH_MPOL_INTERLEAVE;
+  }
+
+  // Without NUMA support, the buffer keeps the default placement
+  if (mode != 0) {
+    long result = syscall(SYS_mbind, data, size, mode, mask, (unsigned long) BENCH_MAX_CPUS + 1, _BENCH_MPOL_MF_MOVE);
+    *placed = result == 0;
+  }
+#else
+  (void) policy;
+  (void) node;
+#endif
+#endif
+
+  memset(data, 0, size);
+  return data;
+}
+
+/**
+ * Allocate a buffer with its pages placed on NUMA nodes, and touch every
+ * page so it is placed before it is measured. Where the placement can not
+ * be set, such as on systems without NUMA, the buffer is allocated with the
+ * default placement. On Windows, local and remote pages are only preferred
+ * to be on the node, and interleaved pages are left to the OS.
+ *
+ * @param size The size of the buffer in bytes.
+ * @param policy Where to place the pages.
+ * @param node The node to bind the pages to, for `BENCH_NUMA_LOCAL` and
+ *   `BENCH_NUMA_REMOTE`.
+ * @return The buffer, to free with `bench_numa_free`, or NULL.
+ */
+static inline void* bench_numa_alloc(size_t size, bench_numa_t policy, int node) {
+  bool placed;
+  return _bench_numa_alloc(size, policy, node, &placed);
+}
+
+/**
+ * Free a buffer allocated with `bench_numa_alloc`.
+ *
+ * @param data The buffer.
+ * @param size The size the buffer was allocated with.
+ */
+static inline void bench_numa_free(void* data, size_t size) {
+  if (data == NULL) return;
+#ifdef _WIN32
+  (void) size;
+  VirtualFree(data, 0, MEM_RELEASE);
+#else
+  munmap(data, size);
+#endif
+}
+
+/*!
+ * Arguments of a NUMA placement comparison.
+ *
+ * @private
+ */
+typedef struct bench_numa_measure_s {
+  bench_measure_fn fn;
+  size_t size;
+  void* data;
+} bench_numa_measure_t;
+
+/*!
+ * Measure a function with a buffer under one placement policy. A placement
+ * the OS refused is still measured, labelled as left to the OS.
+ *
+ * @private
+ */
+static inline void _bench_numa_measure(
+  bench_t* b,
+  bench_numa_measure_t* args,
+  const char* name,
+  bench_numa_t policy,
+  int node
+) {
+  // Filtered out placements are never allocated and touched
+  if (_bench_skip(b, name)) return;
+
+  bool placed;
+  bench_numa_buffer_t buffer = { NULL, args->size, policy, node, args->data };
+  buffer.data = _bench_numa_alloc(args->size, policy, node, &placed);
+  if (buffer.data == NULL) {
+    _bench_print_indent(b);
+    fprintf(b->out, "%s - failed to allocate\n", name);
+    return;
+  }
+
+  // Such as "remote (node 1, not placed)"
+  char label[96];
+  if (!placed) {
+    int length = (int) strlen(name);
+    if (length > 0 && name[length - 1] == ')') length--;
+    snprintf(label, sizeof(label), "%.*s, not placed)", length, name);
+    name = label;
+    buffer.policy = BENCH_NUMA_DEFAULT;
+    buffer.node = -1;
+  }
+
+  // The buffer lives on the stack, so the measurement can not be deferred
+  bench_order_t order = b->order;
+  b->order = BENCH_ORDER_SEQUENTIAL;
+  bench_measure(b, name, args->fn, &buffer);
+  b->order = order;
+  bench_numa_free(buffer.data, buffer.size);
+}
+
+/*!
+ * Group function measuring each placement of a NUMA comparison.
+ *
+ * @private
+ * @param b bench namespace of the comparison
+ */
+static inline void _bench_numa_group(bench_t* b) {
+  bench_numa_measure_t* args = (bench_numa_measure_t*) b->data;
+
+  // Stay on one CPU, so local and remote keep their meaning while measuring
+  int cpu = -1;
+  int local = 0;
+  _bench_current_cpu(&cpu, &local);
+  if (b->cpu < 0) b->cpu = cpu;
+  bench_affinity_t affinity;
+  if (_bench_pin_thread(b->cpu, &affinity)) {
+    _bench_current_cpu(&cpu, &local);
+  }
+  _bench_unpin_thread(&affinity);
+  if (local < 0) local = 0;
+
+  int nodes[BENCH_MAX_CPUS];
+  size_t count = _bench_numa_nodes(nodes, BENCH_MAX_CPUS);
+  int remote = -1;
+  for (size_t i = 0; i < count; i++) {
+    if (nodes[i] != local) {
+      remote = nodes[i];
+      break;
+    }
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "local (node %d)", local);
+  _bench_numa_measure(b, args, name, BENCH_NUMA_LOCAL, local);
+  if (remote >= 0) {
+    snprintf(name, sizeof(name), "remote (node %d)", remote);
+    _bench_numa_measure(b, args, name, BENCH_NUMA_REMOTE, remote);
+  }
+  if (count > 1) {
+    snprintf(name, sizeof(name), "interleaved (%zu nodes)", count);
+    _bench_numa_measure(b, args, name, BENCH_NUMA_INTERLEAVE, -1);
+  }
+}
+
+/**
+ * Compare how the given function performs with its data placed on the
+ * local NUMA node, on a remote node and interleaved across all nodes, in a
+ * sub-group. The function is given a `bench_numa_buffer_t` of `size` bytes
+ * for each placement. The measuring thread is pinned to `b->cpu`, or the CPU
+ * it is running on, so local and remote are relative to that CPU's node.
+ *
+ * With a single node, only the local placement is measured.
+ *
+ * ```c
+ * void bench_scan(void* data) {
+ *   bench_numa_buffer_t* buffer = (bench_numa_buffer_t*) data;
+ *   uint64_t* values = (uint64_t*) buffer->data;
+ *   uint64_t sum = 0;
+ *   for (size_t i = 0; i < buffer->size / sizeof(uint64_t); i += 8) sum += values[i];
+ *   bench_do_not_optimize(sum);
+ * }
+ *
+ * bench_measure_numa(b, "scan", bench_scan, 256 * 1024 * 1024);
+ * ```
+ *
+ * ```
+ *   # scan
+ *   local (node 0) - 42.14 i/s (±0.52%) (23.73ms/i) [cpu 0, node 0]
+ *   remote (node 1) - 27.90 i/s (±0.61%) (35.84ms/i) [cpu 0, node 0]
+ *   interleaved (2 nodes) - 33.12 i/s (±0.47%) (30.19ms/i) [cpu 0, node 0]
+ *   Comparing...
+ *     - local (node 0) (fastest)
+ *     - interleaved (2 nodes) (27.24% slower)
+ *     - remote (node 1) (51.03% slower)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Sub-group name
+ * @param fn Measurement function, given a `bench_numa_buffer_t`
+ * @param size The size of the buffer in bytes
+ * @param data Optional pointer given to `fn` as the buffer's `user`
+ */
+static inline void bench_measure_numa(
+  bench_t* b,
+  const char* name,
+  bench_measure_fn fn,
+  size_t size,
+  void* data,
+  ...
+) {
+  bench_numa_measure_t args = { fn, size, data };
+  _bench_group_run(b, name, _bench_numa_group, &args, NULL);
+}
+
+// Hack to make ptr optional
+#define bench_measure_numa(b, name, fn, size, ...) \
+  bench_measure_numa(b, name, fn, size, ##__VA_ARGS__, NULL)
+
+/**
+ * Instruction set dispatch.
+ */
+
+#if defined(__linux__) && (defined(__aarch64__) || defined(__arm__))
+#include <sys/auxv.h>
+#endif
+
+/**
+ * Instruction sets a kernel variant may require.
+ *
+ * - `BENCH_ISA_SCALAR` runs on any CPU.
+ * - `BENCH_ISA_SSE2`, `BENCH_ISA_SSE4_2` and `BENCH_ISA_AVX2` require those
+ *   x86 extensions, and AVX2 also requires the OS to save the YMM registers.
+ * - `BENCH_ISA_AVX512` requires AVX-512 F, BW and VL, with the OS saving the
+ *   ZMM and mask registers.
+ * - `BENCH_ISA_NEON` and `BENCH_ISA_SVE` require those Arm extensions.
+ */
+typedef enum bench_isa_e {
+  BENCH_ISA_SCALAR,
+  BENCH_ISA_SSE2,
+  BENCH_ISA_SSE4_2,
+  BENCH_ISA_AVX2,
+  BENCH_ISA_AVX512,
+  BENCH_ISA_NEON,
+  BENCH_ISA_SVE
+} bench_isa_t;
+
+// The loop of the scalar code timed after each kernel variant
+#define BENCH_ISA_PROBE_ITERATIONS 4096
+
+// The most recent probes of each variant the median is taken from
+#define BENCH_ISA_PROBES 255
+
+// How much slower scalar code may run after a wide variant before it is
+// reported as having lowered the frequency, in percent
+#define BENCH_ISA_DOWNCLOCK_THRESHOLD 3
+
+/**
+ * The name of an instruction set.
+ *
+ * @param isa The instruction set.
+ * @return Its name, such as `avx2`.
+ */
+static inline const char* bench_isa_name(bench_isa_t isa) {
+  switch (isa) {
+    case BENCH_ISA_SCALAR: return "scalar";
+    case BENCH_ISA_SSE2: return "sse2";
+    case BENCH_ISA_SSE4_2: return "sse4.2";
+    case BENCH_ISA_AVX2: return "avx2";
+    case BENCH_ISA_AVX512: return "avx512";
+    case BENCH_ISA_NEON: return "neon";
+    case BENCH_ISA_SVE: return "sve";
+  }
+  return "unknown";
+}
+
+/*!
+ * Read the extended control register of the enabled register states.
+ *
+ * @private
+ * @return The enabled states, or 0 when the OS does not enable XSAVE.
+ */
+static inline uint64_t _bench_xgetbv() {
+#if defined(BENCH_HAS_CYCLES) && defined(_MSC_VER)
+  return _xgetbv(0);
+#elif defined(BENCH_HAS_CYCLES)
+  uint32_t eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t) edx << 32) | eax;
+#else
+  return 0;
+#endif
+}
+
+/*!
+ * Detect the instruction sets the CPU and OS support, once per process.
+ *
+ * @private
+ * @return A mask with bit `1 << isa` set for each supported instruction set.
+ */
+static inline uint32_t _bench_isa_detect() {
+  static uint32_t detected = 0;
+  if (detected != 0) return detected;
+
+  uint32_t mask = 1u << BENCH_ISA_SCALAR;
+#if defined(BENCH_HAS_CYCLES) && !defined(__aarch64__)
+  uint32_t leaf1[4] = { 0, 0, 0, 0 };
+  uint32_t leaf7[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+  int regs[4];
+  __cpuid(regs, 0);
+  uint32_t max = (uint32_t) regs[0];
+  __cpuid(regs, 1);
+  for (int i = 0; i < 4; i++) leaf1[i] = (uint32_t) regs[i];
+  if (max >= 7) {
+    __cpuidex(regs, 7, 0);
+    for (int i = 0; i < 4; i++) leaf7[i] = (uint32_t) regs[i];
+  }
+#else
+  uint32_t max = __get_cpuid_max(0, NULL);
+  __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+  if (max >= 7) __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+#endif
+
+  if (leaf1[3] & (1u << 26)) mask |= 1u << BENCH_ISA_SSE2;
+  if (leaf1[2] & (1u << 20)) mask |= 1u << BENCH_ISA_SSE4_2;
+
+  // Wide registers are only usable when the OS saves them
+  uint64_t states = (leaf1[2] & (1u << 27)) ? _bench_xgetbv() : 0;
+  bool ymm = (states & 0x6) == 0x6;
+  bool zmm = (states & 0xe6) == 0xe6;
+  if (ymm && (leaf1[2] & (1u << 28)) && (leaf7[1] & (1u << 5))) {
+    mask |= 1u << BENCH_ISA_AVX2;
+  }
+  uint32_t avx512 = (1u << 16) | (1u << 30) | (1u << 31);
+  if (zmm && (leaf7[1] & avx512) == avx512) mask |= 1u << BENCH_ISA_AVX512;
+#elif defined(__aarch64__)
+  mask |= 1u << BENCH_ISA_NEON;
+#if defined(__linux__)
+  if (getauxval(AT_HWCAP) & (1ul << 22)) mask |= 1u << BENCH_ISA_SVE;
+#endif
+#elif defined(__arm__) && defined(__linux__)
+  if (getauxval(AT_HWCAP) & (1ul << 12)) mask |= 1u << BENCH_ISA_NEON;
+#endif
+
+  detected = mask;
+  return mask;
+}
+
+/**
+ * Whether the CPU running the process, and its OS, support an instruction
+ * set. Checked with CPUID on x86 and the hardware capabilities on Arm.
+ *
+ * @param isa The instruction set.
+ * @return Whether code using it can run.
+ */
+static inline bool bench_isa_supported(bench_isa_t isa) {
+  return (_bench_isa_detect() & (1u << isa)) != 0;
+}
+
+/**
+ * Kernel function signature, reading `size` bytes of input and writing its
+ * output.
+ *
+ * @param input The input
+ * @param size The size of the input in bytes
+ * @param output The output, of the size given to `bench_measure_kernels`
+ */
+typedef void (*bench_kernel_fn)(const void* input, size_t size, void* output);
+
+/**
+ * A variant of a kernel, written for one instruction set.
+ *
+ * @property name The name of the variant, or NULL to use the name of `isa`.
+ * @property isa The instruction set the variant requires.
+ * @property fn The variant.
+ */
+typedef struct bench_kernel_s {
+  const char* name;
+  bench_isa_t isa;
+  bench_kernel_fn fn;
+} bench_kernel_t;
+
+/*!
+ * A kernel variant being measured, with the scalar probes timed after its
+ * recorded batches.
+ *
+ * @private
+ */
+typedef struct bench_kernel_run_s {
+  const bench_kernel_t* kernel;
+  const void* input;
+  size_t size;
+  void* output;
+  double probes[BENCH_ISA_PROBES];
+  size_t probe_count;
+} bench_kernel_run_t;
+
+/*!
+ * Arguments of a kernel variant comparison.
+ *
+ * @private
+ */
+typedef struct bench_kernel_measure_s {
+  const bench_kernel_t* kernels;
+  size_t count;
+  const void* input;
+  size_t size;
+  size_t output_size;
+  int mismatches;
+} bench_kernel_measure_t;
+
+/*!
+ * Time a fixed chain of dependent scalar multiplies, whose duration only
+ * changes with the frequency of the core.
+ *
+ * @private
+ * @param clock The clock source.
+ * @return The time taken in nanoseconds.
+ */
+static inline uint64_t _bench_isa_probe(bench_clock_t clock) {
+  uint64_t value = 1;
+  uint64_t start = bench_clock_start(clock);
+  for (int i = 0; i < BENCH_ISA_PROBE_ITERATIONS; i++) {
+    value = value * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  bench_do_not_optimize(value);
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * Batch runner calling a kernel variant, then timing the scalar probe while
+ * the core is still in the state the variant left it in.
+ *
+ * @private
+ */
+static inline uint64_t _bench_kernel_batch(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_kernel_run_t* run = (bench_kernel_run_t*) ctx;
+  bench_kernel_fn fn = run->kernel->fn;
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    fn(run->input, run->size, run->output);
+  }
+  uint64_t end = bench_clock_stop(clock);
+
+  // Warmup and calibration batches leave the core in a different state
+  if (_bench_thread_recording) {
+    run->probes[run->probe_count++ % BENCH_ISA_PROBES] = (double) _bench_isa_probe(clock);
+  }
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * The median of the probes timed after a kernel variant, sorting them in
+ * place.
+ *
+ * @private
+ * @return The median in nanoseconds, or 0 without probes.
+ */
+static inline double _bench_kernel_probe(bench_kernel_run_t* run) {
+  size_t count = run->probe_count < BENCH_ISA_PROBES ? run->probe_count : BENCH_ISA_PROBES;
+  if (count == 0) return 0;
+  qsort(run->probes, count, sizeof(double), _bench_compare_double);
+  return count % 2 ? run->probes[count / 2] : (run->probes[count / 2 - 1] + run->probes[count / 2]) / 2;
+}
+
+/*!
+ * Whether an instruction set uses vectors wide enough to lower the
+ * frequency of some cores.
+ *
+ * @private
+ */
+static inline bool _bench_isa_wide(bench_isa_t isa) {
+  return isa == BENCH_ISA_AVX2 || isa == BENCH_ISA_AVX512;
+}
+
+/*!
+ * Group function checking and measuring each kernel variant.
+ *
+ * @private
+ * @param b bench namespace of the comparison
+ */
+static inline void _bench_kernel_group(bench_t* b) {
+  bench_kernel_measure_t* args = (bench_kernel_measure_t*) b->data;
+  bench_kernel_run_t* runs = (bench_kernel_run_t*) _bench_alloc(b, args->count * sizeof(bench_kernel_run_t));
+  if (runs == NULL) return;
+
+  // Every variant is checked against the scalar one, or the first runnable
+  const bench_kernel_t* reference = NULL;
+  for (size_t i = 0; i < args->count; i++) {
+    const bench_kernel_t* kernel = &args->kernels[i];
+    if (!bench_isa_supported(kernel->isa)) continue;
+    if (reference == NULL || (kernel->isa == BENCH_ISA_SCALAR && reference->isa != BENCH_ISA_SCALAR)) {
+      reference = kernel;
+    }
+  }
+  if (reference == NULL) return;
+  void* expected = _bench_alloc(b, args->output_size > 0 ? args->output_size : 1);
+  if (expected == NULL) return;
+  reference->fn(args->input, args->size, expected);
+  const char* reference_name = reference->name != NULL ? reference->name : bench_isa_name(reference->isa);
+
+  // Interleaved, so every variant sees the same machine state
+  if (b->order == BENCH_ORDER_SEQUENTIAL) b->order = BENCH_ORDER_ROUND_ROBIN;
+  b->bytes = args->size;
+
+  for (size_t i = 0; i < args->count; i++) {
+    const bench_kernel_t* kernel = &args->kernels[i];
+    const char* name = kernel->name != NULL ? kernel->name : bench_isa_name(kernel->isa);
+    if (_bench_skip(b, name)) continue;
+
+    if (!bench_isa_supported(kernel->isa)) {
+      _bench_print_header(b);
+      _bench_print_indent(b);
+      fprintf(b->out, "%s - skipped, %s is not supported\n", name, bench_isa_name(kernel->isa));
+      continue;
+    }
+
+    bench_kernel_run_t* run = &runs[i];
+    run->kernel = kernel;
+    run->input = args->input;
+    run->size = args->size;
+    run->output = _bench_alloc(b, args->output_size > 0 ? args->output_size : 1);
+    if (run->output == NULL) continue;
+
+    kernel->fn(args->input, args->size, run->output);
+    if (memcmp(run->output, expected, args->output_size) != 0) {
+      args->mismatches++;
+      _bench_print_header(b);
+      _bench_print_indent(b);
+      fprintf(b->out, "%s - output differs from %s\n", name, reference_name);
+      continue;
+    }
+
+    _bench_measure_batch(b, name, _bench_kernel_batch, run, NULL, false, 0, 0, 0);
+  }
+
+  // Without narrow variants, the probe is compared to how it runs alone
+  _bench_clock_init(b, b->clock == BENCH_CLOCK_CYCLES || b->show_cycles);
+  double idle[16];
+  for (int i = 0; i < 16; i++) {
+    idle[i] = (double) _bench_isa_probe(b->clock);
+  }
+  qsort(idle, 16, sizeof(double), _bench_compare_double);
+
+  // Run the rounds now, so the probes are known before the comparison
+  _bench_run_rounds(b);
+
+  double baseline = 0;
+  for (size_t i = 0; i < args->count; i++) {
+    if (runs[i].kernel == NULL || _bench_isa_wide(runs[i].kernel->isa)) continue;
+    double probe = _bench_kernel_probe(&runs[i]);
+    if (probe > 0 && (baseline == 0 || probe < baseline)) baseline = probe;
+  }
+  if (baseline == 0) baseline = (idle[7] + idle[8]) / 2;
+
+  for (size_t i = 0; i < args->count; i++) {
+    bench_kernel_run_t* run = &runs[i];
+    if (run->kernel == NULL || baseline <= 0 || !_bench_isa_wide(run->kernel->isa)) continue;
+    double probe = _bench_kernel_probe(run);
+    if (probe == 0) continue;
+    double slower = (probe / baseline) * 100 - 100;
+    if (slower < BENCH_ISA_DOWNCLOCK_THRESHOLD) continue;
+
+    const char* name = run->kernel->name != NULL ? run->kernel->name : bench_isa_name(run->kernel->isa);
+    _bench_print_indent(b);
+    fprintf(b->out, "%s - scalar code ran %.2f%% slower after it, likely downclocked\n", name, slower);
+  }
+}
+
+/**
+ * Compare the variants of a kernel written for different instruction sets,
+ * in a sub-group. Variants the CPU can not run are skipped. The others are
+ * first checked to produce the same `output_size` bytes of output for the
+ * input as the scalar variant, or the first runnable one when there is no
+ * scalar variant, and those that differ are not measured. The rest are
+ * measured interleaved in rounds, with `size` bytes of throughput each call,
+ * unless `b->order` is already random.
+ *
+ * A short chain of scalar code is timed after each batch of a variant. When
+ * it runs slower after an AVX2 or AVX-512 variant than after the others,
+ * the vector units have likely lowered the frequency of the core, which
+ * also slows the code around the kernel, so this is noted below the
+ * variants.
+ *
+ * ```c
+ * static const bench_kernel_t sum_kernels[] = {
+ *   { NULL, BENCH_ISA_SCALAR, sum_scalar },
+ *   { NULL, BENCH_ISA_SSE2, sum_sse2 },
+ *   { NULL, BENCH_ISA_AVX2, sum_avx2 },
+ *   { NULL, BENCH_ISA_AVX512, sum_avx512 },
+ *   { NULL, BENCH_ISA_NEON, sum_neon }
+ * };
+ *
+ * bench_measure_kernels(b, "sum", sum_kernels, 5, input, sizeof(input), sizeof(uint64_t));
+ * ```
+ *
+ * ```
+ *   # sum
+ *   neon - skipped, neon is not supported
+ *   scalar - 1.21m i/s (±0.42%) (826.45ns/i) (4.73GiB/s)
+ *   sse2 - 3.87m i/s (±0.38%) (258.40ns/i) (15.12GiB/s)
+ *   avx2 - 6.92m i/s (±0.51%) (144.51ns/i) (27.03GiB/s)
+ *   avx512 - 8.10m i/s (±0.47%) (123.46ns/i) (31.64GiB/s)
+ *   avx512 - scalar code ran 11.84% slower after it, likely downclocked
+ *   Comparing...
+ *     - avx512 (fastest)
+ *     - avx2 (17.05% slower)
+ *     - sse2 (109.30% slower)
+ *     - scalar (569.42% slower)
+ * ```
+ *
+ * @param b bench namespace
+ * @param name Sub-group name
+ * @param kernels The variants of the kernel
+ * @param count The number of variants
+ * @param input The input given to every variant
+ * @param size The size of the input in bytes
+ * @param output_size The size of the output of each variant in bytes
+ * @return The number of variants whose output differed.
+ */
+static inline int bench_measure_kernels(
+  bench_t* b,
+  const char* name,
+  const bench_kernel_t* kernels,
+  size_t count,
+  const void* input,
+  size_t size,
+  size_t output_size
+) {
+  bench_kernel_measure_t args = { kernels, count, input, size, output_size, 0 };
+  _bench_group_run(b, name, _bench_kernel_group, &args, NULL);
+  return args.mismatches;
+}
+
+/**
+ * Concurrent groups.
+ */
+
+/*!
+ * State shared by the workers running the groups of a suite.
+ *
+ * @private
+ * @property root The top-level bench namespace
+ * @property lock Guards the suite, its reporters and the fields below
+ * @property next The index of the next group to consider
+ * @property printed The number of groups whose output has been printed
+ */
+typedef struct bench_scheduler_s {
+  bench_t* root;
+  bench_mutex_t lock;
+  size_t next;
+  size_t printed;
+} bench_scheduler_t;
+
+/*!
+ * A worker thread running groups on its own core.
+ *
+ * @private
+ */
+typedef struct bench_group_worker_s {
+  bench_scheduler_t* scheduler;
+  int cpu;
+  bench_thread_t thread;
+} bench_group_worker_t;
+
+/*!
+ * Print the buffered output of finished groups in the order they were
+ * added, up to the first group which has not finished. Called with the lock
+ * held.
+ *
+ * @private
+ * @param s The scheduler of the suite.
+ */
+static inline void _bench_groups_flush(bench_scheduler_t* s) {
+  bench_t* root = s->root;
+  char buffer[4096];
+  while (s->printed < root->groups.size) {
+    bench_pending_group_t* group = (bench_pending_group_t*) root->groups.entries[s->printed];
+    if (!group->done) break;
+
+    rewind(group->out);
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), group->out)) > 0) {
+      fwrite(buffer, 1, size, root->out);
+    }
+    fclose(group->out);
+    group->out = NULL;
+    s->printed++;
+  }
+  fflush(root->out);
+}
+
+/*!
+ * Run a queued group into its buffer, then print whatever output is ready.
+ *
+ * @private
+ * @param s The scheduler of the suite.
+ * @param group The group to run.
+ * @param cpu The CPU its measurements are pinned to, or -1.
+ */
+static inline void _bench_group_execute(bench_scheduler_t* s, bench_pending_group_t* group, int cpu) {
+  bench_t* b = _bench_group_create(s->root, group->name, group->ptr, group->out);
+  if (b != NULL) {
+    // A CPU chosen for the suite is kept over the core of the worker
+    if (b->cpu < 0) b->cpu = cpu;
+    group->fn(b);
+    bench_compare(b);
+  }
+  if (group->ptr_free != NULL) group->ptr_free(group->ptr);
+
+  _bench_lock(s->root);
+  group->done = true;
+  _bench_groups_flush(s);
+  _bench_unlock(s->root);
+}
+
+/*!
+ * Worker thread taking the groups which are not exclusive, in order.
+ *
+ * @private
+ * @param arg The `bench_group_worker_t` of the thread.
+ */
+static inline void _bench_group_worker(void* arg) {
+  bench_group_worker_t* w = (bench_group_worker_t*) arg;
+  bench_scheduler_t* s = w->scheduler;
+  bench_affinity_t affinity;
+  int cpu = _bench_pin_thread(w->cpu, &affinity) ? w->cpu : -1;
+
+  for (;;) {
+    bench_pending_group_t* group = NULL;
+    _bench_lock(s->root);
+    while (group == NULL && s->next < s->root->groups.size) {
+      bench_pending_group_t* candidate = (bench_pending_group_t*) s->root->groups.entries[s->next++];
+      if (!candidate->exclusive) group = candidate;
+    }
+    _bench_unlock(s->root);
+    if (group == NULL) break;
+    _bench_group_execute(s, group, cpu);
+  }
+
+  _bench_unpin_thread(&affinity);
+}
+
+/*!
+ * Choose one CPU on each physical core the process may run on, or the CPUs
+ * of a `BENCH_PLACEMENT_LIST` placement.
+ *
+ * @private
+ * @param b The top-level bench namespace
+ * @param cpus Where to write the CPUs, with room for `BENCH_MAX_CPUS`.
+ * @return The number of CPUs chosen.
+ */
+static inline size_t _bench_group_cpus(bench_t* b, int* cpus) {
+  if (b->placement == BENCH_PLACEMENT_LIST && b->cpu_list != NULL) {
+    size_t count = b->cpu_list_size < BENCH_MAX_CPUS ? b->cpu_list_size : BENCH_MAX_CPUS;
+    memcpy(cpus, b->cpu_list, count * sizeof(int));
+    return count;
+  }
+
+  int* cores = (int*) _bench_alloc(b, BENCH_MAX_CPUS * sizeof(int));
+  if (cores == NULL) return 0;
+  size_t available = _bench_cpus_available(cpus, BENCH_MAX_CPUS);
+  size_t count = 0;
+  for (size_t i = 0; i < available; i++) {
+    // Skip the hyperthreads of a core which already has a worker
+    int core = _bench_cpu_core(cpus[i]);
+    bool taken = false;
+    for (size_t j = 0; j < count && !taken; j++) {
+      taken = cores[j] == core;
+    }
+    if (taken) continue;
+    cores[count] = core;
+    cpus[count++] = cpus[i];
+  }
+  return count;
+}
+
+/*!
+ * Run the groups queued on a suite with `jobs` set. Groups which are not
+ * exclusive are run concurrently by a pool of workers, one per core, then
+ * exclusive groups are run one at a time. The output of each group is
+ * buffered and printed in the order the groups were added.
+ *
+ * @private
+ * @param b The top-level bench namespace
+ */
+static inline void _bench_run_groups(bench_t* b) {
+  bench_array_t* groups = &b->groups;
+  if (groups->size == 0) return;
+
+  // Without a buffer for every group, run them in place instead
+  bool buffered = true;
+  for (size_t i = 0; i < groups->size && buffered; i++) {
+    bench_pending_group_t* group = (bench_pending_group_t*) groups->entries[i];
+    group->out = tmpfile();
+    buffered = group->out != NULL;
+  }
+  if (!buffered) {
+    for (size_t i = 0; i < groups->size; i++) {
+      bench_pending_group_t* group = (bench_pending_group_t*) groups->entries[i];
+      if (group->out != NULL) fclose(group->out);
+      _bench_group_run(b, group->name, group->fn, group->ptr, group->ptr_free);
+    }
+    return;
+  }
+
+  bench_scheduler_t s;
+  s.root = b;
+  s.next = 0;
+  s.printed = 0;
+  _bench_mutex_init(&s.lock);
+
+  // Initialize state shared by every group before the workers start, only
+  // spinning to calibrate the cycle counter when the suite reads it
+  _bench_clock_init(b, b->clock == BENCH_CLOCK_CYCLES || b->show_cycles);
+  _bench_filter_compile(b);
+  b->lock = &s.lock;
+
+  size_t shared = 0;
+  for (size_t i = 0; i < groups->size; i++) {
+    if (!((bench_pending_group_t*) groups->entries[i])->exclusive) shared++;
+  }
+  size_t count = b->jobs < shared ? b->jobs : shared;
+
+  int* cpus = (int*) _bench_alloc(b, BENCH_MAX_CPUS * sizeof(int));
+  size_t cores = cpus != NULL ? _bench_group_cpus(b, cpus) : 0;
+  bench_group_worker_t* workers = count > 0
+    ? (bench_group_worker_t*) _bench_alloc(b, count * sizeof(bench_group_worker_t))
+    : NULL;
+
+  size_t started = 0;
+  if (workers != NULL) {
+    for (size_t i = 0; i < count; i++) {
+      workers[i].scheduler = &s;
+      workers[i].cpu = i < cores ? cpus[i] : -1;
+      if (!_bench_thread_create(&workers[i].thread, _bench_group_worker, &workers[i])) break;
+      started++;
+    }
+  }
+  if (started == 0 && shared > 0) {
+    // Without any worker thread, run the groups on this one
+    bench_group_worker_t worker;
+    worker.scheduler = &s;
+    worker.cpu = -1;
+    _bench_group_worker(&worker);
+  }
+  for (size_t i = 0; i < started; i++) {
+    _bench_thread_join(workers[i].thread);
+  }
+
+  for (size_t i = 0; i < groups->size; i++) {
+    bench_pending_group_t* group = (bench_pending_group_t*) groups->entries[i];
+    if (group->exclusive) _bench_group_execute(&s, group, b->cpu);
+  }
+
+  b->lock = NULL;
+  _bench_mutex_destroy(&s.lock);
+}
+
+/**
+ * Reference kernels.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BENCH_HAS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BENCH_HAS_NEON 1
+#endif
+
+/*!
+ * Find the size of the data or unified cache of a level.
+ *
+ * @private
+ * @param level The cache level, from 1.
+ * @return The size in bytes, or 0 when unknown.
+ */
+static inline size_t _bench_cache_size(int level) {
+  size_t size = 0;
+#ifdef __linux__
+  for (int index = 0; index < 16 && size == 0; index++) {
+    char path[96];
+    char type[32] = { 0 };
+    int found = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) break;
+    if (fscanf(file, "%d", &found) != 1) found = 0;
+    fclose(file);
+    if (found != level) continue;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    file = fopen(path, "r");
+    if (file == NULL) continue;
+    if (fscanf(file, "%31s", type) != 1) type[0] = '\0';
+    fclose(file);
+    if (strcmp(type, "Instruction") == 0) continue;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    file = fopen(path, "r");
+    if (file == NULL) continue;
+    unsigned long value = 0;
+    char unit = '\0';
+    if (fscanf(file, "%lu%c", &value, &unit) >= 1) {
+      size = (size_t) value;
+      if (unit == 'K') size *= 1024;
+      if (unit == 'M') size *= 1024 * 1024;
+    }
+    fclose(file);
+  }
+#elif defined(__APPLE__)
+  const char* names[] = { "hw.l1dcachesize", "hw.l2cachesize", "hw.l3cachesize" };
+  if (level >= 1 && level <= 3) {
+    uint64_t value = 0;
+    size_t length = sizeof(value);
+    if (sysctlbyname(names[level - 1], &value, &length, NULL, 0) == 0) size = (size_t) value;
+  }
+#elif defined(_WIN32)
+  DWORD length = 0;
+  GetLogicalProcessorInformation(NULL, &length);
+  SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*) malloc(length);
+  if (info != NULL && GetLogicalProcessorInformation(info, &length)) {
+    for (DWORD i = 0; i < length / sizeof(*info); i++) {
+      if (info[i].Relationship == RelationCache &&
+          info[i].Cache.Level == level &&
+          info[i].Cache.Type != CacheInstruction) {
+        size = info[i].Cache.Size;
+        break;
+      }
+    }
+  }
+  free(info);
+#else
+  (void) level;
+#endif
+  return size;
+}
+
+/*!
+ * A pointer chase through a working set, one cache line per load.
+ *
+ * @private
+ * @property buffer The working set, as allocated
+ * @property lines The number of cache lines in the working set
+ * @property head The next line to load, or NULL before the chase is built
+ */
+typedef struct bench_chase_s {
+  void* buffer;
+  size_t lines;
+  void** head;
+} bench_chase_t;
+
+/*!
+ * Link every line of the working set into one cycle in a random order, so
+ * neither the prefetchers nor out-of-order execution hide the latency.
+ *
+ * @private
+ * @param c The pointer chase.
+ */
+static inline void _bench_chase_build(bench_chase_t* c) {
+  char* base = (char*) (((uintptr_t) c->buffer + BENCH_REFERENCE_LINE - 1) & ~(uintptr_t) (BENCH_REFERENCE_LINE - 1));
+  size_t* order = (size_t*) malloc(c->lines * sizeof(size_t));
+  if (order != NULL) {
+    for (size_t i = 0; i < c->lines; i++) {
+      order[i] = i;
+    }
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = c->lines - 1; i > 0; i--) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      size_t j = (size_t) (state % (i + 1));
+      size_t swap = order[i];
+      order[i] = order[j];
+      order[j] = swap;
+    }
+  }
+
+  for (size_t i = 0; i < c->lines; i++) {
+    size_t from = order != NULL ? order[i] : i;
+    size_t to = order != NULL ? order[(i + 1) % c->lines] : (i + 1) % c->lines;
+    *(void**) (base + from * BENCH_REFERENCE_LINE) = base + to * BENCH_REFERENCE_LINE;
+  }
+  c->head = (void**) (base + (order != NULL ? order[0] : 0) * BENCH_REFERENCE_LINE);
+  free(order);
+}
+
+/*!
+ * Batch runner making one dependent load per iteration.
+ *
+ * @private
+ */
+static inline uint64_t _bench_chase_batch(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_chase_t* c = (bench_chase_t*) ctx;
+  if (c->head == NULL) _bench_chase_build(c);
+
+  void** p = c->head;
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    p = (void**) *p;
+  }
+  uint64_t end = bench_clock_stop(clock);
+  c->head = p;
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * Free a pointer chase.
+ *
+ * @private
+ */
+static inline void _bench_chase_free(void* ctx) {
+  bench_chase_t* c = (bench_chase_t*) ctx;
+  free(c->buffer);
+  free(c);
+}
+
+/*!
+ * Buffers streamed through by the bandwidth kernels.
+ *
+ * @private
+ * @property src The buffer read from
+ * @property dst The buffer written to
+ * @property words The size of each buffer in 64-bit words
+ * @property ready Whether the buffers have been touched
+ */
+typedef struct bench_stream_s {
+  uint64_t* src;
+  uint64_t* dst;
+  size_t words;
+  bool ready;
+} bench_stream_t;
+
+/*!
+ * Touch every page of the buffers, so page faults are not measured.
+ *
+ * @private
+ */
+static inline bench_stream_t* _bench_stream_prepare(void* ctx) {
+  bench_stream_t* s = (bench_stream_t*) ctx;
+  if (!s->ready) {
+    memset(s->src, 1, s->words * sizeof(uint64_t));
+    memset(s->dst, 0, s->words * sizeof(uint64_t));
+    s->ready = true;
+  }
+  return s;
+}
+
+/*!
+ * Batch runner reading the source buffer once per iteration.
+ *
+ * @private
+ */
+static inline uint64_t _bench_stream_read(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_stream_t* s = _bench_stream_prepare(ctx);
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    uint64_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    for (size_t w = 0; w + 4 <= s->words; w += 4) {
+      sum0 += s->src[w];
+      sum1 += s->src[w + 1];
+      sum2 += s->src[w + 2];
+      sum3 += s->src[w + 3];
+    }
+    uint64_t sum = sum0 + sum1 + sum2 + sum3;
+    bench_do_not_optimize(sum);
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+#if defined(BENCH_HAS_SSE2) || defined(BENCH_HAS_NEON)
+/*!
+ * Batch runner reading the source buffer once per iteration with 128-bit
+ * vector loads.
+ *
+ * @private
+ */
+static inline uint64_t _bench_stream_read_simd(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_stream_t* s = _bench_stream_prepare(ctx);
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+#ifdef BENCH_HAS_SSE2
+    __m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+    const __m128i* src = (const __m128i*) s->src;
+    for (size_t w = 0; w + 4 <= s->words; w += 4, src += 2) {
+      sum0 = _mm_add_epi64(sum0, _mm_loadu_si128(src));
+      sum1 = _mm_add_epi64(sum1, _mm_loadu_si128(src + 1));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*) lanes, _mm_add_epi64(sum0, sum1));
+#else
+    uint64x2_t sum0 = vdupq_n_u64(0), sum1 = vdupq_n_u64(0);
+    for (size_t w = 0; w + 4 <= s->words; w += 4) {
+      sum0 = vaddq_u64(sum0, vld1q_u64(s->src + w));
+      sum1 = vaddq_u64(sum1, vld1q_u64(s->src + w + 2));
+    }
+    uint64_t lanes[2];
+    vst1q_u64(lanes, vaddq_u64(sum0, sum1));
+#endif
+    uint64_t sum = lanes[0] + lanes[1];
+    bench_do_not_optimize(sum);
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+#endif
+
+/*!
+ * Batch runner writing the destination buffer once per iteration.
+ *
+ * @private
+ */
+static inline uint64_t _bench_stream_write(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_stream_t* s = _bench_stream_prepare(ctx);
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    for (size_t w = 0; w < s->words; w++) {
+      s->dst[w] = i + w;
+    }
+    bench_clobber_memory();
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+#if defined(BENCH_HAS_SSE2) || (defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)))
+#define BENCH_HAS_STREAM_STORES 1
+/*!
+ * Batch runner writing the destination buffer once per iteration with
+ * non-temporal stores, which bypass the caches.
+ *
+ * @private
+ */
+static inline uint64_t _bench_stream_write_nt(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_stream_t* s = _bench_stream_prepare(ctx);
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    for (size_t w = 0; w + 2 <= s->words; w += 2) {
+#ifdef BENCH_HAS_SSE2
+      _mm_stream_si128((__m128i*) (s->dst + w), _mm_set1_epi64x((long long) (i + w)));
+#else
+      __asm__ __volatile__("stnp %x0, %x1, [%2]" : : "r"(i + w), "r"(i + w), "r"(s->dst + w) : "memory");
+#endif
+    }
+#ifdef BENCH_HAS_SSE2
+    _mm_sfence();
+#else
+    __asm__ __volatile__("dmb ishst" : : : "memory");
+#endif
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+#endif
+
+/*!
+ * Batch runner copying the source buffer to the destination buffer once per
+ * iteration.
+ *
+ * @private
+ */
+static inline uint64_t _bench_stream_copy(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  bench_stream_t* s = _bench_stream_prepare(ctx);
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+    memcpy(s->dst, s->src, s->words * sizeof(uint64_t));
+    bench_clobber_memory();
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * Allocate a buffer of the bandwidth kernels, aligned for the 16-byte
+ * non-temporal stores, which `malloc` only guarantees on some platforms.
+ *
+ * @private
+ * @param size The size of the buffer in bytes.
+ * @return The buffer, or NULL.
+ */
+static inline uint64_t* _bench_stream_alloc(size_t size) {
+#ifdef _WIN32
+  return (uint64_t*) _aligned_malloc(size, 16);
+#else
+  void* buffer = NULL;
+  if (posix_memalign(&buffer, 16, size) != 0) return NULL;
+  return (uint64_t*) buffer;
+#endif
+}
+
+/*!
+ * Free a buffer of the bandwidth kernels.
+ *
+ * @private
+ */
+static inline void _bench_stream_release(uint64_t* buffer) {
+#ifdef _WIN32
+  _aligned_free(buffer);
+#else
+  free(buffer);
+#endif
+}
+
+/*!
+ * Free the buffers of the bandwidth kernels.
+ *
+ * @private
+ */
+static inline void _bench_stream_free(void* ctx) {
+  bench_stream_t* s = (bench_stream_t*) ctx;
+  _bench_stream_release(s->src);
+  _bench_stream_release(s->dst);
+  free(s);
+}
+
+/*!
+ * Batch runner making one atomic increment per iteration.
+ *
+ * @private
+ */
+static inline uint64_t _bench_atomic_add(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  volatile uint64_t* value = (volatile uint64_t*) ctx;
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    InterlockedIncrement64((volatile LONG64*) value);
+#else
+    __atomic_fetch_add(value, 1, __ATOMIC_SEQ_CST);
+#endif
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * Batch runner making one successful compare-and-swap per iteration.
+ *
+ * @private
+ */
+static inline uint64_t _bench_atomic_cas(void* ctx, bench_clock_t clock, uint64_t iterations) {
+  volatile uint64_t* value = (volatile uint64_t*) ctx;
+  uint64_t expected = *value;
+  uint64_t start = bench_clock_start(clock);
+  for (uint64_t i = 0; i < iterations; i++) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    uint64_t seen = (uint64_t) InterlockedCompareExchange64((volatile LONG64*) value, (LONG64) (expected + 1), (LONG64) expected);
+    expected = seen == expected ? expected + 1 : seen;
+#else
+    if (__atomic_compare_exchange_n(value, &expected, expected + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      expected++;
+    }
+#endif
+  }
+  uint64_t end = bench_clock_stop(clock);
+  return bench_clock_elapsed(clock, end - start);
+}
+
+/*!
+ * Measure a reference kernel and record its result on the top-level suite.
+ *
+ * @private
+ * @param b bench namespace
+ * @param name Measurement name
+ * @param kind The reference result the measurement is recorded as.
+ * @param run Batch runner
+ * @param ctx Pointer passed to `run`, freed with `ctx_free`
+ * @param ctx_free Frees `ctx` once the measurement has run.
+ * @param bytes The bytes moved per iteration, or 0 to record the latency.
+ */
+static inline void _bench_reference_measure(
+  bench_t* b,
+  const char* name,
+  bench_reference_t kind,
+  bench_batch_fn run,
+  void* ctx,
+  void (*ctx_free)(void* ctx),
+  uint64_t bytes
+) {
+  size_t measured = b->measurements.size;
+  b->bytes = bytes;
+  _bench_measure_batch(b, name, run, ctx, ctx_free, false, 0, 0, 0);
+  b->bytes = 0;
+  if (b->measurements.size == measured) return;
+
+  bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[measured];
+  double ops = bench_measurement_ops_per_sec(m);
+  if (ops <= 0) return;
+
+  bench_t* root = b;
+  while (root->parent != NULL) root = root->parent;
+  _bench_lock(root);
+  root->reference[kind] = bytes > 0 ? bytes * ops : (double) SECONDS / ops;
+  _bench_unlock(root);
+}
+
+/*!
+ * Measure the load latency of a working set with a pointer chase.
+ *
+ * @private
+ */
+static inline void _bench_reference_chase(bench_t* b, const char* name, bench_reference_t kind, size_t size) {
+  bench_chase_t* c = (bench_chase_t*) malloc(sizeof(bench_chase_t));
+  if (c == NULL) return;
+  c->lines = size / BENCH_REFERENCE_LINE > 2 ? size / BENCH_REFERENCE_LINE : 2;
+  c->buffer = malloc((c->lines + 1) * BENCH_REFERENCE_LINE);
+  c->head = NULL;
+  if (c->buffer == NULL) {
+    free(c);
+    return;
+  }
+  _bench_reference_measure(b, name, kind, _bench_chase_batch, c, _bench_chase_free, 0);
+}
+
+/*!
+ * The working set which does not fit in any cache.
+ *
+ * @private
+ */
+static inline size_t _bench_reference_dram_size() {
+  size_t last = _bench_cache_size(3);
+  if (last == 0) last = _bench_cache_size(2);
+  return 4 * last > BENCH_REFERENCE_DRAM_SIZE ? 4 * last : BENCH_REFERENCE_DRAM_SIZE;
+}
+
+/*!
+ * Group measuring the load latency of each level of the memory hierarchy,
+ * with working sets of half the size of each cache.
+ *
+ * @private
+ */
+static inline void _bench_reference_latency(bench_t* b) {
+  size_t l1 = _bench_cache_size(1);
+  size_t l2 = _bench_cache_size(2);
+  size_t l3 = _bench_cache_size(3);
+  _bench_reference_chase(b, "l1", BENCH_REFERENCE_L1_LATENCY, l1 > 0 ? l1 / 2 : 16 * 1024);
+  _bench_reference_chase(b, "l2", BENCH_REFERENCE_L2_LATENCY, l2 > 0 ? l2 / 2 : 128 * 1024);
+  if (l3 > 0) {
+    _bench_reference_chase(b, "l3", BENCH_REFERENCE_L3_LATENCY, l3 / 2);
+  }
+  _bench_reference_chase(b, "dram", BENCH_REFERENCE_DRAM_LATENCY, _bench_reference_dram_size());
+}
+
+/*!
+ * Measure a bandwidth kernel over buffers which do not fit in any cache.
+ *
+ * @private
+ */
+static inline void _bench_reference_stream(bench_t* b, const char* name, bench_reference_t kind, bench_batch_fn run, int passes) {
+  bench_stream_t* s = (bench_stream_t*) malloc(sizeof(bench_stream_t));
+  if (s == NULL) return;
+  s->words = _bench_reference_dram_size() / sizeof(uint64_t);
+  s->src = _bench_stream_alloc(s->words * sizeof(uint64_t));
+  s->dst = _bench_stream_alloc(s->words * sizeof(uint64_t));
+  s->ready = false;
+  if (s->src == NULL || s->dst == NULL) {
+    _bench_stream_free(s);
+    return;
+  }
+  uint64_t bytes = (uint64_t) passes * s->words * sizeof(uint64_t);
+  _bench_reference_measure(b, name, kind, run, s, _bench_stream_free, bytes);
+}
+
+/*!
+ * Group measuring the streaming bandwidth of main memory. Copies count the
+ * bytes both read and written.
+ *
+ * @private
+ */
+static inline void _bench_reference_bandwidth(bench_t* b) {
+  _bench_reference_stream(b, "read", BENCH_REFERENCE_READ_BANDWIDTH, _bench_stream_read, 1);
+#if defined(BENCH_HAS_SSE2) || defined(BENCH_HAS_NEON)
+  _bench_reference_stream(b, "read (simd)", BENCH_REFERENCE_SIMD_READ_BANDWIDTH, _bench_stream_read_simd, 1);
+#endif
+  _bench_reference_stream(b, "write", BENCH_REFERENCE_WRITE_BANDWIDTH, _bench_stream_write, 1);
+#ifdef BENCH_HAS_STREAM_STORES
+  _bench_reference_stream(b, "write (non-temporal)", BENCH_REFERENCE_STREAM_WRITE_BANDWIDTH, _bench_stream_write_nt, 1);
+#endif
+  _bench_reference_stream(b, "copy", BENCH_REFERENCE_COPY_BANDWIDTH, _bench_stream_copy, 2);
+}
+
+/*!
+ * Group measuring the latency of uncontended atomic operations.
+ *
+ * @private
+ */
+static inline void _bench_reference_atomics(bench_t* b) {
+  // Each counter has a cache line to itself
+  uint64_t* add = (uint64_t*) calloc(1, BENCH_REFERENCE_LINE);
+  if (add != NULL) {
+    _bench_reference_measure(b, "add", BENCH_REFERENCE_ATOMIC_ADD_LATENCY, _bench_atomic_add, add, free, 0);
+  }
+  uint64_t* cas = (uint64_t*) calloc(1, BENCH_REFERENCE_LINE);
+  if (cas != NULL) {
+    _bench_reference_measure(b, "cas", BENCH_REFERENCE_ATOMIC_CAS_LATENCY, _bench_atomic_cas, cas, free, 0);
+  }
+}
+
+/**
+ * Group function measuring reference kernels, which describe the machine so
+ * results from different machines can be compared: the load latency of each
+ * cache level and main memory with pointer chases, the streaming bandwidth
+ * of main memory for reads, SIMD reads, writes, non-temporal writes and
+ * copies, and the latency of uncontended atomic operations.
+ *
+ * The results are recorded on the top-level suite as `reference` and added
+ * to the output of the JSON reporter. Since the kernels saturate memory,
+ * suites with `jobs` set should add them as an exclusive group.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_group_exclusive(b, "reference", bench_reference);
+ * bench_compare(b);
+ * ```
+ *
+ * ```
+ * benc.h v1.0.0
+ * # bench
+ *   # reference
+ *     # latency
+ *     l1 - 829.43m i/s (±0.41%) (1.21ns/i)
+ *     ...
+ * ```
+ *
+ * @param b bench namespace
+ */
+static inline void bench_reference(bench_t* b) {
+  // Results are read back as soon as each measurement is done
+  b->order = BENCH_ORDER_SEQUENTIAL;
+  b->allocations = false;
+  b->bytes = 0;
+  b->items = 0;
+  b->complexity = false;
+
+  bench_group(b, "latency", _bench_reference_latency);
+  bench_group(b, "bandwidth", _bench_reference_bandwidth);
+  bench_group(b, "atomics", _bench_reference_atomics);
+}
+
+/**
+ * Registration.
+ */
+
+struct bench_registration_s;
+
+/**
+ * Function adding a registered benchmark to the bench namespace it runs in.
+ *
+ * @param b The bench namespace of the registered group.
+ * @param registration The registered benchmark.
+ */
+typedef void (*bench_register_fn)(bench_t* b, struct bench_registration_s* registration);
+
+/**
+ * A benchmark registered before the suite runs, usually by `BENCH_REGISTER`
+ * while the program starts. Registrations are linked into the registry as
+ * they are made, so they must have static storage.
+ *
+ * @property group The name of the group to run in, or NULL for the suite.
+ * @property name Measurement name
+ * @property fn Measurement function
+ * @property data Pointer passed to `fn`
+ * @property add Function adding the measurement, used instead of measuring
+ *   `fn` when set.
+ * @property next The next registration.
+ */
+typedef struct bench_registration_s {
+  const char* group;
+  const char* name;
+  bench_measure_fn fn;
+  void* data;
+  bench_register_fn add;
+  struct bench_registration_s* next;
+} bench_registration_t;
+
+/*!
+ * The registrations of the program, in the order they were made.
+ *
+ * @private
+ * @property head The first registration.
+ * @property tail The last registration.
+ */
+typedef struct {
+  bench_registration_t* head;
+  bench_registration_t* tail;
+} bench_registry_t;
+
+/*!
+ * The registry shared by every translation unit including this header. It
+ * is a weak definition, which the linker merges into one, so benchmarks
+ * registered in any file of the program run together. Compilers without
+ * weak symbols keep a registry per translation unit.
+ *
+ * @private
+ */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((weak)) bench_registry_t _bench_registry;
+#elif defined(_MSC_VER)
+__declspec(selectany) bench_registry_t _bench_registry = { NULL, NULL };
+#else
+static bench_registry_t _bench_registry;
+#endif
+
+/**
+ * Add a benchmark to the registry, to be run by `bench_run_registered`.
+ * Nothing is measured or allocated until the suite runs.
+ *
+ * @param registration The registration, which must outlive the program.
+ */
+static inline void bench_register(bench_registration_t* registration) {
+  registration->next = NULL;
+  if (_bench_registry.tail != NULL) {
+    _bench_registry.tail->next = registration;
+  } else {
+    _bench_registry.head = registration;
+  }
+  _bench_registry.tail = registration;
+}
+
+#define _BENCH_CONCAT_EXPANDED(a, b) a##b
+#define _BENCH_CONCAT(a, b) _BENCH_CONCAT_EXPANDED(a, b)
+
+/**
+ * Define a function which runs when the program starts, before `main`.
+ *
+ * ```c
+ * BENCH_CONSTRUCTOR(setup) {
+ *   bench_register(&registration);
+ * }
+ * ```
+ *
+ * @param f The name of the function.
+ */
+#if defined(__cplusplus)
+#define BENCH_CONSTRUCTOR(f) \
+  static void f(void); \
+  static const int _BENCH_CONCAT(f, _init) = (f(), 0); \
+  static void f(void)
+#elif defined(_MSC_VER)
+// The pointer is static, like the CRT's own initializers, so files defining
+// constructors on the same line do not collide. Data allocated to a named
+// section is kept even though nothing refers to it.
+#define BENCH_CONSTRUCTOR(f) \
+  static void f(void); \
+  __pragma(section(".CRT$XCU", read)) \
+  __declspec(allocate(".CRT$XCU")) static void (*const _BENCH_CONCAT(f, _init))(void) = f; \
+  static void f(void)
+#else
+#define BENCH_CONSTRUCTOR(f) \
+  __attribute__((constructor)) static void f(void)
+#endif
+
+/**
+ * Register a measurement from any file of the program, to be run by
+ * `bench_run_registered` or by `bench_main` when it is given no suite
+ * function. Registering only links a static entry into the registry, so
+ * measurements not selected by `--filter` are never called or given their
+ * data.
+ *
+ * ```c
+ * static void parse_small(void* data) { ... }
+ * static void parse_large(void* data) { ... }
+ *
+ * BENCH_REGISTER("parse", "small", parse_small);
+ * BENCH_REGISTER("parse", "large", parse_large, &large_input);
+ *
+ * int main(int argc, char** argv) {
+ *   return bench_main(bench_create("bench", stdout), argc, argv, NULL);
+ * }
+ * ```
+ *
+ * ```
+ * $ ./bench --filter=small
+ * benc.h v1.0.0
+ * # bench
+ *   # parse
+ *   small - 26.92m i/s (±0.49%) (34.11ns/i)
+ * ```
+ *
+ * @param group The name of the group to run in, or NULL for the suite.
+ * @param name Measurement name
+ * @param fn Measurement function
+ * @param data Optional pointer passed to `fn`
+ */
+#define BENCH_REGISTER(group, name, fn, ...) \
+  _BENCH_REGISTER(_BENCH_CONCAT(_bench_registration_, __LINE__), group, name, fn, ##__VA_ARGS__, NULL)
+
+/*!
+ * Define a registration and the constructor adding it to the registry,
+ * followed by a declaration so the macro is used as a statement.
+ *
+ * @private
+ */
+#define _BENCH_REGISTER(id, group, name, fn, data, ...) \
+  static bench_registration_t id = { group, name, fn, data, NULL, NULL }; \
+  BENCH_CONSTRUCTOR(_BENCH_CONCAT(id, _register)) { bench_register(&id); } \
+  extern bench_registry_t _bench_registry
+
+/*!
+ * Add one registration, unless it is not selected by the filter of the
+ * suite.
+ *
+ * @private
+ * @param b The bench namespace to measure in.
+ * @param r The registration.
+ */
+static inline void _bench_registered_add(bench_t* b, bench_registration_t* r) {
+  // Checked first, so unselected registrations are never set up
+  if (_bench_skip(b, r->name)) return;
+  if (r->add != NULL) {
+    r->add(b, r);
+  } else {
+    bench_measure(b, r->name, r->fn, r->data);
+  }
+}
+
+/*!
+ * Whether two registrations name the same group.
+ *
+ * @private
+ * @param a A group name, or NULL for the suite.
+ * @param b Another group name.
+ */
+static inline bool _bench_registered_same_group(const char* a, const char* b) {
+  if (a == NULL || *a == '\0') return b == NULL || *b == '\0';
+  return b != NULL && strcmp(a, b) == 0;
+}
+
+/*!
+ * Run the registrations of one group, matched by the name of the group.
+ *
+ * @private
+ * @param b The bench namespace of the group.
+ */
+static inline void _bench_registered_group(bench_t* b) {
+  for (bench_registration_t* r = _bench_registry.head; r != NULL; r = r->next) {
+    if (_bench_registered_same_group(r->group, b->name)) _bench_registered_add(b, r);
+  }
+}
+
+/**
+ * Run every registered benchmark in the given bench namespace. Those
+ * without a group are measured directly, and the others in a sub-group per
+ * group name, in the order each group was first registered.
+ *
+ * ```c
+ * bench_t* b = bench_create("bench", stdout);
+ * bench_run_registered(b);
+ * bench_compare(b);
+ * ```
+ *
+ * @param b bench namespace
+ */
+static inline void bench_run_registered(bench_t* b) {
+  for (bench_registration_t* r = _bench_registry.head; r != NULL; r = r->next) {
+    if (r->group == NULL || *r->group == '\0') {
+      _bench_registered_add(b, r);
+      continue;
+    }
+
+    // Groups run once, where they were first registered
+    bench_registration_t* first = _bench_registry.head;
+    while (!_bench_registered_same_group(first->group, r->group)) first = first->next;
+    if (first == r) bench_group(b, r->group, _bench_registered_group);
+  }
+}
+
+/*!
+ * Parse the seconds of a `--min-time` option, with an optional `s` suffix.
+ *
+ * @private
+ * @param value The option value.
+ * @param time Set to the time in nanoseconds.
+ * @return Whether the value was valid.
+ */
+static inline bool _bench_parse_seconds(const char* value, uint64_t* time) {
+  char* end;
+  double seconds = strtod(value, &end);
+  if (end == value || seconds < 0) return false;
+  if (*end == 's') end++;
+  if (*end != '\0') return false;
+  *time = (uint64_t) (seconds * SECONDS);
+  return true;
+}
+
+/*!
+ * Parse a positive count, such as that of a `--jobs` option. Signs, spaces
+ * and counts which do not fit in 32 bits are rejected.
+ *
+ * @private
+ * @param value The option value.
+ * @param count Set to the count.
+ * @return Whether the value was valid.
+ */
+static inline bool _bench_parse_count(const char* value, uint32_t* count) {
+  if (*value < '0' || *value > '9') return false;
+  char* end;
+  unsigned long long parsed = strtoull(value, &end, 10);
+  if (*end != '\0' || parsed == 0 || parsed > UINT32_MAX) return false;
+  *count = (uint32_t) parsed;
+  return true;
+}
+
+/*!
+ * Print the options of `bench_main`.
+ *
+ * @private
+ */
+static inline void _bench_usage(FILE* out, const char* program) {
+  fprintf(out,
+    "usage: %s [options]\n"
+    "  --filter=<regex>    only run measurements whose path matches\n"
+    "  --repetitions=<n>   repeat each measurement n times\n"
+    "  --min-time=<secs>   record samples for at least this long\n"
+    "  --jobs=<n>          run groups concurrently on n cores\n"
+    "  --environment       print the machine and build setup\n"
+    "  --subtract-overhead subtract timer and call overhead from results\n"
+    "  --isolate=<mode>    fork a process per measurement or group\n"
+    "  --list              list measurements without running them\n"
+    "  --help              show this help\n",
+    program);
+}
+
+/**
+ * Run a suite as the main function of a process, with its options taken
+ * from the command line. Options given on the command line override those
+ * already set on the suite.
+ *
+ * - `--filter=<regex>` only runs measurements whose path, such as
+ *   `bench/group/name`, matches the extended regular expression.
+ *   Measurements which do not match are not run at all.
+ * - `--repetitions=<n>` repeats each measurement `n` times and aggregates
+ *   the results.
+ * - `--min-time=<seconds>` records samples of each measurement for at least
+ *   this long.
+ * - `--jobs=<n>` runs the groups of the suite concurrently on `n` cores,
+ *   except for those added with `bench_group_exclusive`.
+ * - `--environment` probes and prints the environment, as with
+ *   `bench_environment`.
+ * - `--subtract-overhead` subtracts the overhead of the framework from
+ *   results, as with `bench_subtract_overhead`.
+ * - `--isolate=measurement` or `--isolate=group` runs each measurement or
+ *   group in its own child process.
+ * - `--list` prints the path of each measurement without running it.
+ *
+ * ```c
+ * void suite(bench_t* b) {
+ *   bench_measure(b, "fast", bench_fast);
+ *   bench_measure(b, "slow", bench_slow);
+ * }
+ *
+ * int main(int argc, char** argv) {
+ *   bench_t* b = bench_create("bench", stdout);
+ *   return bench_main(b, argc, argv, suite);
+ * }
+ * ```
+ *
+ * ```
+ * $ ./bench --filter=fast
+ * benc.h v1.0.0
+ * # bench
+ * fast - 26.92m i/s (±0.49%) (34.11ns/i)
+ * ```
+ *
+ * When `fn` is NULL, the benchmarks registered with `BENCH_REGISTER` are
+ * run instead, as with `bench_run_registered`.
+ *
+ * @param b The top-level bench namespace, which is compared and freed.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments.
+ * @param fn The function adding measurements to the suite, or NULL.
+ * @return The exit status for the process: 0 on success, 1 when any
+ *   measurement regressed against the baseline, or 2 for invalid options,
+ *   including a `--filter` which is not a valid expression.
+ */
+static inline int bench_main(bench_t* b, int argc, char** argv, bench_group_fn fn) {
+  const char* program = argc > 0 ? argv[0] : "bench";
+  bool environment = false;
+  bool subtract_overhead = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool valid = true;
+
+    if (strncmp(arg, "--filter=", 9) == 0) {
+      b->filter = arg + 9;
+    } else if (strncmp(arg, "--repetitions=", 14) == 0) {
+      valid = _bench_parse_count(arg + 14, &b->repetitions);
+    } else if (strncmp(arg, "--min-time=", 11) == 0) {
+      valid = _bench_parse_seconds(arg + 11, &b->target_time);
+      b->min_time = b->target_time;
+    } else if (strncmp(arg, "--jobs=", 7) == 0) {
+      valid = _bench_parse_count(arg + 7, &b->jobs);
+    } else if (strcmp(arg, "--environment") == 0) {
+      environment = true;
+    } else if (strcmp(arg, "--subtract-overhead") == 0) {
+      subtract_overhead = true;
+    } else if (strcmp(arg, "--isolate=measurement") == 0) {
+      b->isolation = BENCH_ISOLATION_MEASUREMENT;
+    } else if (strcmp(arg, "--isolate=group") == 0) {
+      b->isolation = BENCH_ISOLATION_GROUP;
+    } else if (strcmp(arg, "--list") == 0) {
+      b->list = true;
+    } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      _bench_usage(stdout, program);
+      bench_free(b);
+      return 0;
+    } else {
+      valid = false;
+    }
+
+    if (!valid) {
+      fprintf(stderr, "%s: invalid option '%s'\n", program, arg);
+      _bench_usage(stderr, program);
+      bench_free(b);
+      return 2;
+    }
+  }
+
+  // Compiled once up front, rather than falling back to substrings
+  _bench_filter_compile(b);
+  if (b->filter_invalid) {
+    fprintf(stderr, "%s: invalid filter '%s'\n", program, b->filter);
+    bench_free(b);
+    return 2;
+  }
+
+  if (environment) bench_environment(b);
+  if (subtract_overhead) bench_subtract_overhead(b);
+  if (fn != NULL) {
+    fn(b);
+  } else {
+    bench_run_registered(b);
+  }
+  return bench_compare(b) > 0 ? 1 : 0;
+}
+
+/**
+ * Define a `main` function running the registered benchmarks in a suite
+ * with the given name, with options taken from the command line as with
+ * `bench_main`.
+ *
+ * ```c
+ * BENCH_REGISTER(NULL, "fast", bench_fast);
+ * BENCH_MAIN("bench")
+ * ```
+ *
+ * @param name The name of the suite.
+ */
+#define BENCH_MAIN(name) \
+  int main(int argc, char** argv) { \
+    return bench_main(bench_create(name, stdout), argc, argv, NULL); \
+  }
+
+/*!
+ * C++11 API
+ */
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#define BENCH_HAS_COROUTINES 1
+#endif
+#endif
+
+namespace bench {
+
+/**
+ * Force the given value to be computed, as if it were read by code the
+ * compiler can not see.
+ *
+ * ```cpp
+ * b.measure("fast", []() { bench::do_not_optimize(fibo(5)); });
+ * ```
+ *
+ * @param value The value to keep
+ */
+template <typename T>
+inline void do_not_optimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  __asm__ __volatile__("" : : "r,m"(value) : "memory");
+#else
+  _bench_sink = (const volatile void*) &value;
+  _ReadWriteBarrier();
+#endif
+}
+
+/**
+ * Force the given value to be computed, and assume it may also have been
+ * modified, by code the compiler can not see.
+ *
+ * @param value The value to keep
+ */
+template <typename T>
+inline void do_not_optimize(T& value) {
+#if defined(__clang__)
+  __asm__ __volatile__("" : "+r,m"(value) : : "memory");
+#elif defined(__GNUC__)
+  __asm__ __volatile__("" : "+m,r"(value) : : "memory");
+#else
+  _bench_sink = (const volatile void*) &value;
+  _ReadWriteBarrier();
+#endif
+}
+
+/**
+ * Force all pending memory writes to happen, as if memory were read by code
+ * the compiler can not see.
+ */
+inline void clobber_memory() {
+  bench_clobber_memory();
+}
+
+#ifdef BENCH_HAS_COROUTINES
+/**
+ * Return type of a coroutine measured by `Group::measure_async`. Each
+ * operation starts a new coroutine, which completes the operation when it
+ * returns.
+ *
+ * ```cpp
+ * b.measure_async("read", []() -> bench::AsyncTask {
+ *   co_await socket.read(buffer);
+ * }, [&]() { loop.poll(); }, 16);
+ * ```
+ */
+struct AsyncTask {
+  struct promise_type {
+    bench_async_t* op = nullptr;
+
+    AsyncTask get_return_object() {
+      return AsyncTask { std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+
+    // Started once the operation is attached
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+        bench_async_t* op = handle.promise().op;
+        handle.destroy();
+        bench_async_done(op);
+      }
+      void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+#endif
+
+class Group {
+  private:
+
+  friend class Registrar;
+
+  bench_t* bench;
+
+  /**
+   * Batch runner calling a callable of type `F` inline.
+   *
+   * @param ctx Pointer to the callable
+   * @param clock The clock source.
+   * @param iterations The number of calls to make.
+   * @return The time taken by the batch in nanoseconds.
+   */
+  template <typename F>
+  static uint64_t run_batch(void* ctx, bench_clock_t clock, uint64_t iterations) {
+    F& fn = *static_cast<F*>(ctx);
+    uint64_t start = bench_clock_start(clock);
+    for (uint64_t i = 0; i < iterations; i++) {
+      fn();
+    }
+    uint64_t end = bench_clock_stop(clock);
+    return bench_clock_elapsed(clock, end - start);
+  }
+
+  /**
+   * The prototype of a fixture measurement, and the copies for the current
+   * chunk of a batch.
+   */
+  template <typename Fixture>
+  struct FixtureBatch {
+    Fixture prototype;
+    std::vector<Fixture> fixtures;
+  };
+
+  /**
+   * Batch runner setting up a copy of the fixture for each iteration of a
+   * chunk of up to `BENCH_FIXTURE_BATCH` iterations before timing the chunk,
+   * and tearing them down afterwards.
+   *
+   * @param ctx Pointer to the FixtureBatch
+   * @param clock The clock source.
+   * @param iterations The number of calls to make.
+   * @return The time taken by the calls in nanoseconds.
+   */
+  template <typename Fixture>
+  static uint64_t run_fixture(void* ctx, bench_clock_t clock, uint64_t iterations) {
+    FixtureBatch<Fixture>& batch = *static_cast<FixtureBatch<Fixture>*>(ctx);
+    uint64_t elapsed = 0;
+
+    for (uint64_t done = 0; done < iterations;) {
+      uint64_t count = iterations - done < BENCH_FIXTURE_BATCH ? iterations - done : BENCH_FIXTURE_BATCH;
+
+      // The buffer keeps its capacity, so later chunks reuse it
+      bool tracked = _bench_allocs_pause();
+      batch.fixtures.assign(count, batch.prototype);
+      for (Fixture& fixture : batch.fixtures) {
+        fixture.setup();
+      }
+      _bench_allocs_resume(tracked);
+
+      Fixture* fixtures = batch.fixtures.data();
+      uint64_t start = bench_clock_start(clock);
+      for (uint64_t i = 0; i < count; i++) {
+        fixtures[i].run();
+      }
+      uint64_t end = bench_clock_stop(clock);
+      elapsed += bench_clock_elapsed(clock, end - start);
+
+      tracked = _bench_allocs_pause();
+      for (Fixture& fixture : batch.fixtures) {
+        fixture.teardown();
+      }
+      _bench_allocs_resume(tracked);
+      done += count;
+    }
+
+    return elapsed;
+  }
+
+  /**
+   * Measure with a batch runner, handing it ownership of its context so the
+   * measurement can outlive the call when it is deferred.
+   *
+   * @param name Measurement name
+   * @param run Batch runner
+   * @param ctx The context of `run`, allocated with `new`
+   * @param overhead The nanoseconds per iteration spent calling the code
+   * @param chunk The most iterations `run` times per clock read, or 0
+   */
+  template <typename T>
+  void measure_owned(const std::string& name, bench_batch_fn run, T* ctx, double overhead = 0, uint64_t chunk = 0) {
+    _bench_measure_batch(bench, name.c_str(), run, ctx, [](void* ctx) {
+      delete static_cast<T*>(ctx);
+    }, false, 0, overhead, chunk);
+  }
+
+  /**
+   * Measure a callable right away, calling it in place.
+   *
+   * @param name Measurement name
+   * @param fn Measurement function
+   */
+  template <typename F>
+  void measure_in_place(const std::string& name, F& fn) {
+    bench_measure_batch(bench, name.c_str(), run_batch<F>, (void*) &fn);
+  }
+
+  /**
+   * Measure a plain function right away, through a pointer to it, as a
+   * function type can not be the target of the context pointer.
+   *
+   * @param name Measurement name
+   * @param fn Measurement function
+   */
+  template <typename R>
+  void measure_in_place(const std::string& name, R (&fn)()) {
+    R (*pointer)() = fn;
+    bench_measure_batch(bench, name.c_str(), run_batch<R (*)()>, (void*) &pointer);
+  }
+
+  public:
+
+  /**
+   * Wrap an existing bench namespace
+   *
+   * @param b bench namespace
+   */
+  Group(bench_t* b) : bench(b) {}
+
+  /**
+   * Construct a new bench namespace
+   *
+   * @param name Group name
+   * @param out Target stream to which to write results. Defaults to stdout.
+   */
+  Group(std::string name, FILE* out = stdout)
+    : bench(bench_create(name.c_str(), out, 0, NULL)) {}
+
+  /**
+   * Do comparison when the group is destroyed.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure("fast", [](){});
+   * b.measure("slow", [](){});
+   * ```
+   */
+  ~Group() {
+    if (bench != nullptr && bench->indent == 0) {
+      bench_compare(bench);
+    }
+  }
+
+  /**
+   * Do comparison now, rather than when the group is destroyed, to find out
+   * how many measurements regressed against the baseline.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * bench_load_baseline(b.get(), "main.json");
+   * b.measure("fast", [](){});
+   * return b.compare() > 0;
+   * ```
+   *
+   * @return The number of measurements which regressed.
+   */
+  int compare() {
+    if (bench == nullptr || bench->indent != 0) return 0;
+    int regressions = bench_compare(bench);
+    bench = nullptr;
+    return regressions;
+  }
+
+  /**
+   * Run the group as the main function of a process, with options taken
+   * from the command line. See `bench_main` for the options.
+   *
+   * ```cpp
+   * int main(int argc, char** argv) {
+   *   bench::Group b("bench");
+   *   return b.main(argc, argv, [](bench::Group* g) {
+   *     g->measure("fast", [](){});
+   *   });
+   * }
+   * ```
+   *
+   * @param argc The number of command line arguments.
+   * @param argv The command line arguments.
+   * @param fn The function adding measurements to the group.
+   * @return The exit status for the process.
+   */
+  int main(int argc, char** argv, std::function<void(Group*)> fn) {
+    if (bench == nullptr || bench->indent != 0) return 2;
+    bench->data = &fn;
+    int status = bench_main(bench, argc, argv, [](bench_t* b) {
+      Group g(b);
+      (*static_cast<std::function<void(Group*)>*>(b->data))(&g);
+
+      // The suite is compared by bench_main, not when g is destroyed
+      g.bench = nullptr;
+    });
+    bench = nullptr;
+    return status;
+  }
+
+  /**
+   * Run the registered benchmarks as the main function of a process, with
+   * options taken from the command line. See `bench_main` for the options.
+   *
+   * ```cpp
+   * static bench::Registrar fast("group", "fast", [](){});
+   *
+   * int main(int argc, char** argv) {
+   *   return bench::Group("bench").main(argc, argv);
+   * }
+   * ```
+   *
+   * @param argc The number of command line arguments.
+   * @param argv The command line arguments.
+   * @return The exit status for the process.
+   */
+  int main(int argc, char** argv) {
+    if (bench == nullptr || bench->indent != 0) return 2;
+    int status = bench_main(bench, argc, argv, NULL);
+    bench = nullptr;
+    return status;
+  }
+
+  /**
+   * Run every registered benchmark in this group. See
+   * `bench_run_registered`.
+   */
+  void run_registered() {
+    bench_run_registered(bench);
+  }
+
+  /**
+   * Access the underlying bench namespace, to set measurement options.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.get()->batch_time = 10 * MICROS;
+   * ```
+   *
+   * @return bench namespace
+   */
+  bench_t* get() const {
+    return bench;
+  }
 
-  _bench_print_indent(b);
-  fprintf(b->out, "%s - ", name);
-  fflush(b->out);
+  /**
+   * Export results with the given reporter, as well as to the human
+   * readable output.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.add_reporter(bench_json_reporter(fopen("bench.json", "w")));
+   * ```
+   *
+   * @param reporter The reporter to add, allocated with `malloc`
+   */
+  void add_reporter(bench_reporter_t* reporter) {
+    bench_add_reporter(bench, reporter);
+  }
 
-  // Create a new measurement
-  bench_measurement_t* m = (bench_measurement_t*) malloc(sizeof(bench_measurement_t));
-  bench_measurement_init(m, name);
+  /**
+   * Measure the overhead the framework adds to every measurement, including
+   * that of calling a `std::function`, and subtract it from the results of
+   * this group. See `bench_subtract_overhead`.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.subtract_overhead();
+   * ```
+   */
+  void subtract_overhead() {
+    calibrate_function(BENCH_CLOCK_MONOTONIC);
+    calibrate_function(BENCH_CLOCK_CYCLES);
+    bench_subtract_overhead(bench);
+  }
 
-  // Add measurement to the current suite
-  bench_array_push(&b->measurements, m);
+  /**
+   * Function for which to measure performance.
+   */
+  using MeasureFn = std::function<void()>;
 
-  uint64_t start = bench_now();
-  uint64_t end;
+  /**
+   * Measure performance of the given function.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure("fast", [](){});
+   * b.measure("slow", [](){});
+   * ```
+   *
+   * @param name Measurement name
+   * @param fn Measurement function
+   */
+  void measure(std::string name, MeasureFn fn) {
+    double overhead = 0;
+    if (bench->subtract_overhead) {
+      calibrate_function(bench->clock);
+      overhead = _bench_overheads[bench->clock == BENCH_CLOCK_CYCLES].function;
+    }
+    measure_owned(name, run_batch<MeasureFn>, new MeasureFn(std::move(fn)), overhead);
+  }
 
-  while (m->stats.total < b->target_time) {
-    start = bench_now();
-    fn(data);
-    end = bench_now();
-    bench_stats_push(&m->stats, end - start);
+  /**
+   * Measure performance of the given callable. The timing loop is
+   * instantiated for each callable type, so its body can be inlined into
+   * the loop rather than called through a `std::function`.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure("inlined", [&](){ sum += value; });
+   * ```
+   *
+   * @param name Measurement name
+   * @param fn Measurement function
+   */
+  template <typename F>
+  void measure(std::string name, F&& fn) {
+    if (bench->order == BENCH_ORDER_SEQUENTIAL) {
+      measure_in_place(name, fn);
+    } else {
+      // Deferred measurements outlive this call, so they keep a copy
+      using Fn = typename std::decay<F>::type;
+      measure_owned(name, run_batch<Fn>, new Fn(std::forward<F>(fn)));
+    }
   }
 
-  bench_stats_print(&m->stats, b->out);
-  fprintf(b->out, "\n");
-  return 0;
-}
+  /**
+   * Measure performance of a fixture, with per-iteration setup and teardown
+   * left out of the timing. Each iteration runs on its own copy of the
+   * given prototype, so a whole batch can be set up before it is timed.
+   *
+   * ```cpp
+   * struct SortFixture {
+   *   std::vector<int> input;
+   *   void setup() { std::shuffle(input.begin(), input.end(), rng); }
+   *   void run() { std::sort(input.begin(), input.end()); }
+   *   void teardown() {}
+   * };
+   *
+   * bench::Group b("bench");
+   * b.measure_fixture("sort", SortFixture { data });
+   * ```
+   *
+   * @param name Measurement name
+   * @param prototype The fixture to copy for each iteration
+   */
+  template <typename Fixture>
+  void measure_fixture(std::string name, Fixture prototype) {
+    measure_owned(name, run_fixture<Fixture>, new FixtureBatch<Fixture> { prototype, {} }, 0, BENCH_FIXTURE_BATCH);
+  }
 
-// Hack to make ptr optional
-#define bench_measure(b, name, fn, ...) \
-  bench_measure(b, name, fn, ##__VA_ARGS__, NULL)
+  /**
+   * Function for which to measure performance over a range of arguments.
+   */
+  using RangeFn = std::function<void(uint64_t)>;
 
-/*!
- * C++11 API
- */
-#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+  /**
+   * Measure the given function over a geometric range of arguments, in a
+   * sub-group named `name`.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.get()->bytes = 1;
+   * b.measure_range("memset", [&](uint64_t size){ memset(buffer, 0, size); }, 64, 64 << 20, 8);
+   * ```
+   *
+   * @param name Sub-group name
+   * @param fn Measurement function, given each argument in turn
+   * @param start The first argument
+   * @param end The last argument
+   * @param multiplier The ratio between consecutive arguments
+   */
+  void measure_range(std::string name, RangeFn fn, uint64_t start, uint64_t end, uint64_t multiplier = 2) {
+    bench_measure_range(bench, name.c_str(), [](void* data, uint64_t arg) {
+      RangeFn* fn = (RangeFn*) data;
+      (*fn)(arg);
+    }, start, end, multiplier, &fn);
+  }
 
-#include <functional>
-#include <string>
+  /**
+   * Measure the given function with each of a list of arguments, in a
+   * sub-group named `name`.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure_args("sort", [&](uint64_t n){ sort(input, n); }, { 1000, 10000, 100000 });
+   * ```
+   *
+   * @param name Sub-group name
+   * @param fn Measurement function, given each argument in turn
+   * @param args The arguments to measure with
+   */
+  void measure_args(std::string name, RangeFn fn, std::vector<uint64_t> args) {
+    bench_measure_args(bench, name.c_str(), [](void* data, uint64_t arg) {
+      RangeFn* fn = (RangeFn*) data;
+      (*fn)(arg);
+    }, args.data(), args.size(), &fn);
+  }
 
-namespace bench {
+  /**
+   * Measure throughput of the given function called concurrently from
+   * several threads.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure_parallel("increment", [&](){ counter++; }, 4);
+   * ```
+   *
+   * @param name Measurement name
+   * @param fn Measurement function, called from every thread
+   * @param threads The number of threads to run
+   */
+  void measure_parallel(std::string name, MeasureFn fn, uint32_t threads) {
+    bench_measure_parallel(bench, name.c_str(), [](void* data) {
+      MeasureFn* fn = (MeasureFn*) data;
+      (*fn)();
+    }, threads, &fn);
+  }
 
-class Group {
-  private:
+  /**
+   * Measure how throughput of the given function scales with thread count.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure_parallel_sweep("increment", [&](){ counter++; }, 8);
+   * ```
+   *
+   * @param name Sub-group name
+   * @param fn Measurement function, called from every thread
+   * @param max_threads The largest number of threads to run
+   */
+  void measure_parallel_sweep(std::string name, MeasureFn fn, uint32_t max_threads) {
+    bench_measure_parallel_sweep(bench, name.c_str(), [](void* data) {
+      MeasureFn* fn = (MeasureFn*) data;
+      (*fn)();
+    }, max_threads, &fn);
+  }
 
-  bench_t* bench;
+  /**
+   * Measure latency of the given function under an open-loop load at a
+   * target rate. See `bench_measure_rate`.
+   *
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure_rate("lookup", [&](){ map.find(key); }, 100000);
+   * ```
+   *
+   * @param name Measurement name
+   * @param fn Measurement function
+   * @param rate The target calls per second
+   */
+  int measure_rate(std::string name, MeasureFn fn, double rate) {
+    return bench_measure_rate(bench, name.c_str(), [](void* data) {
+      MeasureFn* fn = (MeasureFn*) data;
+      (*fn)();
+    }, rate, &fn);
+  }
 
-  public:
+  /**
+   * Measure the latency-vs-throughput curve of the given function over a
+   * range of target rates. See `bench_measure_rate_sweep`.
+   *
+   * @param name Sub-group name
+   * @param fn Measurement function
+   * @param start The lowest target calls per second
+   * @param end The highest target calls per second
+   * @param multiplier The factor between successive rates
+   */
+  void measure_rate_sweep(std::string name, MeasureFn fn, double start, double end, double multiplier = 2) {
+    bench_measure_rate_sweep(bench, name.c_str(), [](void* data) {
+      MeasureFn* fn = (MeasureFn*) data;
+      (*fn)();
+    }, start, end, multiplier, &fn);
+  }
 
   /**
-   * Wrap an existing bench namespace
+   * Function measured over a buffer placed on NUMA nodes.
    *
-   * @param b bench namespace
+   * @param buffer The buffer
    */
-  Group(bench_t* b) : bench(b) {}
+  using NumaFn = std::function<void(bench_numa_buffer_t*)>;
 
   /**
-   * Construct a new bench namespace
+   * Compare the given function with its data placed on the local NUMA node,
+   * a remote node and interleaved across nodes. See `bench_measure_numa`.
    *
-   * @param name Group name
-   * @param out Target stream to which to write results. Defaults to stdout.
+   * ```cpp
+   * bench::Group b("bench");
+   * b.measure_numa("scan", [](bench_numa_buffer_t* buffer) {
+   *   scan(buffer->data, buffer->size);
+   * }, 256 * 1024 * 1024);
+   * ```
+   *
+   * @param name Sub-group name
+   * @param fn Measurement function
+   * @param size The size of the buffer in bytes
    */
-  Group(std::string name, FILE* out = stdout)
-    : bench(bench_create(name.c_str(), out, 0, NULL)) {}
+  void measure_numa(std::string name, NumaFn fn, size_t size) {
+    bench_measure_numa(bench, name.c_str(), [](void* data) {
+      bench_numa_buffer_t* buffer = (bench_numa_buffer_t*) data;
+      (*(NumaFn*) buffer->user)(buffer);
+    }, size, &fn);
+  }
 
   /**
-   * Do comparison when the group is destroyed.
+   * Compare the variants of a kernel written for different instruction
+   * sets. See `bench_measure_kernels`.
    *
    * ```cpp
    * bench::Group b("bench");
-   * b.measure("fast", [](){});
-   * b.measure("slow", [](){});
+   * b.measure_kernels("sum", {
+   *   { nullptr, BENCH_ISA_SCALAR, sum_scalar },
+   *   { nullptr, BENCH_ISA_AVX2, sum_avx2 }
+   * }, input.data(), input.size(), sizeof(uint64_t));
    * ```
+   *
+   * @param name Sub-group name
+   * @param kernels The variants of the kernel
+   * @param input The input given to every variant
+   * @param size The size of the input in bytes
+   * @param output_size The size of the output of each variant in bytes
+   * @return The number of variants whose output differed.
    */
-  ~Group() {
-    if (bench->indent == 0) {
-      bench_compare(bench);
-    }
+  int measure_kernels(
+    std::string name,
+    const std::vector<bench_kernel_t>& kernels,
+    const void* input,
+    size_t size,
+    size_t output_size
+  ) {
+    return bench_measure_kernels(bench, name.c_str(), kernels.data(), kernels.size(), input, size, output_size);
   }
 
   /**
-   * Function for which to measure performance.
+   * Function starting an asynchronous operation, which calls
+   * `bench_async_done` once it completes.
+   *
+   * @param op The operation to start
    */
-  using MeasureFn = std::function<void()>;
+  using AsyncFn = std::function<void(bench_async_t*)>;
 
   /**
-   * Measure performance of the given function.
+   * Function driving the event loop asynchronous operations complete on.
+   */
+  using PollFn = std::function<void()>;
+
+  /**
+   * Measure latency and throughput of asynchronous operations with a number
+   * of them in flight at once. See `bench_measure_async`.
    *
    * ```cpp
    * bench::Group b("bench");
-   * b.measure("fast", [](){});
-   * b.measure("slow", [](){});
+   * b.measure_async("timer", [&](bench_async_t* op) {
+   *   loop.after(1ms, [op]() { bench_async_done(op); });
+   * }, [&]() { loop.poll(); }, 16);
    * ```
    *
    * @param name Measurement name
-   * @param fn Measurement function
+   * @param start Starts an operation
+   * @param poll Drives the event loop, or nullptr
+   * @param in_flight The number of operations to keep in flight
    */
-  void measure(std::string name, MeasureFn fn) {
-    bench_measure(bench, name.c_str(), [](void* data) {
-      MeasureFn* fn = (MeasureFn*) data;
-      (*fn)();
-    }, &fn);
+  int measure_async(std::string name, AsyncFn start, PollFn poll = nullptr, uint32_t in_flight = 1) {
+    struct AsyncData {
+      AsyncFn start;
+      PollFn poll;
+    };
+    AsyncData data { start, poll };
+
+    return bench_measure_async(bench, name.c_str(), [](bench_async_t* op) {
+      AsyncData* data = (AsyncData*) op->data;
+      data->start(op);
+    }, [](void* ptr) {
+      AsyncData* data = (AsyncData*) ptr;
+      if (data->poll) data->poll();
+    }, in_flight, &data);
+  }
+
+#ifdef BENCH_HAS_COROUTINES
+  /**
+   * Function starting an asynchronous operation as a coroutine, which
+   * completes the operation when it returns.
+   */
+  using AsyncTaskFn = std::function<AsyncTask()>;
+
+  /**
+   * Measure latency and throughput of coroutines with a number of them in
+   * flight at once. See `bench_measure_async`.
+   *
+   * @param name Measurement name
+   * @param start Starts a coroutine per operation
+   * @param poll Drives the event loop the coroutines are resumed on, or nullptr
+   * @param in_flight The number of coroutines to keep in flight
+   */
+  int measure_async(std::string name, AsyncTaskFn start, PollFn poll = nullptr, uint32_t in_flight = 1) {
+    return measure_async(name, AsyncFn([start](bench_async_t* op) {
+      AsyncTask task = start();
+      task.handle.promise().op = op;
+      task.handle.resume();
+    }), poll, in_flight);
   }
+#endif
 
   /**
    * Function to group a collection of measurements.
@@ -650,22 +9741,181 @@ class Group {
    * @param fn Group function
    */
   void group(const char* name, GroupFn fn) {
+    add_group(name, fn, false);
+  }
+
+  /**
+   * Group a collection of measurements which never runs concurrently with
+   * other groups. See `bench_group_exclusive`.
+   *
+   * @param name Group name
+   * @param fn Group function
+   */
+  void group_exclusive(const char* name, GroupFn fn) {
+    add_group(name, fn, true);
+  }
+
+  private:
+
+  /**
+   * Measure the overhead of calling a `std::function`, once per process.
+   *
+   * @param clock The clock source.
+   */
+  void calibrate_function(bench_clock_t clock) {
+    bench_overhead_t* overhead = _bench_overhead_calibrate(bench, clock);
+
+    // Groups running on workers measure it once between them
+    bench_t* root = bench;
+    while (root->parent != NULL) root = root->parent;
+    _bench_lock(root);
+    if (overhead->function < 0) {
+      // Called through a volatile pointer, so the empty loop is not optimized out
+      bench_batch_fn volatile run = run_batch<MeasureFn>;
+      MeasureFn empty = []() {};
+      overhead->function = _bench_overhead_median(run, &empty, clock, BENCH_OVERHEAD_ITERATIONS, overhead->timer);
+    }
+    _bench_unlock(root);
+  }
+
+  /**
+   * Run or queue a group calling a `GroupFn`.
+   *
+   * @param name Group name
+   * @param fn Group function
+   * @param exclusive Whether the group must run alone
+   */
+  void add_group(const char* name, GroupFn fn, bool exclusive) {
     struct GroupData {
       GroupFn fn;
     };
 
     GroupData* group_data = new GroupData { fn };
 
-    bench_group(bench, name, [](bench_t* b) {
+    // Freed once the group has run, even when it ran in a child process
+    _bench_group_add(bench, name, [](bench_t* b) {
       GroupData* data = (GroupData*) b->data;
       Group g(b);
       data->fn(&g);
-    }, group_data);
+    }, group_data, [](void* data) {
+      delete static_cast<GroupData*>(data);
+    }, exclusive);
+  }
+};
+
+/**
+ * Register a measurement from any file of the program, like
+ * `BENCH_REGISTER`, by defining a static registrar. The function is only
+ * called when the suite runs and the measurement is selected by the filter,
+ * so any state it needs can be created on its first call.
+ *
+ * ```cpp
+ * static bench::Registrar sort_small("sort", "small", []() {
+ *   static std::vector<int> input = make_input(1 << 10);
+ *   std::vector<int> copy = input;
+ *   std::sort(copy.begin(), copy.end());
+ * });
+ * ```
+ */
+class Registrar {
+  private:
+
+  Group::MeasureFn fn;
+  bench_registration_t registration;
+
+  /**
+   * Measure the function of a registrar in the given bench namespace.
+   *
+   * @param b The bench namespace of the registered group.
+   * @param registration The registration of the registrar.
+   */
+  static void add(bench_t* b, bench_registration_t* registration) {
+    Registrar* registrar = static_cast<Registrar*>(registration->data);
+    Group g(b);
+    g.measure(registration->name, registrar->fn);
+
+    // The namespace is compared by whoever runs the registry
+    g.bench = nullptr;
+  }
+
+  public:
+
+  /**
+   * Register a measurement.
+   *
+   * @param group The name of the group to run in, or NULL for the suite.
+   * @param name Measurement name
+   * @param fn Measurement function
+   */
+  Registrar(const char* group, const char* name, Group::MeasureFn fn)
+    : fn(std::move(fn)), registration { group, name, NULL, this, add, NULL } {
+    bench_register(&registration);
   }
+
+  // Registered by address, so it can not be copied or moved
+  Registrar(const Registrar&) = delete;
+  Registrar& operator=(const Registrar&) = delete;
 };
 
 } // namespace bench
 
+#ifdef BENCH_TRACK_ALLOCATIONS
+#include <new>
+
+/*!
+ * Replaced global allocation functions, so allocations of C++ code are
+ * tracked on every platform.
+ */
+void* operator new(std::size_t size) {
+  void* ptr = _bench_raw_malloc(size > 0 ? size : 1);
+  if (ptr == nullptr) throw std::bad_alloc();
+  if (_bench_thread_allocs.tracked) _bench_allocs_add(size, _bench_usable_size(ptr));
+  return ptr;
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  void* ptr = _bench_raw_malloc(size > 0 ? size : 1);
+  if (ptr != nullptr && _bench_thread_allocs.tracked) _bench_allocs_add(size, _bench_usable_size(ptr));
+  return ptr;
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+  if (ptr == nullptr) return;
+  if (_bench_thread_allocs.tracked) _bench_allocs_remove(_bench_usable_size(ptr));
+  _bench_raw_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  operator delete(ptr);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+#endif
+#endif // BENCH_TRACK_ALLOCATIONS
+
 #endif // __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
 
 #endif // _INCLUDE_BENC_H_
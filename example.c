@@ -8,7 +8,7 @@ int fibo(int n) {
 }
 
 void bench_fib_to_n(void* data) {
-  fibo((int) data);
+  bench_do_not_optimize(fibo((int) (intptr_t) data));
 }
 
 void bench_publish_suite(bench_t* b) {
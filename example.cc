@@ -13,8 +13,8 @@ int main() {
   Group b("bench");
 
   b.group("publish", [](Group* b) {
-    b->measure("fast", []() { fibo(5); });
-    b->measure("slow", []() { fibo(10); });
+    b->measure("fast", []() { bench::do_not_optimize(fibo(5)); });
+    b->measure("slow", []() { bench::do_not_optimize(fibo(10)); });
   });
 
   return 0;
@@ -0,0 +1,733 @@
+#include "benc.h"
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+#define CHECK_NEAR(actual, expected, tolerance) \
+  check(fabs((double) (actual) - (double) (expected)) <= (tolerance), #actual " ~ " #expected, __LINE__)
+
+void check(bool passed, const char* condition, int line) {
+  checks++;
+  if (!passed) {
+    failures++;
+    fprintf(stderr, "test.c:%d: failed: %s\n", line, condition);
+  }
+}
+
+// Read everything written to a temporary file so far
+const char* output(FILE* out) {
+  static char text[8192];
+  fflush(out);
+  rewind(out);
+  size_t size = fread(text, 1, sizeof(text) - 1, out);
+  text[size] = '\0';
+  return text;
+}
+
+bench_t* quiet_suite(const char* name) {
+  return bench_create(name, tmpfile());
+}
+
+// Add a measurement with known results, without running anything
+bench_measurement_t* add_result(bench_t* b, const char* name, uint64_t samples, double mean, double stddev) {
+  bench_measurement_t* m = _bench_measurement_create(b, name);
+  for (uint64_t i = 0; i < samples; i++) {
+    // Alternate around the mean, so the samples have the given deviation
+    double value = i % 2 == 0 ? mean - stddev : mean + stddev;
+    bench_stats_push(&m->stats, (uint64_t) value);
+  }
+  bench_array_push(&b->measurements, m);
+  return m;
+}
+
+void test_stats_merge() {
+  static const uint64_t values[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+
+  bench_stats_t all;
+  bench_stats_init(&all);
+  for (size_t i = 0; i < 8; i++) bench_stats_push(&all, values[i]);
+  CHECK(all.count == 8);
+  CHECK(all.total == 40);
+  CHECK_NEAR(all.mean, 5, 1e-12);
+  CHECK_NEAR(bench_stats_variance(&all), 4, 1e-12);
+  CHECK_NEAR(bench_stats_stddev(&all), 2, 1e-12);
+
+  // Chan's merge of two halves matches Welford's over all of them
+  bench_stats_t first;
+  bench_stats_t second;
+  bench_stats_init(&first);
+  bench_stats_init(&second);
+  for (size_t i = 0; i < 3; i++) bench_stats_push(&first, values[i]);
+  for (size_t i = 3; i < 8; i++) bench_stats_push(&second, values[i]);
+  bench_stats_merge(&first, &second);
+  CHECK(first.count == all.count);
+  CHECK(first.samples == all.samples);
+  CHECK(first.total == all.total);
+  CHECK_NEAR(first.mean, all.mean, 1e-12);
+  CHECK_NEAR(first.d_squared, all.d_squared, 1e-9);
+
+  // Merging nothing changes nothing
+  bench_stats_t empty;
+  bench_stats_init(&empty);
+  bench_stats_merge(&first, &empty);
+  CHECK(first.count == 8);
+  CHECK_NEAR(first.mean, 5, 1e-12);
+
+  // A batch counts as its iterations, but as one sample
+  bench_stats_t batch;
+  bench_stats_init(&batch);
+  bench_stats_push_batch(&batch, 400, 100);
+  CHECK(batch.count == 100);
+  CHECK(batch.samples == 1);
+  CHECK_NEAR(batch.mean, 4, 1e-12);
+}
+
+void test_t_table_and_rme() {
+  CHECK(isinf(_bench_t_critical(0)));
+  CHECK_NEAR(_bench_t_critical(1), 12.706, 1e-9);
+  CHECK_NEAR(_bench_t_critical(7), 2.365, 1e-9);
+  CHECK_NEAR(_bench_t_critical(30), 2.042, 1e-9);
+  CHECK_NEAR(_bench_t_critical(31), 2.039, 1e-3);
+  CHECK_NEAR(_bench_t_critical(40), 2.021, 1e-9);
+  CHECK_NEAR(_bench_t_critical(60), 2.000, 1e-9);
+  CHECK_NEAR(_bench_t_critical(120), 1.980, 1e-9);
+  CHECK_NEAR(_bench_t_critical(1000), 1.962, 1e-3);
+  CHECK_NEAR(_bench_t_critical(100000), 1.96, 1e-4);
+
+  // Beyond the table, the critical value keeps falling towards its limit
+  bool falling = true;
+  for (uint64_t df = 1; df < 1000 && falling; df++) {
+    falling = _bench_t_critical(df + 1) < _bench_t_critical(df);
+  }
+  CHECK(falling);
+
+  // 8 samples with a mean of 5 and a deviation of 2, so 7 degrees of freedom
+  static const uint64_t values[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+  bench_stats_t stats;
+  bench_stats_init(&stats);
+  bench_stats_push(&stats, values[0]);
+  CHECK(bench_stats_rme(&stats) == 0);
+  for (size_t i = 1; i < 8; i++) bench_stats_push(&stats, values[i]);
+  CHECK_NEAR(bench_stats_rme(&stats), 2.365 * (2 / sqrt(8.0)) / 5 * 100, 1e-9);
+}
+
+void test_histogram_percentiles() {
+  bench_histogram_t hist;
+  bench_histogram_init(&hist);
+  CHECK(bench_histogram_percentile(&hist, 50) == 0);
+
+  for (uint64_t value = 1; value <= 10000; value++) {
+    bench_histogram_record(&hist, value * 1000, 1);
+  }
+  CHECK(hist.count == 10000);
+  CHECK(hist.min == 1000);
+  CHECK(hist.max == 10000000);
+
+  // Buckets keep the value to within 1/BENCH_HISTOGRAM_HALF of itself
+  double error = 1.0 / BENCH_HISTOGRAM_HALF;
+  CHECK_NEAR(bench_histogram_percentile(&hist, 50), 5000000, 5000000 * error);
+  CHECK_NEAR(bench_histogram_percentile(&hist, 90), 9000000, 9000000 * error);
+  CHECK_NEAR(bench_histogram_percentile(&hist, 99), 9900000, 9900000 * error);
+  CHECK(bench_histogram_percentile(&hist, 100) == 10000000);
+  CHECK(bench_histogram_percentile(&hist, 0) <= 1000 * (1 + error));
+
+  // Merging is the same as recording both into one
+  bench_histogram_t other;
+  bench_histogram_init(&other);
+  bench_histogram_record(&other, 20000000, 10000);
+  bench_histogram_merge(&hist, &other);
+  CHECK(hist.count == 20000);
+  CHECK(hist.max == 20000000);
+  CHECK(bench_histogram_percentile(&hist, 75) == 20000000);
+}
+
+// Run the baseline comparison of one measurement, returning the regressions
+int compare_baseline(double mean, double stddev, double base_mean, double base_stddev, const char** text) {
+  bench_t* b = quiet_suite("suite");
+  bench_baseline_t* base = (bench_baseline_t*) _bench_alloc(b, sizeof(bench_baseline_t));
+  base->group = "suite";
+  base->name = "m";
+  base->samples = 100;
+  base->mean = base_mean;
+  base->stddev = base_stddev;
+  bench_array_push(&b->baseline, base);
+  add_result(b, "m", 100, mean, stddev);
+
+  FILE* out = b->out;
+  int regressions = bench_compare(b);
+  *text = output(out);
+  fclose(out);
+  return regressions;
+}
+
+static uint64_t parallel_calls = 0;
+
+void count_parallel(void* data) {
+  (void) data;
+  __atomic_fetch_add(&parallel_calls, 1, __ATOMIC_RELAXED);
+}
+
+void test_parallel() {
+  bench_t* b = quiet_suite("parallel");
+  b->target_time = 2 * MILLIS;
+  CHECK(bench_measure_parallel(b, "count", count_parallel, 3) == 0);
+
+  // The stats of every thread are merged into one measurement
+  CHECK(b->measurements.size == 1);
+  bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[0];
+  CHECK(m->threads == 3);
+  CHECK(m->wall > 0);
+  CHECK(m->stats.count > 0 && m->stats.count <= parallel_calls);
+  CHECK(strstr(output(b->out), "count - ") != NULL);
+  CHECK(strstr(output(b->out), "3 threads)") != NULL);
+
+  // Sweeps double the threads up to the largest count
+  bench_measure_parallel_sweep(b, "sweep", count_parallel, 3);
+  const char* text = output(b->out);
+  CHECK(strstr(text, "  # sweep\n  1 thread - ") != NULL);
+  CHECK(strstr(text, "  2 threads - ") != NULL);
+  CHECK(strstr(text, "  3 threads - ") != NULL);
+  CHECK(strstr(text, "  4 threads - ") == NULL);
+  fclose(b->out);
+  bench_free(b);
+}
+
+void test_welch() {
+  const char* text;
+
+  // The same mean is never significant
+  CHECK(compare_baseline(1000, 10, 1000, 10, &text) == 0);
+  CHECK(strstr(text, "- m (0.00% faster, not significant)") != NULL);
+
+  // A 20% slowdown with little noise is a regression
+  CHECK(compare_baseline(1200, 10, 1000, 10, &text) == 1);
+  CHECK(strstr(text, "- m (20.00% slower, significant, regression)") != NULL);
+
+  // A 20% speedup is significant, but not a regression
+  CHECK(compare_baseline(800, 10, 1000, 10, &text) == 0);
+  CHECK(strstr(text, "- m (20.00% faster, significant)") != NULL);
+
+  // The same slowdown buried in noise is not significant
+  CHECK(compare_baseline(1200, 1000, 1000, 1000, &text) == 0);
+  CHECK(strstr(text, "not significant") != NULL);
+
+  // A significant slowdown below the threshold is not a regression
+  CHECK(compare_baseline(1030, 1, 1000, 1, &text) == 0);
+  CHECK(strstr(text, "- m (3.00% slower, significant)") != NULL);
+}
+
+// Fit measurements of time = f(n) and return the printed complexity
+const char* fit(double (*f)(double n)) {
+  static char line[128];
+  bench_t* b = quiet_suite("suite");
+  b->complexity = true;
+  for (uint64_t n = 8; n <= 8192; n *= 2) {
+    char name[32];
+    snprintf(name, sizeof(name), "%llu", (unsigned long long) n);
+    bench_measurement_t* m = add_result(b, name, 2, f((double) n), 0);
+    m->has_arg = true;
+    m->arg = n;
+  }
+
+  FILE* out = b->out;
+  bench_compare(b);
+  const char* complexity = strstr(output(out), "Complexity: ");
+  snprintf(line, sizeof(line), "%s", complexity != NULL ? complexity : "");
+  fclose(out);
+  return line;
+}
+
+double constant(double n) { (void) n; return 5000; }
+double logarithmic(double n) { return 100 * log2(n); }
+double linear(double n) { return 3 * n; }
+double linearithmic(double n) { return 2 * n * log2(n); }
+
+// Counts the states set up and torn down by test_fixture
+static int fixture_setups = 0;
+static int fixture_runs = 0;
+static int fixture_teardowns = 0;
+static int fixture_live = 0;
+static int fixture_peak = 0;
+
+void* setup_fixture(void* data) {
+  fixture_setups++;
+  if (++fixture_live > fixture_peak) fixture_peak = fixture_live;
+  return data;
+}
+
+void run_fixture(void* state) {
+  if (state == &fixture_runs) fixture_runs++;
+}
+
+void teardown_fixture(void* data, void* state) {
+  (void) data;
+  (void) state;
+  fixture_teardowns++;
+  fixture_live--;
+}
+
+void test_fixture() {
+  bench_t* b = quiet_suite("fixture");
+  b->target_time = 2 * MILLIS;
+  b->batch_time = 100 * MICROS;
+  CHECK(bench_measure_fixture(b, "fixture", setup_fixture, run_fixture, teardown_fixture, &fixture_runs) == 0);
+
+  // Every run had its own state, and batches hold one chunk of them at once
+  CHECK(fixture_runs > BENCH_FIXTURE_BATCH);
+  CHECK(fixture_setups == fixture_runs);
+  CHECK(fixture_teardowns == fixture_runs);
+  CHECK(fixture_live == 0);
+  CHECK(fixture_peak <= BENCH_FIXTURE_BATCH);
+
+  // Filtered out fixtures are never set up
+  b->filter = "other";
+  int setups = fixture_setups;
+  CHECK(bench_measure_fixture(b, "fixture", setup_fixture, run_fixture, teardown_fixture) == 0);
+  CHECK(fixture_setups == setups);
+  b->filter = NULL;
+  fclose(b->out);
+  bench_free(b);
+}
+
+void test_complexity() {
+  CHECK(strncmp(fit(constant), "Complexity: O(1) (5.00us", 24) == 0);
+  CHECK(strncmp(fit(logarithmic), "Complexity: O(log n) ", 21) == 0);
+  CHECK(strncmp(fit(linear), "Complexity: O(n) (3.00ns * n, rms 0.00%)", 40) == 0);
+  CHECK(strncmp(fit(linearithmic), "Complexity: O(n log n) (2.00ns * n log n", 40) == 0);
+}
+
+void test_json_baseline() {
+  const char* path = "test_baseline.json";
+  FILE* json = fopen(path, "w");
+  CHECK(json != NULL);
+  if (json == NULL) return;
+
+  bench_t* b = quiet_suite("suite");
+  FILE* out = b->out;
+  CHECK(bench_add_reporter(b, bench_json_reporter(json)));
+  bench_measurement_t* fast = add_result(b, "fast", 10, 100, 10);
+  _bench_report(b, fast);
+  bench_t* group = _bench_group_create(b, "group \"quoted\"", NULL, out);
+  bench_measurement_t* slow = add_result(group, "slow", 20, 2000, 50);
+  _bench_report(group, slow);
+  double stddev = bench_stats_stddev(&slow->stats);
+  bench_compare(group);
+  bench_compare(b);
+  fclose(json);
+  fclose(out);
+
+  bench_t* loaded = quiet_suite("suite");
+  CHECK(bench_load_baseline(loaded, path));
+  CHECK(loaded->baseline.size == 2);
+  if (loaded->baseline.size == 2) {
+    bench_baseline_t* first = (bench_baseline_t*) loaded->baseline.entries[0];
+    bench_baseline_t* second = (bench_baseline_t*) loaded->baseline.entries[1];
+    CHECK(strcmp(first->group, "suite") == 0);
+    CHECK(strcmp(first->name, "fast") == 0);
+    CHECK(first->samples == 10);
+    CHECK_NEAR(first->mean, 100, 1e-6);
+    CHECK_NEAR(first->stddev, 10, 1e-6);
+    CHECK(strcmp(second->group, "suite/group \"quoted\"") == 0);
+    CHECK(strcmp(second->name, "slow") == 0);
+    CHECK(second->samples == 20);
+    CHECK_NEAR(second->mean, 2000, 1e-6);
+    CHECK_NEAR(second->stddev, stddev, 1e-6);
+  }
+  CHECK(!bench_load_baseline(loaded, "test_missing.json"));
+  out = loaded->out;
+  bench_compare(loaded);
+  fclose(out);
+  remove(path);
+}
+
+void bench_nothing(void* data) {
+  (void) data;
+}
+
+void empty_suite(bench_t* b) {
+  (void) b;
+}
+
+void listed_suite(bench_t* b) {
+  bench_measure(b, "fast", bench_nothing);
+  bench_measure(b, "slow", bench_nothing);
+}
+
+// Regresses against the baseline loaded by test_cli
+void regressed_suite(bench_t* b) {
+  add_result(b, "m", 100, 2000, 10);
+}
+
+// Run bench_main with the given options, keeping what it printed
+int run_main(const char* option, bench_group_fn fn, const char** text) {
+  static FILE* out = NULL;
+  if (out != NULL) fclose(out);
+  out = tmpfile();
+  char* argv[] = { (char*) "test", (char*) option };
+  bench_t* b = bench_create("cli", out);
+  if (fn == regressed_suite) {
+    bench_baseline_t* base = (bench_baseline_t*) _bench_alloc(b, sizeof(bench_baseline_t));
+    base->group = "cli";
+    base->name = "m";
+    base->samples = 100;
+    base->mean = 1000;
+    base->stddev = 10;
+    bench_array_push(&b->baseline, base);
+  }
+  int status = bench_main(b, option != NULL ? 2 : 1, argv, fn);
+  *text = output(out);
+  return status;
+}
+
+void test_cli() {
+  const char* text;
+  CHECK(run_main("--list", listed_suite, &text) == 0);
+  CHECK(strstr(text, "cli/fast\ncli/slow\n") != NULL);
+  CHECK(strstr(text, " - ") == NULL);
+
+  CHECK(run_main("--filter=l.w", listed_suite, &text) == 0);
+  CHECK(strstr(text, "slow - ") != NULL);
+  CHECK(strstr(text, "fast - ") == NULL);
+
+  CHECK(run_main(NULL, regressed_suite, &text) == 1);
+  CHECK(strstr(text, "regression") != NULL);
+
+  // Invalid options, and filters which are not valid expressions
+  CHECK(run_main("--unknown", listed_suite, &text) == 2);
+  CHECK(run_main("--repetitions=0", listed_suite, &text) == 2);
+  CHECK(run_main("--min-time=soon", listed_suite, &text) == 2);
+  CHECK(run_main("--jobs=", listed_suite, &text) == 2);
+  CHECK(run_main("--jobs=-1", listed_suite, &text) == 2);
+  CHECK(run_main("--repetitions=-1", listed_suite, &text) == 2);
+  CHECK(run_main("--repetitions= 3", listed_suite, &text) == 2);
+  CHECK(run_main("--repetitions=4294967296", listed_suite, &text) == 2);
+  CHECK(run_main("--jobs=99999999999999999999", listed_suite, &text) == 2);
+  CHECK(run_main("--repetitions=4294967295", empty_suite, &text) == 0);
+#ifndef _WIN32
+  CHECK(run_main("--filter=(", listed_suite, &text) == 2);
+  CHECK(strstr(text, " - ") == NULL);
+#endif
+}
+
+void cycles_group(bench_t* b) {
+  b->clock = BENCH_CLOCK_CYCLES;
+  b->subtract_overhead = true;
+  bench_measure(b, "m", bench_nothing);
+}
+
+void test_jobs() {
+  bench_t* b = quiet_suite("jobs");
+  b->target_time = 2 * MILLIS;
+  b->jobs = 2;
+  bench_group(b, "first", cycles_group);
+  bench_group(b, "second", cycles_group);
+  bench_group_exclusive(b, "third", cycles_group);
+  CHECK(b->groups.size == 3);
+
+  FILE* out = b->out;
+  CHECK(bench_compare(b) == 0);
+
+  // Groups run by the workers print in the order they were added
+  const char* text = output(out);
+  const char* first = strstr(text, "  # first\n  m - ");
+  const char* second = strstr(text, "  # second\n  m - ");
+  const char* third = strstr(text, "  # third\n  m - ");
+  CHECK(first != NULL && second != NULL && third != NULL);
+  CHECK(first < second && second < third);
+
+  // The workers calibrated the clock and overhead between them
+  CHECK(_bench_overheads[1].timer >= 0);
+  fclose(out);
+}
+
+void test_trace() {
+  bench_t* b = quiet_suite("trace");
+  b->target_time = 2 * MILLIS;
+  b->batch_time = 200 * MICROS;
+  FILE* out = b->out;
+  FILE* trace = tmpfile();
+  CHECK(bench_trace(b, trace));
+  CHECK(!bench_trace(b, trace));
+  bench_measure(b, "m", bench_nothing);
+  CHECK(bench_compare(b) == 0);
+
+  // A header, then one line per recorded sample of the measurement
+  const char* text = output(trace);
+  const char* header = "path,timestamp_ns,iterations,elapsed_ns\n";
+  CHECK(strncmp(text, header, strlen(header)) == 0);
+  size_t lines = 0;
+  bool traced = true;
+  for (const char* line = text + strlen(header); *line != '\0' && traced; lines++) {
+    unsigned long long timestamp, iterations, elapsed;
+    traced = sscanf(line, "trace/m,%llu,%llu,%llu\n", &timestamp, &iterations, &elapsed) == 3 && iterations > 0;
+    const char* next = strchr(line, '\n');
+    line = next != NULL ? next + 1 : line + strlen(line);
+  }
+  CHECK(traced);
+  CHECK(lines > 0);
+  fclose(out);
+  fclose(trace);
+}
+
+void test_arena() {
+  bench_arena_t arena;
+  bench_arena_init(&arena);
+
+  // Allocations are zeroed, aligned and do not overlap
+  char* previous = NULL;
+  for (size_t size = 1; size < 4096; size = size * 3 + 1) {
+    char* ptr = (char*) bench_arena_alloc(&arena, size);
+    CHECK(ptr != NULL);
+    if (ptr == NULL) break;
+    CHECK(((uintptr_t) ptr & 15) == 0);
+    bool zeroed = true;
+    for (size_t i = 0; i < size; i++) zeroed = zeroed && ptr[i] == 0;
+    CHECK(zeroed);
+    memset(ptr, 0xff, size);
+    CHECK(previous == NULL || (unsigned char) previous[0] == 0xff);
+    previous = ptr;
+  }
+
+  // Allocations larger than a block map a block of their own
+  size_t large = 16 * 1024 * 1024;
+  char* big = (char*) bench_arena_alloc(&arena, large);
+  CHECK(big != NULL);
+  if (big != NULL) {
+    CHECK(big[0] == 0 && big[large - 1] == 0);
+    big[large - 1] = 1;
+  }
+
+  CHECK(bench_arena_reserve(&arena, 1024 * 1024));
+  char* copy = bench_arena_strdup(&arena, "arena");
+  CHECK(copy != NULL && strcmp(copy, "arena") == 0);
+  bench_arena_free(&arena);
+  CHECK(arena.blocks == NULL);
+
+  // Arrays grown in an arena keep their entries
+  bench_arena_init(&arena);
+  bench_array_t array;
+  CHECK(bench_array_init_arena(&array, 2, &arena));
+  for (intptr_t i = 0; i < 100; i++) {
+    CHECK(bench_array_push(&array, (void*) i));
+  }
+  bool kept = array.size == 100;
+  for (intptr_t i = 0; i < 100 && kept; i++) kept = array.entries[i] == (void*) i;
+  CHECK(kept);
+  bench_array_clear(&array);
+  bench_arena_free(&arena);
+}
+
+// Counts how often each slot of an asynchronous measurement set up its state
+static uint64_t async_setups = 0;
+
+void start_immediate(bench_async_t* op) {
+  if (op->state == NULL) {
+    op->state = op;
+    async_setups++;
+  }
+  (*(uint64_t*) op->data)++;
+  bench_async_done(op);
+}
+
+void test_async() {
+  bench_t* b = quiet_suite("async");
+  b->target_time = 2 * MILLIS;
+  uint64_t started = 0;
+  CHECK(bench_measure_async(b, "immediate", start_immediate, NULL, 4, &started) == 0);
+
+  // Slots start with no state and keep the one they set
+  CHECK(async_setups == 4);
+  CHECK(b->measurements.size == 1);
+  bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[0];
+  CHECK(m->in_flight == 4);
+  CHECK(m->stats.count > 0 && m->stats.count <= started);
+  CHECK(strstr(output(b->out), "immediate - ") != NULL);
+  CHECK(strstr(output(b->out), "4 in flight)") != NULL);
+  fclose(b->out);
+  bench_free(b);
+}
+
+static uint64_t rate_calls = 0;
+
+void count_rate(void* data) {
+  (void) data;
+  rate_calls++;
+}
+
+void test_rate() {
+  bench_t* b = quiet_suite("rate");
+  b->target_time = 5 * MILLIS;
+  b->warmup_time = 0;
+  CHECK(bench_measure_rate(b, "rate", count_rate, 20000) == 0);
+
+  // Calls follow the schedule, 50us apart, with one sample each
+  bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[0];
+  CHECK(m->rate == 20000);
+  CHECK(m->stats.count == rate_calls);
+  CHECK(rate_calls > 0 && rate_calls <= 100);
+  CHECK(m->histogram.count == m->stats.count);
+  CHECK(strstr(output(b->out), "20.00k i/s target)") != NULL);
+  fclose(b->out);
+  bench_free(b);
+}
+
+void test_overhead_chunks() {
+  bench_t* b = quiet_suite("overhead");
+  b->subtract_overhead = true;
+  bench_overhead_t* overhead = &_bench_overheads[b->clock == BENCH_CLOCK_CYCLES];
+  bench_overhead_t measured = *overhead;
+  overhead->timer = 100;
+  overhead->call = 0;
+
+  // Two samples of 2048 iterations at 10ns each
+  bench_measurement_t* whole = _bench_measurement_create(b, "whole");
+  bench_measurement_t* chunked = _bench_measurement_create(b, "chunked");
+  for (int i = 0; i < 2; i++) {
+    bench_stats_push_batch(&whole->stats, 20480, 2048);
+    bench_stats_push_batch(&chunked->stats, 20480, 2048);
+  }
+
+  // Chunks of 1024 iterations read the clock twice per sample
+  chunked->chunk = 1024;
+  _bench_overhead_subtract(b, whole);
+  _bench_overhead_subtract(b, chunked);
+  CHECK_NEAR(whole->stats.mean, 10 - 100.0 / 2048, 1e-9);
+  CHECK_NEAR(chunked->stats.mean, 10 - 200.0 / 2048, 1e-9);
+
+  *overhead = measured;
+  bench_array_push(&b->measurements, whole);
+  bench_array_push(&b->measurements, chunked);
+  fclose(b->out);
+  bench_free(b);
+}
+
+void bench_registered(void* data) {
+  (void) data;
+}
+
+BENCH_REGISTER("registered", "first", bench_registered);
+BENCH_REGISTER(NULL, "top", bench_registered);
+BENCH_REGISTER("registered", "second", bench_registered, (void*) 1);
+
+static uint64_t isolated_calls = 0;
+
+void count_isolated(void* data) {
+  (void) data;
+  isolated_calls++;
+}
+
+void crash(void* data) {
+  (void) data;
+  abort();
+}
+
+void isolated_group(bench_t* b) {
+  bench_measure(b, "m", count_isolated);
+}
+
+void test_isolation() {
+#ifndef _WIN32
+  bench_t* b = quiet_suite("isolated");
+  b->target_time = 2 * MILLIS;
+  b->isolation = BENCH_ISOLATION_MEASUREMENT;
+  CHECK(bench_measure(b, "m", count_isolated) == 0);
+
+  // The calls were made by a child, which sent back its results
+  CHECK(isolated_calls == 0);
+  CHECK(b->measurements.size == 1);
+  bench_measurement_t* m = (bench_measurement_t*) b->measurements.entries[0];
+  CHECK(m->stats.count > 0);
+  CHECK(m->histogram.count == m->stats.samples);
+
+  // A crash is reported without taking the suite down
+  CHECK(bench_measure(b, "crash", crash) == -1);
+  CHECK(b->measurements.size == 1);
+  CHECK(strstr(output(b->out), "crash - failed in isolated process (signal 6)\n") != NULL);
+
+  b->isolation = BENCH_ISOLATION_GROUP;
+  bench_group(b, "group", isolated_group);
+  CHECK(isolated_calls == 0);
+  CHECK(strstr(output(b->out), "  # group\n  m - ") != NULL);
+  fclose(b->out);
+  bench_free(b);
+#endif
+}
+
+void test_registry() {
+  size_t count = 0;
+  for (bench_registration_t* r = _bench_registry.head; r != NULL; r = r->next) count++;
+  CHECK(count == 3);
+
+  // Registered before main, in the order of the file, and grouped by name
+  const char* text;
+  CHECK(run_main("--list", NULL, &text) == 0);
+  CHECK(strstr(text, "cli/top\n") != NULL);
+  CHECK(strstr(text, "cli/registered/first\ncli/registered/second\n") != NULL);
+
+  CHECK(run_main("--filter=second", NULL, &text) == 0);
+  CHECK(strstr(text, "second - ") != NULL);
+  CHECK(strstr(text, "first - ") == NULL);
+  CHECK(strstr(text, "top - ") == NULL);
+}
+
+void sum_kernel(const void* input, size_t size, void* output) {
+  const uint8_t* bytes = (const uint8_t*) input;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; i++) sum += bytes[i];
+  memcpy(output, &sum, sizeof(sum));
+  bench_do_not_optimize(sum + 1);
+}
+
+void wrong_kernel(const void* input, size_t size, void* output) {
+  sum_kernel(input, size, output);
+  ((uint8_t*) output)[0] ^= 1;
+}
+
+void test_mismatches() {
+  static const bench_kernel_t kernels[] = {
+    { "reference", BENCH_ISA_SCALAR, sum_kernel },
+    { "same", BENCH_ISA_SCALAR, sum_kernel },
+    { "wrong", BENCH_ISA_SCALAR, wrong_kernel },
+    { "also wrong", BENCH_ISA_SCALAR, wrong_kernel }
+  };
+  uint8_t input[256];
+  for (size_t i = 0; i < sizeof(input); i++) input[i] = (uint8_t) i;
+
+  bench_t* b = quiet_suite("suite");
+  b->target_time = 5 * MILLIS;
+  FILE* out = b->out;
+  CHECK(bench_measure_kernels(b, "sum", kernels, 4, input, sizeof(input), sizeof(uint64_t)) == 2);
+  CHECK(bench_measure_kernels(b, "same", kernels, 2, input, sizeof(input), sizeof(uint64_t)) == 0);
+  bench_compare(b);
+
+  const char* text = output(out);
+  CHECK(strstr(text, "wrong - output differs from reference") != NULL);
+  CHECK(strstr(text, "also wrong - output differs from reference") != NULL);
+  CHECK(strstr(text, "same - ") != NULL);
+  fclose(out);
+}
+
+int main() {
+  test_stats_merge();
+  test_t_table_and_rme();
+  test_histogram_percentiles();
+  test_parallel();
+  test_welch();
+  test_fixture();
+  test_complexity();
+  test_json_baseline();
+  test_cli();
+  test_jobs();
+  test_trace();
+  test_arena();
+  test_async();
+  test_rate();
+  test_overhead_chunks();
+  test_isolation();
+  test_registry();
+  test_mismatches();
+
+  printf("%d checks, %d failed\n", checks, failures);
+  return failures > 0;
+}
@@ -0,0 +1,291 @@
+#define BENCH_TRACK_ALLOCATIONS
+#include "benc.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+void check(bool passed, const char* condition, int line) {
+  checks++;
+  if (!passed) {
+    failures++;
+    fprintf(stderr, "test.cc:%d: failed: %s\n", line, condition);
+  }
+}
+
+// Read everything written to a temporary file so far
+std::string output(FILE* out) {
+  char text[8192];
+  fflush(out);
+  rewind(out);
+  size_t size = fread(text, 1, sizeof(text) - 1, out);
+  return std::string(text, size);
+}
+
+bool contains(const std::string& text, const char* part) {
+  return text.find(part) != std::string::npos;
+}
+
+static uint64_t calls = 0;
+
+void plain_function() {
+  calls++;
+}
+
+void test_measure() {
+  FILE* out = tmpfile();
+  {
+    bench::Group b("suite", out);
+    b.get()->target_time = 2 * MILLIS;
+
+    // Each kind of callable picks an overload which compiles and runs it
+    calls = 0;
+    b.measure("function", plain_function);
+    CHECK(calls > 0);
+
+    calls = 0;
+    b.measure("pointer", &plain_function);
+    CHECK(calls > 0);
+
+    uint64_t lambda_calls = 0;
+    b.measure("lambda", [&]() { lambda_calls++; });
+    CHECK(lambda_calls > 0);
+
+    const auto constant = []() { bench::do_not_optimize(calls + 1); };
+    b.measure("const lambda", constant);
+
+    int state = 0;
+    auto counter = [state]() mutable { bench::do_not_optimize(++state); };
+    b.measure("mutable lambda", counter);
+
+    calls = 0;
+    bench::Group::MeasureFn wrapped = plain_function;
+    b.measure("std::function", wrapped);
+    CHECK(calls > 0);
+
+    // Deferred measurements keep their own copy of the callable
+    b.get()->order = BENCH_ORDER_ROUND_ROBIN;
+    calls = 0;
+    b.measure("deferred function", plain_function);
+    uint64_t deferred_calls = 0;
+    b.measure("deferred lambda", [&]() { deferred_calls++; });
+    CHECK(calls == 0);
+    CHECK(b.compare() == 0);
+    CHECK(calls > 0);
+    CHECK(deferred_calls > 0);
+  }
+
+  std::string text = output(out);
+  static const char* names[] = {
+    "function - ", "pointer - ", "lambda - ", "const lambda - ", "mutable lambda - ",
+    "std::function - ", "deferred function - ", "deferred lambda - "
+  };
+  for (const char* name : names) {
+    CHECK(contains(text, name));
+  }
+  fclose(out);
+}
+
+struct CountingFixture {
+  static int setups;
+  static int runs;
+  static int teardowns;
+  static int live;
+  static int peak;
+  std::vector<int> input;
+  bool ready = false;
+
+  void setup() {
+    setups++;
+    if (++live > peak) peak = live;
+    ready = true;
+  }
+
+  void run() {
+    if (ready && input.size() == 64) runs++;
+  }
+
+  void teardown() {
+    teardowns++;
+    live--;
+    ready = false;
+  }
+};
+
+int CountingFixture::setups = 0;
+int CountingFixture::runs = 0;
+int CountingFixture::teardowns = 0;
+int CountingFixture::live = 0;
+int CountingFixture::peak = 0;
+
+void test_fixture() {
+  FILE* out = tmpfile();
+  {
+    bench::Group b("suite", out);
+    b.get()->target_time = 2 * MILLIS;
+    b.get()->batch_time = 100 * MICROS;
+    CountingFixture prototype;
+    prototype.input.resize(64);
+    b.measure_fixture("fixture", prototype);
+  }
+
+  // Every run used its own copy, set up before and torn down after it
+  CHECK(CountingFixture::runs > 0);
+  CHECK(CountingFixture::setups == CountingFixture::runs);
+  CHECK(CountingFixture::teardowns == CountingFixture::runs);
+
+  // Large batches only hold one chunk of copies at a time
+  CHECK(CountingFixture::peak > 0);
+  CHECK(CountingFixture::peak <= BENCH_FIXTURE_BATCH);
+  CHECK(contains(output(out), "fixture - "));
+  fclose(out);
+}
+
+bench_measurement_t* last_measurement(bench::Group& b) {
+  bench_array_t& measurements = b.get()->measurements;
+  return (bench_measurement_t*) measurements.entries[measurements.size - 1];
+}
+
+void test_allocations() {
+  FILE* out = tmpfile();
+  {
+    bench::Group b("suite", out);
+    b.get()->target_time = 2 * MILLIS;
+    b.get()->allocations = true;
+
+    // Every recorded call allocates once
+    b.measure("new", []() {
+      int* value = new int(1);
+      bench::do_not_optimize(value);
+      delete value;
+    });
+    bench_measurement_t* m = last_measurement(b);
+    CHECK(m->allocs.tracked);
+    CHECK(m->allocs.count == m->stats.count);
+    CHECK(m->allocs.bytes == m->stats.count * sizeof(int));
+
+    b.measure("malloc", []() {
+      void* value = malloc(24);
+      bench::do_not_optimize(value);
+      free(value);
+    });
+    m = last_measurement(b);
+    CHECK(m->allocs.count == m->stats.count);
+    CHECK(m->allocs.bytes == m->stats.count * 24);
+    CHECK(m->allocs.peak >= 24);
+
+    b.measure("none", []() {});
+    CHECK(last_measurement(b)->allocs.count == 0);
+
+    // Copying and setting up fixtures is left out
+    CountingFixture prototype;
+    prototype.input.resize(64);
+    b.measure_fixture("fixture", prototype);
+    CHECK(last_measurement(b)->allocs.count == 0);
+  }
+
+  std::string text = output(out);
+  CHECK(contains(text, "new - "));
+  CHECK(contains(text, "none - "));
+  fclose(out);
+}
+
+void test_groups() {
+  FILE* out = tmpfile();
+  {
+    bench::Group b("suite", out);
+    b.get()->target_time = 2 * MILLIS;
+    b.group("outer", [](bench::Group* g) {
+      g->measure("a", []() { calls++; });
+      g->group("inner", [](bench::Group* inner) {
+        inner->measure("b", []() { calls++; });
+      });
+    });
+    b.measure_range("range", [](uint64_t n) { bench::do_not_optimize(n * 2); }, 1, 4);
+  }
+
+  std::string text = output(out);
+  CHECK(contains(text, "  # outer\n  a - "));
+  CHECK(contains(text, "    # inner\n    b - "));
+  CHECK(contains(text, "  # range\n  1 - "));
+  CHECK(contains(text, "  4 - "));
+  fclose(out);
+}
+
+void test_async() {
+  FILE* out = tmpfile();
+  uint64_t started = 0;
+  uint64_t polls = 0;
+  {
+    bench::Group b("suite", out);
+    b.get()->target_time = 2 * MILLIS;
+
+    // Operations complete on the next poll
+    std::vector<bench_async_t*> pending;
+    b.measure_async("async", [&](bench_async_t* op) {
+      started++;
+      pending.push_back(op);
+    }, [&]() {
+      polls++;
+      for (bench_async_t* op : pending) bench_async_done(op);
+      pending.clear();
+    }, 2);
+  }
+
+  CHECK(started > 0);
+  CHECK(polls > 0);
+  CHECK(contains(output(out), "async - "));
+  CHECK(contains(output(out), "2 in flight)"));
+  fclose(out);
+}
+
+static bench::Registrar registered_first("registered", "first", []() { calls++; });
+static bench::Registrar registered_second("registered", "second", plain_function);
+
+// Run Group::main with one option, keeping what it printed
+int run_main(const char* option, std::string* text, bool registered = false) {
+  FILE* out = tmpfile();
+  char* argv[] = { (char*) "test", (char*) option };
+  int status;
+  {
+    bench::Group b("cli", out);
+    status = registered
+      ? b.main(2, argv)
+      : b.main(2, argv, [](bench::Group* g) {
+          g->measure("fast", []() {});
+          g->measure("slow", plain_function);
+        });
+  }
+  *text = output(out);
+  fclose(out);
+  return status;
+}
+
+void test_main() {
+  std::string text;
+  CHECK(run_main("--list", &text) == 0);
+  CHECK(contains(text, "cli/fast\ncli/slow\n"));
+  CHECK(!contains(text, " - "));
+
+  CHECK(run_main("--list", &text, true) == 0);
+  CHECK(contains(text, "cli/registered/first\ncli/registered/second\n"));
+
+  CHECK(run_main("--unknown", &text) == 2);
+}
+
+int main() {
+  test_measure();
+  test_fixture();
+  test_allocations();
+  test_groups();
+  test_async();
+  test_main();
+
+  printf("%d checks, %d failed\n", checks, failures);
+  return failures > 0;
+}